@@ -3,27 +3,35 @@ C:\VulkanSDK\1.2.189.2\Bin32\glslc.exe shaders\point_light.frag -o shaders\point
 C:\VulkanSDK\1.2.189.2\Bin32\glslc.exe shaders\composition_shader.vert -o shaders\composition_shader.vert.spv
 C:\VulkanSDK\1.2.189.2\Bin32\glslc.exe shaders\composition_shader.frag -o shaders\composition_shader.frag.spv
 C:\VulkanSDK\1.2.189.2\Bin32\glslc.exe shaders\gbuffer_shader.vert -o shaders\gbuffer_shader.vert.spv
+C:\VulkanSDK\1.2.189.2\Bin32\glslc.exe -DCOMPACT_VERTEX shaders\gbuffer_shader.vert -o shaders\gbuffer_shader_compact.vert.spv
 C:\VulkanSDK\1.2.189.2\Bin32\glslc.exe shaders\gbuffer_shader.frag -o shaders\gbuffer_shader.frag.spv
 C:\VulkanSDK\1.2.189.2\Bin32\glslc.exe shaders\shadow_shader.vert -o shaders\shadow_shader.vert.spv
 C:\VulkanSDK\1.2.189.2\Bin32\glslc.exe shaders\shadow_shader.frag -o shaders\shadow_shader.frag.spv
 C:\VulkanSDK\1.2.189.2\Bin32\glslc.exe shaders\mappings_shader.vert -o shaders\mappings_shader.vert.spv
+C:\VulkanSDK\1.2.189.2\Bin32\glslc.exe -DCOMPACT_VERTEX shaders\mappings_shader.vert -o shaders\mappings_shader_compact.vert.spv
 C:\VulkanSDK\1.2.189.2\Bin32\glslc.exe shaders\mappings_shader.frag -o shaders\mappings_shader.frag.spv
 C:\VulkanSDK\1.2.189.2\Bin32\glslc.exe shaders\uv_reflection_shader.vert -o shaders\uv_reflection_shader.vert.spv
 C:\VulkanSDK\1.2.189.2\Bin32\glslc.exe shaders\uv_reflection_shader.frag -o shaders\uv_reflection_shader.frag.spv
 C:\VulkanSDK\1.2.189.2\Bin32\glslc.exe shaders\post_processing_shader.vert -o shaders\post_processing_shader.vert.spv
 C:\VulkanSDK\1.2.189.2\Bin32\glslc.exe shaders\post_processing_shader.frag -o shaders\post_processing_shader.frag.spv
+C:\VulkanSDK\1.2.189.2\Bin32\glslc.exe shaders\depth_pyramid.comp -o shaders\depth_pyramid.comp.spv
+C:\VulkanSDK\1.2.189.2\Bin32\glslc.exe shaders\gpu_cull.comp -o shaders\gpu_cull.comp.spv
 Copy shaders\point_light.vert.spv ..\x64\Release\shaders\point_light.vert.spv
 Copy shaders\point_light.frag.spv ..\x64\Release\shaders\point_light.frag.spv
 Copy shaders\composition_shader.vert.spv ..\x64\Release\shaders\composition_shader.vert.spv
 Copy shaders\composition_shader.frag.spv ..\x64\Release\shaders\composition_shader.frag.spv
 Copy shaders\gbuffer_shader.vert.spv ..\x64\Release\shaders\gbuffer_shader.vert.spv
+Copy shaders\gbuffer_shader_compact.vert.spv ..\x64\Release\shaders\gbuffer_shader_compact.vert.spv
 Copy shaders\gbuffer_shader.frag.spv ..\x64\Release\shaders\gbuffer_shader.frag.spv
 Copy shaders\shadow_shader.vert.spv ..\x64\Release\shaders\shadow_shader.vert.spv
 Copy shaders\shadow_shader.frag.spv ..\x64\Release\shaders\shadow_shader.frag.spv
 Copy shaders\mappings_shader.vert.spv ..\x64\Release\shaders\mappings_shader.vert.spv
+Copy shaders\mappings_shader_compact.vert.spv ..\x64\Release\shaders\mappings_shader_compact.vert.spv
 Copy shaders\mappings_shader.frag.spv ..\x64\Release\shaders\mappings_shader.frag.spv
 Copy shaders\uv_reflection_shader.vert.spv ..\x64\Release\shaders\uv_reflection_shader.vert.spv
 Copy shaders\uv_reflection_shader.frag.spv ..\x64\Release\shaders\uv_reflection_shader.frag.spv
 Copy shaders\post_processing_shader.vert.spv ..\x64\Release\shaders\post_processing_shader.vert.spv
 Copy shaders\post_processing_shader.frag.spv ..\x64\Release\shaders\post_processing_shader.frag.spv
+Copy shaders\depth_pyramid.comp.spv ..\x64\Release\shaders\depth_pyramid.comp.spv
+Copy shaders\gpu_cull.comp.spv ..\x64\Release\shaders\gpu_cull.comp.spv
 pause
\ No newline at end of file
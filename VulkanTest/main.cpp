@@ -1,14 +1,115 @@
 #include "vk3d_app.hpp"
+#include "vk3d_micro_benchmark.hpp"
 
 // std
 #include <cstdlib>
+#include <cstring>
 #include <iostream>
 #include <stdexcept>
+#include <string>
 
-int main() {
-	vk3d::Vk3dApp app{};
+namespace {
+	// Headless runs without an explicit frame count still need to finish
+	constexpr uint32_t DEFAULT_HEADLESS_FRAMES = 1000;
+	constexpr uint32_t DEFAULT_IMPORT_BENCHMARK_TRIANGLES = 4000000;
+	constexpr uint32_t DEFAULT_WELD_BENCHMARK_VERTICES = 1000000;
+	constexpr uint32_t DEFAULT_UPLOAD_BENCHMARK_MESHES = 500;
+	constexpr uint32_t DEFAULT_TRANSFORM_BENCHMARK_OBJECTS = 100000;
 
+	// Micro benchmarks run on their own, without creating the app. Returns false if none was requested.
+	bool runMicroBenchmark(int argc, char* argv[]) {
+		if (argc < 2) {
+			return false;
+		}
+
+		if (std::strcmp(argv[1], "--bench-import") == 0) {
+			uint32_t triangles = argc > 2 ? static_cast<uint32_t>(std::stoul(argv[2])) : DEFAULT_IMPORT_BENCHMARK_TRIANGLES;
+			vk3d::runModelImportBenchmark(triangles);
+			return true;
+		}
+		if (std::strcmp(argv[1], "--bench-weld") == 0) {
+			uint32_t vertices = argc > 2 ? static_cast<uint32_t>(std::stoul(argv[2])) : DEFAULT_WELD_BENCHMARK_VERTICES;
+			vk3d::runVertexWeldBenchmark(vertices);
+			return true;
+		}
+		if (std::strcmp(argv[1], "--bench-upload") == 0) {
+			uint32_t meshes = argc > 2 ? static_cast<uint32_t>(std::stoul(argv[2])) : DEFAULT_UPLOAD_BENCHMARK_MESHES;
+			vk3d::runModelUploadBenchmark(meshes);
+			return true;
+		}
+		if (std::strcmp(argv[1], "--bench-transform") == 0) {
+			uint32_t objects = argc > 2 ? static_cast<uint32_t>(std::stoul(argv[2])) : DEFAULT_TRANSFORM_BENCHMARK_OBJECTS;
+			vk3d::runTransformBenchmark(objects);
+			return true;
+		}
+
+		return false;
+	}
+
+	vk3d::Vk3dModel::VertexFormat parseVertexFormat(const std::string& name) {
+		if (name == "standard") {
+			return vk3d::Vk3dModel::VertexFormat::Standard;
+		}
+		if (name == "compact") {
+			return vk3d::Vk3dModel::VertexFormat::Compact;
+		}
+		if (name == "quantized") {
+			return vk3d::Vk3dModel::VertexFormat::Quantized;
+		}
+		throw std::runtime_error("unknown vertex format: " + name + ", expected standard, compact or quantized");
+	}
+
+	vk3d::Vk3dAppSettings parseSettings(int argc, char* argv[]) {
+		vk3d::Vk3dAppSettings settings{};
+
+		for (int i = 1; i < argc; i++) {
+			if (std::strcmp(argv[i], "--headless") == 0) {
+				settings.headless = true;
+			}
+			else if (std::strcmp(argv[i], "--frames") == 0 && i + 1 < argc) {
+				settings.benchmarkFrames = static_cast<uint32_t>(std::stoul(argv[++i]));
+			}
+			else if (std::strcmp(argv[i], "--gpu-profile") == 0 && i + 1 < argc) {
+				settings.gpuProfilePath = argv[++i];
+			}
+			else if (std::strcmp(argv[i], "--cpu-trace") == 0 && i + 1 < argc) {
+				settings.cpuTracePath = argv[++i];
+			}
+			else if (std::strcmp(argv[i], "--vertex-format") == 0 && i + 1 < argc) {
+				settings.vertexFormat = parseVertexFormat(argv[++i]);
+			}
+			else if (std::strcmp(argv[i], "--no-position-stream") == 0) {
+				settings.positionStream = false;
+			}
+			else if (std::strcmp(argv[i], "--no-occlusion-culling") == 0) {
+				settings.occlusionCulling = false;
+			}
+			else if (std::strcmp(argv[i], "--cpu-draws") == 0) {
+				settings.gpuDrivenDraws = false;
+			}
+			else if (std::strcmp(argv[i], "--model-budget") == 0 && i + 1 < argc) {
+				settings.modelBudget = static_cast<VkDeviceSize>(std::stoull(argv[++i])) * 1024 * 1024;
+			}
+			else {
+				throw std::runtime_error(std::string("unknown argument: ") + argv[i] + "\nusage: VulkanTest [--headless] [--frames N] [--gpu-profile FILE] [--cpu-trace FILE] [--vertex-format standard|compact|quantized] [--model-budget MIB] [--no-position-stream] [--no-occlusion-culling] [--cpu-draws]\n       VulkanTest --bench-import [TRIANGLES]\n       VulkanTest --bench-weld [VERTICES]\n       VulkanTest --bench-upload [MESHES]\n       VulkanTest --bench-transform [OBJECTS]");
+			}
+		}
+
+		if (settings.headless && settings.benchmarkFrames == 0) {
+			settings.benchmarkFrames = DEFAULT_HEADLESS_FRAMES;
+		}
+
+		return settings;
+	}
+}
+
+int main(int argc, char* argv[]) {
 	try {
+		if (runMicroBenchmark(argc, argv)) {
+			return EXIT_SUCCESS;
+		}
+
+		vk3d::Vk3dApp app{ parseSettings(argc, argv) };
 		app.run();
 	}
 	catch (const std::exception& e) {
@@ -17,4 +118,4 @@ int main() {
 	}
 
 	return EXIT_SUCCESS;
-}
\ No newline at end of file
+}
@@ -4,7 +4,11 @@
 
 layout(location = 0) in vec3 position;
 layout(location = 1) in vec4 color;
+#ifdef COMPACT_VERTEX
+layout(location = 2) in vec2 octNormal;
+#else
 layout(location = 2) in vec3 normal;
+#endif
 layout(location = 3) in vec2 uv;
 
 layout (location = 0) out vec4 fragMapWorld;
@@ -15,13 +19,47 @@ layout(set = 0, binding = 0) uniform MappingsBufferUbo {
 	mat4 view;
 } ubo;
 
-layout(push_constant) uniform Push {
-	mat4 modelMatrix; //projection * view * model
+// Vk3dGpuScene::ObjectData
+struct ObjectData {
+	mat4 modelMatrix;
 	mat4 normalMatrix;
-} push;
+	vec4 boundsMin;
+	vec4 boundsMax;
+	vec4 boundingSphere;
+	uvec4 lodFirstIndex;
+	uvec4 lodIndexCount;
+	int vertexOffset;
+	uint lodCount;
+	float reflection;
+	uint batch;
+};
+
+layout(std430, set = 1, binding = 0) readonly buffer ObjectBuffer {
+	ObjectData objects[];
+};
+// slot of every instance, the draws of a model take a range of it
+layout(std430, set = 1, binding = 1) readonly buffer InstanceBuffer {
+	uint instanceSlots[];
+};
+
+#ifdef COMPACT_VERTEX
+// Inverse of the octahedral mapping done by Vk3dModel when packing the vertices
+vec3 decodeNormal() {
+	vec3 n = vec3(octNormal, 1.0 - abs(octNormal.x) - abs(octNormal.y));
+	if (n.z < 0.0) {
+		n.xy = (1.0 - abs(n.yx)) * vec2(n.x >= 0.0 ? 1.0 : -1.0, n.y >= 0.0 ? 1.0 : -1.0);
+	}
+	return normalize(n);
+}
+#else
+vec3 decodeNormal() {
+	return normal;
+}
+#endif
 
 void main() {
-	vec4 positionWorld = push.modelMatrix * vec4(position, 1.0);
+	ObjectData object = objects[instanceSlots[gl_InstanceIndex]];
+	vec4 positionWorld = object.modelMatrix * vec4(position, 1.0);
 	gl_Position = ubo.projection * ubo.view * positionWorld;
 
 	switch (gl_ViewIndex) {
@@ -31,7 +69,7 @@ void main() {
 			break;
 		case 1:
 			doNormalize = 1.0;
-			fragMapWorld = vec4(inverse(transpose(mat3(ubo.view * push.normalMatrix))) * normal, 1.0);
+			fragMapWorld = vec4(inverse(transpose(mat3(ubo.view * object.normalMatrix))) * decodeNormal(), 1.0);
 			break;
 	}
 }
\ No newline at end of file
@@ -2,17 +2,34 @@
 
 #extension GL_EXT_multiview : enable
 
+// only the position, the pipeline may bind the position stream alone
 layout(location = 0) in vec3 position;
-layout(location = 1) in vec4 color;
-layout(location = 2) in vec3 normal;
-layout(location = 3) in vec2 uv;
 
 layout(location = 0) out vec3 worldPos;
 layout(location = 1) out vec3 lightPos;
 
-layout(push_constant) uniform Push {
+// Vk3dGpuScene::ObjectData
+struct ObjectData {
 	mat4 modelMatrix;
-} push;
+	mat4 normalMatrix;
+	vec4 boundsMin;
+	vec4 boundsMax;
+	vec4 boundingSphere;
+	uvec4 lodFirstIndex;
+	uvec4 lodIndexCount;
+	int vertexOffset;
+	uint lodCount;
+	float reflection;
+	uint batch;
+};
+
+layout(std430, set = 1, binding = 0) readonly buffer ObjectBuffer {
+	ObjectData objects[];
+};
+// slot of every instance, the draws of a model take a range of it
+layout(std430, set = 1, binding = 1) readonly buffer InstanceBuffer {
+	uint instanceSlots[];
+};
 
 layout(set = 0, binding = 0) uniform ShadowUbo {
 	mat4 lightProjectionView[6];
@@ -33,7 +50,7 @@ const vec2 QUAD_VERTICES[6] = vec2[](
 void main() 
 {
 	vec4 inPos = vec4(position, 1.0);
-	vec4 positionWorld = push.modelMatrix * inPos;
+	vec4 positionWorld = objects[instanceSlots[gl_InstanceIndex]].modelMatrix * inPos;
 	gl_Position = ubo.lightProjectionView[gl_ViewIndex] * positionWorld;
 	worldPos = positionWorld.xyz;
 	lightPos = ubo.lightPosition.xyz;
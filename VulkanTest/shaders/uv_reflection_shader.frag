@@ -8,10 +8,7 @@ layout(set = 0, binding = 0) uniform UVReflectionBufferUbo {
 } ubo;
 layout (binding = 1) uniform sampler2DArray samplerMappingsMap;
 
-layout(push_constant) uniform Push {
-	mat4 modelMatrix;
-	float reflection;
-} push;
+layout (location = 0) flat in float fragReflection;
 
 layout (location = 0) out vec4 outUVReflection;
 
@@ -30,7 +27,7 @@ struct RayMarch
 void main() {
 	vec4 uv = vec4(0.0);
 
-	if (push.reflection != 1.0
+	if (fragReflection != 1.0
      ) { outUVReflection = uv; return; }
 
 	// Compute current clip fragment
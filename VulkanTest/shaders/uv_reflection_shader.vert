@@ -12,12 +12,34 @@ layout(set = 0, binding = 0) uniform UVReflectionBufferUbo {
 	vec2 invResolution;
 } ubo;
 
-layout(push_constant) uniform Push {
+layout (location = 0) flat out float fragReflection;
+
+// Vk3dGpuScene::ObjectData
+struct ObjectData {
 	mat4 modelMatrix;
+	mat4 normalMatrix;
+	vec4 boundsMin;
+	vec4 boundsMax;
+	vec4 boundingSphere;
+	uvec4 lodFirstIndex;
+	uvec4 lodIndexCount;
+	int vertexOffset;
+	uint lodCount;
 	float reflection;
-} push;
+	uint batch;
+};
+
+layout(std430, set = 1, binding = 0) readonly buffer ObjectBuffer {
+	ObjectData objects[];
+};
+// slot of every instance, the draws of a model take a range of it
+layout(std430, set = 1, binding = 1) readonly buffer InstanceBuffer {
+	uint instanceSlots[];
+};
 
 void main() {
-	vec4 positionWorld = push.modelMatrix * vec4(position, 1.0);
+	ObjectData object = objects[instanceSlots[gl_InstanceIndex]];
+	vec4 positionWorld = object.modelMatrix * vec4(position, 1.0);
 	gl_Position = ubo.projection * ubo.view * positionWorld;
+	fragReflection = object.reflection;
 }
\ No newline at end of file
@@ -1,4 +1,5 @@
 #include "point_light_system.hpp"
+#include "../vk3d_profiler.hpp"
 #include <math.h>
 
 // libs
@@ -56,6 +57,7 @@ namespace vk3d {
 	}
 
 	void PointLightSystem::render(FrameInfo& frameInfo) {
+		VK3D_PROFILE_ZONE("PointLightSystem::render");
 		vk3dPipeline->bind(frameInfo.commandBuffer);
 
 		vkCmdBindDescriptorSets(
@@ -1,4 +1,5 @@
 #include "reflection_render_system.hpp"
+#include "../vk3d_profiler.hpp"
 #include <math.h>
 
 // libs
@@ -15,21 +16,11 @@
 
 namespace vk3d {
 
-	struct MappingsPushConstantData {
-		glm::mat4 modelMatrix{ 1.f };
-		glm::mat4 normalMatrix{ 1.f };
-	};
-
-	struct UVReflectionMapPushConstantData{
-		glm::mat4 modelMatrix{ 1.f };
-		float reflection;
-	};
-
 	//Add here descriptor set
-	ReflectionRenderSystem::ReflectionRenderSystem(Vk3dDevice& device, VkRenderPass mappingsRenderPass, VkDescriptorSetLayout mappingsSetLayout, VkRenderPass uvReflectionMapRenderPass, VkDescriptorSetLayout uvReflectionMapSetLayout) : vk3dDevice{ device } {
-		createMappingsPipelineLayout(mappingsSetLayout);
+	ReflectionRenderSystem::ReflectionRenderSystem(Vk3dDevice& device, VkRenderPass mappingsRenderPass, VkDescriptorSetLayout mappingsSetLayout, VkRenderPass uvReflectionMapRenderPass, VkDescriptorSetLayout uvReflectionMapSetLayout, VkDescriptorSetLayout objectSetLayout, Vk3dModel::VertexFormat vertexFormat) : vk3dDevice{ device }, vertexFormat{ vertexFormat } {
+		createMappingsPipelineLayout(mappingsSetLayout, objectSetLayout);
 		createMappingsPipeline(mappingsRenderPass);
-		createUVReflectionMapPipelineLayout(uvReflectionMapSetLayout);
+		createUVReflectionMapPipelineLayout(uvReflectionMapSetLayout, objectSetLayout);
 		createUVReflectionMapPipeline(uvReflectionMapRenderPass);
 	}
 
@@ -38,20 +29,14 @@ namespace vk3d {
 		vkDestroyPipelineLayout(vk3dDevice.device(), mappingsPipelineLayout, nullptr);
 	}
 
-	void ReflectionRenderSystem::createMappingsPipelineLayout(VkDescriptorSetLayout mappingsSetLayout) {
-		VkPushConstantRange pushConstantRange{};
-		pushConstantRange.stageFlags = VK_SHADER_STAGE_VERTEX_BIT;
-		pushConstantRange.offset = 0;
-		pushConstantRange.size = sizeof(MappingsPushConstantData);
-
-		std::vector<VkDescriptorSetLayout> descriptorSetLayouts{ mappingsSetLayout };
+	void ReflectionRenderSystem::createMappingsPipelineLayout(VkDescriptorSetLayout mappingsSetLayout, VkDescriptorSetLayout objectSetLayout) {
+		// the model matrices are read from the object set
+		std::vector<VkDescriptorSetLayout> descriptorSetLayouts{ mappingsSetLayout, objectSetLayout };
 
 		VkPipelineLayoutCreateInfo pipelineLayoutInfo{};
 		pipelineLayoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
 		pipelineLayoutInfo.setLayoutCount = static_cast<uint32_t>(descriptorSetLayouts.size());
 		pipelineLayoutInfo.pSetLayouts = descriptorSetLayouts.data();
-		pipelineLayoutInfo.pushConstantRangeCount = 1;
-		pipelineLayoutInfo.pPushConstantRanges = &pushConstantRange;
 		if (vkCreatePipelineLayout(vk3dDevice.device(), &pipelineLayoutInfo, nullptr, &mappingsPipelineLayout) != VK_SUCCESS) {
 			throw std::runtime_error("failed to create pipeline layout!");
 		}
@@ -62,32 +47,27 @@ namespace vk3d {
 		PipelineConfigInfo pipelineConfig{};
 		pipelineConfig.attachmentCount = 1;
 		pipelineConfig.hasVertexBufferBound = true;
+		pipelineConfig.vertexFormat = vertexFormat;
 		Vk3dPipeline::defaultPipelineConfigInfo(pipelineConfig);
 		pipelineConfig.renderPass = mappingsRenderPass;
 		pipelineConfig.subpass = 0;
 		pipelineConfig.pipelineLayout = mappingsPipelineLayout;
 		vk3dMappingsPipeline = std::make_unique<Vk3dPipeline>(
 			vk3dDevice,
-			"shaders/mappings_shader.vert.spv",
+			vertexFormat == Vk3dModel::VertexFormat::Standard ? "shaders/mappings_shader.vert.spv" : "shaders/mappings_shader_compact.vert.spv",
 			"shaders/mappings_shader.frag.spv",
 			pipelineConfig
 			);
 	}
 
-	void ReflectionRenderSystem::createUVReflectionMapPipelineLayout(VkDescriptorSetLayout uvReflectionMapSetLayout) {
-		VkPushConstantRange pushConstantRange{};
-		pushConstantRange.stageFlags = VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT;
-		pushConstantRange.offset = 0;
-		pushConstantRange.size = sizeof(UVReflectionMapPushConstantData);
-
-		std::vector<VkDescriptorSetLayout> descriptorSetLayouts{ uvReflectionMapSetLayout };
+	void ReflectionRenderSystem::createUVReflectionMapPipelineLayout(VkDescriptorSetLayout uvReflectionMapSetLayout, VkDescriptorSetLayout objectSetLayout) {
+		// the model matrices and reflections are read from the object set
+		std::vector<VkDescriptorSetLayout> descriptorSetLayouts{ uvReflectionMapSetLayout, objectSetLayout };
 
 		VkPipelineLayoutCreateInfo pipelineLayoutInfo{};
 		pipelineLayoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
 		pipelineLayoutInfo.setLayoutCount = static_cast<uint32_t>(descriptorSetLayouts.size());
 		pipelineLayoutInfo.pSetLayouts = descriptorSetLayouts.data();
-		pipelineLayoutInfo.pushConstantRangeCount = 1;
-		pipelineLayoutInfo.pPushConstantRanges = &pushConstantRange;
 		if (vkCreatePipelineLayout(vk3dDevice.device(), &pipelineLayoutInfo, nullptr, &uvReflectionMapPipelineLayout) != VK_SUCCESS) {
 			throw std::runtime_error("failed to create pipeline layout!");
 		}
@@ -98,6 +78,7 @@ namespace vk3d {
 		PipelineConfigInfo pipelineConfig{};
 		pipelineConfig.attachmentCount = 1;
 		pipelineConfig.hasVertexBufferBound = true;
+		pipelineConfig.vertexFormat = vertexFormat;
 		Vk3dPipeline::defaultPipelineConfigInfo(pipelineConfig);
 		pipelineConfig.renderPass = uvReflectionMapRenderPass;
 		pipelineConfig.subpass = 0;
@@ -110,76 +91,70 @@ namespace vk3d {
 			);
 	}
 
-	void ReflectionRenderSystem::renderMappings(FrameInfo& frameInfo) {
+	void ReflectionRenderSystem::submitDraws(FrameInfo& frameInfo) {
+		VK3D_PROFILE_ZONE("ReflectionRenderSystem::submitDraws");
+		float projectionScale = frameInfo.camera.getProjection()[1][1];
+		Vk3dScene& scene = frameInfo.scene;
+		const std::shared_ptr<Vk3dModel>* models = scene.getModels();
+		const uint32_t* slots = scene.getIndexSlots();
+		const Vk3dAabb* worldBounds = scene.getWorldBounds();
+		// culled against the camera, only objects with a model are listed
+		for (uint32_t i : frameInfo.visibleObjects) {
+			uint32_t lod = scene.selectLod(i, frameInfo.viewPosition, projectionScale);
+			float depth = glm::distance(worldBounds[i].center(), frameInfo.viewPosition);
+			frameInfo.renderQueue.submit(Vk3dRenderQueue::Pass::Mappings, 0, models[i].get(), lod, slots[i], depth);
+			frameInfo.renderQueue.submit(Vk3dRenderQueue::Pass::UVReflection, 0, models[i].get(), lod, slots[i], depth);
+		}
+	}
+
+	void ReflectionRenderSystem::renderMappings(FrameInfo& frameInfo, Vk3dGpuCuller::Phase phase) {
+		VK3D_PROFILE_ZONE("ReflectionRenderSystem::renderMappings");
 		vk3dMappingsPipeline->bind(frameInfo.commandBuffer);
 
+		std::array<VkDescriptorSet, 2> descriptorSets{ frameInfo.mappingsDescriptorSet, frameInfo.objectDescriptorSet };
 		vkCmdBindDescriptorSets(
 			frameInfo.commandBuffer,
 			VK_PIPELINE_BIND_POINT_GRAPHICS,
 			mappingsPipelineLayout,
 			0,
-			1,
-			&frameInfo.mappingsDescriptorSet,
+			static_cast<uint32_t>(descriptorSets.size()),
+			descriptorSets.data(),
 			0,
 			nullptr);
 
-		for (auto& kv : frameInfo.gameObjects) {
-			auto& obj = kv.second;
-
-			MappingsPushConstantData push{};
-
-			push.modelMatrix = obj.transform.mat4();
-			push.normalMatrix = obj.transform.normalMatrix();
-
-			vkCmdPushConstants(
-				frameInfo.commandBuffer,
-				mappingsPipelineLayout,
-				VK_SHADER_STAGE_VERTEX_BIT,
-				0,
-				sizeof(MappingsPushConstantData),
-				&push
-			);
-
-			obj.model->bind(frameInfo.commandBuffer);
-			obj.model->draw(frameInfo.commandBuffer);
+		frameInfo.geometryPool.bind(frameInfo.commandBuffer);
+		// the GPU culled every object and picked its LOD
+		if (frameInfo.gpuCuller) {
+			frameInfo.gpuCuller->draw(frameInfo.commandBuffer, phase);
+			return;
 		}
+
+		frameInfo.renderQueue.record(frameInfo.commandBuffer, Vk3dRenderQueue::Pass::Mappings);
 	}
 
 	void ReflectionRenderSystem::renderUVReflectionMap(FrameInfo& frameInfo) {
+		VK3D_PROFILE_ZONE("ReflectionRenderSystem::renderUVReflectionMap");
 		vk3dUVReflectionMapPipeline->bind(frameInfo.commandBuffer);
 
+		std::array<VkDescriptorSet, 2> descriptorSets{ frameInfo.uvReflectionDescriptorSet, frameInfo.objectDescriptorSet };
 		vkCmdBindDescriptorSets(
 			frameInfo.commandBuffer,
 			VK_PIPELINE_BIND_POINT_GRAPHICS,
 			uvReflectionMapPipelineLayout,
 			0,
-			1,
-			&frameInfo.uvReflectionDescriptorSet,
+			static_cast<uint32_t>(descriptorSets.size()),
+			descriptorSets.data(),
 			0,
 			nullptr);
 
-		for (auto& kv : frameInfo.gameObjects) {
-			auto& obj = kv.second;
-
-			UVReflectionMapPushConstantData push{};
-
-			push.modelMatrix = obj.transform.mat4();
-			push.reflection = obj.reflection;
-
-			vkCmdPushConstants(
-				frameInfo.commandBuffer,
-				uvReflectionMapPipelineLayout,
-				VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT,
-				0,
-				sizeof(UVReflectionMapPushConstantData),
-				&push
-			);
-
-			obj.model->bind(frameInfo.commandBuffer);
-
-			obj.model->draw(frameInfo.commandBuffer);
+		frameInfo.geometryPool.bind(frameInfo.commandBuffer);
+		// the GPU culled every object and picked its LOD
+		if (frameInfo.gpuCuller) {
+			frameInfo.gpuCuller->draw(frameInfo.commandBuffer, Vk3dGpuCuller::Phase::Main);
+			return;
 		}
 
+		frameInfo.renderQueue.record(frameInfo.commandBuffer, Vk3dRenderQueue::Pass::UVReflection);
 	}
 
 }
\ No newline at end of file
@@ -13,22 +13,26 @@
 namespace vk3d {
 	class ReflectionRenderSystem {
 	public:
-		ReflectionRenderSystem(Vk3dDevice& device, VkRenderPass mappingsRenderPass, VkDescriptorSetLayout mappingsSetLayout, VkRenderPass uvReflectionMapRenderPass, VkDescriptorSetLayout uvReflectionMapSetLayout);
+		ReflectionRenderSystem(Vk3dDevice& device, VkRenderPass mappingsRenderPass, VkDescriptorSetLayout mappingsSetLayout, VkRenderPass uvReflectionMapRenderPass, VkDescriptorSetLayout uvReflectionMapSetLayout, VkDescriptorSetLayout objectSetLayout, Vk3dModel::VertexFormat vertexFormat);
 		~ReflectionRenderSystem();
 
 		ReflectionRenderSystem(const ReflectionRenderSystem&) = delete;
 		ReflectionRenderSystem& operator=(const ReflectionRenderSystem&) = delete;
 
-		void renderMappings(FrameInfo& frameInfo);
+		// Submits the visible objects to the render queue for both passes, unless frameInfo has a GPU culler
+		void submitDraws(FrameInfo& frameInfo);
+		// The late phase draws the objects the GPU culler found visible after the first pass, in the late mappings pass
+		void renderMappings(FrameInfo& frameInfo, Vk3dGpuCuller::Phase phase = Vk3dGpuCuller::Phase::Early);
 		void renderUVReflectionMap(FrameInfo& frameInfo);
 
 	private:
-		void createMappingsPipelineLayout(VkDescriptorSetLayout mappingsSetLayout);
+		void createMappingsPipelineLayout(VkDescriptorSetLayout mappingsSetLayout, VkDescriptorSetLayout objectSetLayout);
 		void createMappingsPipeline(VkRenderPass mappingsRenderPass);
-		void createUVReflectionMapPipelineLayout(VkDescriptorSetLayout uvReflectionMapSetLayout);
+		void createUVReflectionMapPipelineLayout(VkDescriptorSetLayout uvReflectionMapSetLayout, VkDescriptorSetLayout objectSetLayout);
 		void createUVReflectionMapPipeline(VkRenderPass uvReflectionMapRenderPass);
 
 		Vk3dDevice& vk3dDevice;
+		Vk3dModel::VertexFormat vertexFormat;
 
 		Vk3dAllocator vk3dAllocator{ vk3dDevice };
 		std::unique_ptr<Vk3dPipeline> vk3dMappingsPipeline;
@@ -1,4 +1,5 @@
 #include "scene_render_system.hpp"
+#include "../vk3d_profiler.hpp"
 #include <math.h>
 
 // libs
@@ -15,19 +16,14 @@
 
 namespace vk3d {
 
-	struct GBufferPushConstantData {
-		glm::mat4 modelMatrix{ 1.f };
-		glm::mat4 normalMatrix{ 1.f };
-	};
-
 	struct CompositionPushConstantData {
 		glm::mat4 invViewProj{ 1.f };
 		glm::vec2 invResolution{ 1.f };
 	};
 
 	SceneRenderSystem::SceneRenderSystem(Vk3dDevice& device, VkRenderPass lightingRenderPass, VkDescriptorSetLayout gBufferSetLayout, 
-		VkDescriptorSetLayout compositionSetLayout, VkRenderPass postProcessingRenderPass, VkDescriptorSetLayout postProcessingSetLayout) : vk3dDevice{device} {
-		createGBufferPipelineLayout(gBufferSetLayout);
+		VkDescriptorSetLayout compositionSetLayout, VkRenderPass postProcessingRenderPass, VkDescriptorSetLayout postProcessingSetLayout, VkDescriptorSetLayout objectSetLayout, Vk3dModel::VertexFormat vertexFormat) : vk3dDevice{device}, vertexFormat{ vertexFormat } {
+		createGBufferPipelineLayout(gBufferSetLayout, objectSetLayout);
 		createGBufferPipeline(lightingRenderPass);
 		createCompositionPipelineLayout(compositionSetLayout);
 		createCompositionPipeline(lightingRenderPass);
@@ -41,21 +37,14 @@ namespace vk3d {
 		vkDestroyPipelineLayout(vk3dDevice.device(), gBufferPipelineLayout, nullptr);
 	}
 
-	void SceneRenderSystem::createGBufferPipelineLayout(VkDescriptorSetLayout gBufferSetLayout) {
-
-		VkPushConstantRange pushConstantRange{};
-		pushConstantRange.stageFlags = VK_SHADER_STAGE_VERTEX_BIT;
-		pushConstantRange.offset = 0;
-		pushConstantRange.size = sizeof(GBufferPushConstantData);
-
-		std::vector<VkDescriptorSetLayout> descriptorSetLayouts{ gBufferSetLayout };
+	void SceneRenderSystem::createGBufferPipelineLayout(VkDescriptorSetLayout gBufferSetLayout, VkDescriptorSetLayout objectSetLayout) {
+		// the model and normal matrices are read from the object set
+		std::vector<VkDescriptorSetLayout> descriptorSetLayouts{ gBufferSetLayout, objectSetLayout };
 
 		VkPipelineLayoutCreateInfo pipelineLayoutInfo{};
 		pipelineLayoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
 		pipelineLayoutInfo.setLayoutCount = static_cast<uint32_t>(descriptorSetLayouts.size());
 		pipelineLayoutInfo.pSetLayouts = descriptorSetLayouts.data();
-		pipelineLayoutInfo.pushConstantRangeCount = 1;
-		pipelineLayoutInfo.pPushConstantRanges = &pushConstantRange;
 		if (vkCreatePipelineLayout(vk3dDevice.device(), &pipelineLayoutInfo, nullptr, &gBufferPipelineLayout) != VK_SUCCESS) {
 			throw std::runtime_error("failed to create pipeline layout!");
 		}
@@ -66,13 +55,14 @@ namespace vk3d {
 		PipelineConfigInfo pipelineConfig{};
 		pipelineConfig.attachmentCount = 2;
 		pipelineConfig.hasVertexBufferBound = true;
+		pipelineConfig.vertexFormat = vertexFormat;
 		Vk3dPipeline::defaultPipelineConfigInfo(pipelineConfig);
 		pipelineConfig.renderPass = lightingRenderPass;
 		pipelineConfig.subpass = 0;
 		pipelineConfig.pipelineLayout = gBufferPipelineLayout;
 		vk3dGBufferPipeline = std::make_unique<Vk3dPipeline>(
 			vk3dDevice,
-			"shaders/gbuffer_shader.vert.spv",
+			vertexFormat == Vk3dModel::VertexFormat::Standard ? "shaders/gbuffer_shader.vert.spv" : "shaders/gbuffer_shader_compact.vert.spv",
 			"shaders/gbuffer_shader.frag.spv",
 			pipelineConfig
 			);
@@ -143,45 +133,50 @@ namespace vk3d {
 			);
 	}
 
-	void SceneRenderSystem::renderGameObjectsLighting(FrameInfo& frameInfo, glm::mat4 invViewProj, glm::vec2 invResolution) {
+	void SceneRenderSystem::submitDraws(FrameInfo& frameInfo) {
+		VK3D_PROFILE_ZONE("SceneRenderSystem::submitDraws");
+		float projectionScale = frameInfo.camera.getProjection()[1][1];
+		Vk3dScene& scene = frameInfo.scene;
+		const std::shared_ptr<Vk3dModel>* models = scene.getModels();
+		const uint32_t* slots = scene.getIndexSlots();
+		const Vk3dAabb* worldBounds = scene.getWorldBounds();
+		// culled against the camera, only objects with a model are listed
+		for (uint32_t i : frameInfo.visibleObjects) {
+			uint32_t lod = scene.selectLod(i, frameInfo.viewPosition, projectionScale);
+			float depth = glm::distance(worldBounds[i].center(), frameInfo.viewPosition);
+			frameInfo.renderQueue.submit(Vk3dRenderQueue::Pass::GBuffer, 0, models[i].get(), lod, slots[i], depth);
+		}
+	}
+
+	void SceneRenderSystem::renderGBuffer(FrameInfo& frameInfo) {
+		VK3D_PROFILE_ZONE("SceneRenderSystem::renderGBuffer");
 		// First subpass
 		vk3dGBufferPipeline->bind(frameInfo.commandBuffer);
 
+		std::array<VkDescriptorSet, 2> descriptorSets{ frameInfo.gBufferDescriptorSet, frameInfo.objectDescriptorSet };
 		vkCmdBindDescriptorSets(
 			frameInfo.commandBuffer,
 			VK_PIPELINE_BIND_POINT_GRAPHICS,
 			gBufferPipelineLayout,
 			0,
-			1,
-			&frameInfo.gBufferDescriptorSet,
+			static_cast<uint32_t>(descriptorSets.size()),
+			descriptorSets.data(),
 			0,
 			nullptr);
 
-		for (auto& kv : frameInfo.gameObjects) {
-			auto& obj = kv.second;
-
-			GBufferPushConstantData push{};
-
-			push.modelMatrix = obj.transform.mat4();
-			push.normalMatrix = obj.transform.normalMatrix();
-
-			vkCmdPushConstants(
-				frameInfo.commandBuffer,
-				gBufferPipelineLayout,
-				VK_SHADER_STAGE_VERTEX_BIT,
-				0,
-				sizeof(GBufferPushConstantData),
-				&push
-			);
-
-			obj.model->bind(frameInfo.commandBuffer);
-			obj.model->draw(frameInfo.commandBuffer);
+		frameInfo.geometryPool.bind(frameInfo.commandBuffer);
+		// the GPU culled every object and picked its LOD
+		if (frameInfo.gpuCuller) {
+			frameInfo.gpuCuller->draw(frameInfo.commandBuffer, Vk3dGpuCuller::Phase::Main);
+			return;
 		}
 
-		//Subpass transition
-		vkCmdNextSubpass(frameInfo.commandBuffer, VK_SUBPASS_CONTENTS_INLINE);
+		frameInfo.renderQueue.record(frameInfo.commandBuffer, Vk3dRenderQueue::Pass::GBuffer);
+	}
 
-		//Second subpass		
+	void SceneRenderSystem::renderComposition(FrameInfo& frameInfo, glm::mat4 invViewProj, glm::vec2 invResolution) {
+		VK3D_PROFILE_ZONE("SceneRenderSystem::renderComposition");
+		//Second subpass, the renderer must have transitioned to it already
 		vk3dCompositionPipeline->bind(frameInfo.commandBuffer);
 
 		vkCmdBindDescriptorSets(
@@ -212,6 +207,7 @@ namespace vk3d {
 	}
 
 	void SceneRenderSystem::renderPostProcessing(FrameInfo& frameInfo) {
+		VK3D_PROFILE_ZONE("SceneRenderSystem::renderPostProcessing");
 		vk3dPostProcessingPipeline->bind(frameInfo.commandBuffer);
 
 		vkCmdBindDescriptorSets(
@@ -18,17 +18,20 @@ namespace vk3d {
 		static constexpr int NUMBER_OF_TRIANGLE_VERTICES = 3;
 
 		SceneRenderSystem(Vk3dDevice &device, VkRenderPass renderPass, VkDescriptorSetLayout gBufferSetLayout, 
-			VkDescriptorSetLayout compositionSetLayout, VkRenderPass postProcessingRenderPass, VkDescriptorSetLayout postProcessingSetLayout);
+			VkDescriptorSetLayout compositionSetLayout, VkRenderPass postProcessingRenderPass, VkDescriptorSetLayout postProcessingSetLayout, VkDescriptorSetLayout objectSetLayout, Vk3dModel::VertexFormat vertexFormat);
 		~SceneRenderSystem();
 
 		SceneRenderSystem(const SceneRenderSystem&) = delete;
 		SceneRenderSystem& operator=(const SceneRenderSystem&) = delete;
 
-		void renderGameObjectsLighting(FrameInfo& frameInfo, glm::mat4 invViewProj, glm::vec2 invResolution);
+		// Submits the visible objects to the render queue for the G-buffer subpass, unless frameInfo has a GPU culler
+		void submitDraws(FrameInfo& frameInfo);
+		void renderGBuffer(FrameInfo& frameInfo);
+		void renderComposition(FrameInfo& frameInfo, glm::mat4 invViewProj, glm::vec2 invResolution);
 		void renderPostProcessing(FrameInfo& frameInfo);
 
 	private:
-		void createGBufferPipelineLayout(VkDescriptorSetLayout gBufferLayout);
+		void createGBufferPipelineLayout(VkDescriptorSetLayout gBufferLayout, VkDescriptorSetLayout objectSetLayout);
 		void createGBufferPipeline(VkRenderPass lightingRenderPass);
 		void createCompositionPipelineLayout(VkDescriptorSetLayout compositionSetLayout);
 		void createCompositionPipeline(VkRenderPass lightingRenderPass);
@@ -36,6 +39,7 @@ namespace vk3d {
 		void createPostProcessingPipeline(VkRenderPass postProcessingRenderPass);
 
 		Vk3dDevice &vk3dDevice;
+		Vk3dModel::VertexFormat vertexFormat;
 
 		Vk3dAllocator vk3dAllocator{ vk3dDevice };
 		std::unique_ptr<Vk3dPipeline> vk3dGBufferPipeline;
@@ -1,4 +1,5 @@
 #include "shadow_render_system.hpp"
+#include "../vk3d_profiler.hpp"
 #include <math.h>
 
 // libs
@@ -15,57 +16,86 @@
 
 namespace vk3d {
 
-	struct ShadowPushConstantData {
-		glm::mat4 modelMatrix{ 1.f };
-	};
-
 	//Add here descriptor set
-	ShadowRenderSystem::ShadowRenderSystem(Vk3dDevice& device, VkRenderPass renderPass, VkDescriptorSetLayout shadowSetLayout) : vk3dDevice{ device } {
-		createShadowPipelineLayout(shadowSetLayout);
-		createShadowPipeline(renderPass);
+	ShadowRenderSystem::ShadowRenderSystem(Vk3dDevice& device, VkRenderPass renderPass, VkDescriptorSetLayout shadowSetLayout, VkDescriptorSetLayout objectSetLayout, Vk3dModel::VertexFormat vertexFormat, bool positionStream) : vk3dDevice{ device }, vertexFormat{ vertexFormat }, positionStream{ positionStream } {
+		createShadowPipelineLayout(shadowSetLayout, objectSetLayout);
+		createShadowPipelines(renderPass);
 	}
 
 	ShadowRenderSystem::~ShadowRenderSystem() {
 		vkDestroyPipelineLayout(vk3dDevice.device(), shadowPipelineLayout, nullptr);
 	}
 
-	void ShadowRenderSystem::createShadowPipelineLayout(VkDescriptorSetLayout shadowSetLayout) {
-		VkPushConstantRange pushConstantRange{};
-		pushConstantRange.stageFlags = VK_SHADER_STAGE_VERTEX_BIT;
-		pushConstantRange.offset = 0;
-		pushConstantRange.size = sizeof(ShadowPushConstantData);
-
-		std::vector<VkDescriptorSetLayout> descriptorSetLayouts{ shadowSetLayout };
+	void ShadowRenderSystem::createShadowPipelineLayout(VkDescriptorSetLayout shadowSetLayout, VkDescriptorSetLayout objectSetLayout) {
+		// the model matrices are read from the object set
+		std::vector<VkDescriptorSetLayout> descriptorSetLayouts{ shadowSetLayout, objectSetLayout };
 
 		VkPipelineLayoutCreateInfo pipelineLayoutInfo{};
 		pipelineLayoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
 		pipelineLayoutInfo.setLayoutCount = static_cast<uint32_t>(descriptorSetLayouts.size());
 		pipelineLayoutInfo.pSetLayouts = descriptorSetLayouts.data();
-		pipelineLayoutInfo.pushConstantRangeCount = 1;
-		pipelineLayoutInfo.pPushConstantRanges = &pushConstantRange;
 		if (vkCreatePipelineLayout(vk3dDevice.device(), &pipelineLayoutInfo, nullptr, &shadowPipelineLayout) != VK_SUCCESS) {
 			throw std::runtime_error("failed to create pipeline layout!");
 		}
 	}
 
-	void ShadowRenderSystem::createShadowPipeline(VkRenderPass renderPass) {
+	void ShadowRenderSystem::createShadowPipelines(VkRenderPass renderPass) {
 		assert(shadowPipelineLayout != nullptr && "Cannot create pipeline before pipeline layout");
-		PipelineConfigInfo pipelineConfig{};
-		pipelineConfig.attachmentCount = 1;
-		pipelineConfig.hasVertexBufferBound = true;
-		Vk3dPipeline::shadowPipelineConfigInfo(pipelineConfig);
-		pipelineConfig.renderPass = renderPass;
-		pipelineConfig.subpass = 0;
-		pipelineConfig.pipelineLayout = shadowPipelineLayout;
-		vk3dShadowPipeline = std::make_unique<Vk3dPipeline>(
-			vk3dDevice,
-			"shaders/shadow_shader.vert.spv",
-			"shaders/shadow_shader.frag.spv",
-			pipelineConfig
-			);
+		for (uint32_t face = 0; face < vk3dShadowPipelines.size(); face++) {
+			PipelineConfigInfo pipelineConfig{};
+			pipelineConfig.attachmentCount = 1;
+			pipelineConfig.hasVertexBufferBound = true;
+			pipelineConfig.vertexFormat = vertexFormat;
+			pipelineConfig.positionOnly = positionStream;
+			Vk3dPipeline::shadowPipelineConfigInfo(pipelineConfig);
+			pipelineConfig.renderPass = renderPass;
+			pipelineConfig.subpass = face;
+			pipelineConfig.pipelineLayout = shadowPipelineLayout;
+			vk3dShadowPipelines[face] = std::make_unique<Vk3dPipeline>(
+				vk3dDevice,
+				"shaders/shadow_shader.vert.spv",
+				"shaders/shadow_shader.frag.spv",
+				pipelineConfig
+				);
+		}
 	}
 
-	void ShadowRenderSystem::renderGameObjects(FrameInfo& frameInfo) {
+	void ShadowRenderSystem::cullCasters(FrameInfo& frameInfo, const glm::mat4* faceProjectionViews, float farPlane) {
+		VK3D_PROFILE_ZONE("ShadowRenderSystem::cullCasters");
+
+		Vk3dScene& scene = frameInfo.scene;
+		scene.cullSphere({ frameInfo.lightPosition, farPlane * farPlaneReach }, casters);
+
+		std::array<Vk3dFrustum, Vk3dSwapChain::NUM_CUBE_FACES> faceFrusta{
+			Vk3dFrustum{ faceProjectionViews[0] }, Vk3dFrustum{ faceProjectionViews[1] }, Vk3dFrustum{ faceProjectionViews[2] },
+			Vk3dFrustum{ faceProjectionViews[3] }, Vk3dFrustum{ faceProjectionViews[4] }, Vk3dFrustum{ faceProjectionViews[5] }
+		};
+		cullingStatistics = {};
+		cullingStatistics.casters = static_cast<uint32_t>(casters.size());
+
+		const std::shared_ptr<Vk3dModel>* models = scene.getModels();
+		const uint32_t* slots = scene.getIndexSlots();
+		const Vk3dAabb* worldBounds = scene.getWorldBounds();
+		for (uint32_t i : casters) {
+			// the cube faces have a 90 degree field of view, so the projection scale is 1. The LOD is chosen once for every face.
+			uint32_t lod = scene.selectLod(i, frameInfo.lightPosition, lodScale);
+			float depth = glm::distance(worldBounds[i].center(), frameInfo.lightPosition);
+			uint64_t triangles = models[i]->getTriangleCount(lod);
+			for (uint32_t face = 0; face < faceFrusta.size(); face++) {
+				if (faceFrusta[face].intersect(worldBounds[i]) != Vk3dFrustum::Intersection::Outside) {
+					frameInfo.renderQueue.submit(Vk3dRenderQueue::Pass::Shadow, face, models[i].get(), lod, slots[i], depth);
+					cullingStatistics.faceDraws++;
+					cullingStatistics.drawnTriangles += triangles;
+				}
+				else {
+					cullingStatistics.savedTriangles += triangles;
+				}
+			}
+		}
+	}
+
+	void ShadowRenderSystem::renderFace(FrameInfo& frameInfo, uint32_t face) {
+		VK3D_PROFILE_ZONE("ShadowRenderSystem::renderFace");
 
 		//Set depth bias in order to avoid artifacts
 		
@@ -75,37 +105,33 @@ namespace vk3d {
 			0.0f,
 			depthBiasSlope);
 
-		vk3dShadowPipeline->bind(frameInfo.commandBuffer);
+		vk3dShadowPipelines[face]->bind(frameInfo.commandBuffer);
 
+		std::array<VkDescriptorSet, 2> descriptorSets{ frameInfo.shadowDescriptorSet, frameInfo.objectDescriptorSet };
 		vkCmdBindDescriptorSets(
 			frameInfo.commandBuffer,
 			VK_PIPELINE_BIND_POINT_GRAPHICS,
 			shadowPipelineLayout,
 			0,
-			1,
-			&frameInfo.shadowDescriptorSet,
+			static_cast<uint32_t>(descriptorSets.size()),
+			descriptorSets.data(),
 			0,
 			nullptr);
 
-		for (auto& kv : frameInfo.gameObjects) {
-			auto& obj = kv.second;
-
-			ShadowPushConstantData push{};
-
-			push.modelMatrix = obj.transform.mat4();
-
-			vkCmdPushConstants(
-				frameInfo.commandBuffer,
-				shadowPipelineLayout,
-				VK_SHADER_STAGE_VERTEX_BIT,
-				0,
-				sizeof(ShadowPushConstantData),
-				&push
-			);
-
-			obj.model->bind(frameInfo.commandBuffer);
-			obj.model->draw(frameInfo.commandBuffer);
+		// the six faces only fetch positions
+		if (positionStream) {
+			frameInfo.geometryPool.bindPositions(frameInfo.commandBuffer);
 		}
+		else {
+			frameInfo.geometryPool.bind(frameInfo.commandBuffer);
+		}
+		// the GPU culled the casters against the face and picked their LOD
+		if (frameInfo.gpuCuller) {
+			frameInfo.gpuCuller->drawShadowFace(frameInfo.commandBuffer, face);
+			return;
+		}
+
+		frameInfo.renderQueue.record(frameInfo.commandBuffer, Vk3dRenderQueue::Pass::Shadow, face);
 	}
 
 }
\ No newline at end of file
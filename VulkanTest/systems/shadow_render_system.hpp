@@ -7,6 +7,7 @@
 #include "../vk3d_allocator.hpp"
 #include "../vk3d_frame_info.hpp"
 
+#include <array>
 #include <memory>
 #include <vector>
 
@@ -17,23 +18,53 @@ namespace vk3d {
 		static constexpr float depthBiasConstant = 0.75f;
 		// Slope depth bias factor, applied depending on polygon's slope
 		static constexpr float depthBiasSlope = 0.25f;
+		// Shadow maps are lower resolution than the screen and a caster can be drawn into several faces,
+		// objects are treated as this much smaller when picking their LOD
+		static constexpr float lodScale = 0.5f;
+		// The far plane corners of a 90 degree face are sqrt(3) times the far plane away from the light,
+		// casters are first culled against a sphere of this radius
+		static constexpr float farPlaneReach = 1.7320508f;
 
-		ShadowRenderSystem(Vk3dDevice& device, VkRenderPass renderPass, VkDescriptorSetLayout shadowSetLayout);
+		struct CullingStatistics {
+			// objects with a model within reach of the light
+			uint32_t casters = 0;
+			// draws over the six faces, every caster was drawn into all of them before
+			uint32_t faceDraws = 0;
+			uint64_t drawnTriangles = 0;
+			// triangles of the casters in the faces they were skipped in
+			uint64_t savedTriangles = 0;
+		};
+
+		// With positionStream the casters are drawn from the geometry pool position stream
+		ShadowRenderSystem(Vk3dDevice& device, VkRenderPass renderPass, VkDescriptorSetLayout shadowSetLayout, VkDescriptorSetLayout objectSetLayout, Vk3dModel::VertexFormat vertexFormat, bool positionStream);
 		~ShadowRenderSystem();
 
 		ShadowRenderSystem(const ShadowRenderSystem&) = delete;
 		ShadowRenderSystem& operator=(const ShadowRenderSystem&) = delete;
 
-		void renderGameObjects(FrameInfo& frameInfo);
+		// Submits the casters to the render queue of every cube face their bounds touch. faceProjectionViews are the
+		// NUM_CUBE_FACES matrices of ShadowUbo. Call it once per frame before the queue is sorted, unless frameInfo has
+		// a GPU culler.
+		void cullCasters(FrameInfo& frameInfo, const glm::mat4* faceProjectionViews, float farPlane);
+		// Draws the casters touching the face, in its subpass of the shadow pass, with the GPU culler when there is one
+		void renderFace(FrameInfo& frameInfo, uint32_t face);
+		const CullingStatistics& getCullingStatistics() const { return cullingStatistics; }
 
 	private:
-		void createShadowPipelineLayout(VkDescriptorSetLayout shadowSetLayout);
-		void createShadowPipeline(VkRenderPass renderPass);
+		void createShadowPipelineLayout(VkDescriptorSetLayout shadowSetLayout, VkDescriptorSetLayout objectSetLayout);
+		void createShadowPipelines(VkRenderPass renderPass);
 
 		Vk3dDevice& vk3dDevice;
+		Vk3dModel::VertexFormat vertexFormat;
+		bool positionStream;
 
 		Vk3dAllocator vk3dAllocator{ vk3dDevice };
-		std::unique_ptr<Vk3dPipeline> vk3dShadowPipeline;
+		// one per subpass, a pipeline is created for a single subpass
+		std::array<std::unique_ptr<Vk3dPipeline>, Vk3dSwapChain::NUM_CUBE_FACES> vk3dShadowPipelines;
 		VkPipelineLayout shadowPipelineLayout;
+
+		// reused every frame
+		std::vector<uint32_t> casters;
+		CullingStatistics cullingStatistics;
 	};
 }
\ No newline at end of file
@@ -0,0 +1,275 @@
+#include "vk3d_aabb_tree.hpp"
+
+// std
+#include <algorithm>
+#include <cassert>
+
+namespace vk3d {
+
+	uint32_t Vk3dAabbTree::createProxy(const Vk3dAabb& aabb, uint32_t userData) {
+		uint32_t proxy = allocateNode();
+		nodes[proxy].aabb = { aabb.min - glm::vec3{ AABB_MARGIN }, aabb.max + glm::vec3{ AABB_MARGIN } };
+		nodes[proxy].height = 0;
+		nodes[proxy].userData = userData;
+		insertLeaf(proxy);
+		proxyCount++;
+		return proxy;
+	}
+
+	void Vk3dAabbTree::destroyProxy(uint32_t proxy) {
+		assert(proxy < nodes.size() && nodes[proxy].isLeaf() && nodes[proxy].height == 0 && "Invalid AABB tree proxy");
+		removeLeaf(proxy);
+		freeNode(proxy);
+		proxyCount--;
+	}
+
+	bool Vk3dAabbTree::moveProxy(uint32_t proxy, const Vk3dAabb& aabb) {
+		assert(proxy < nodes.size() && nodes[proxy].isLeaf() && nodes[proxy].height == 0 && "Invalid AABB tree proxy");
+		if (nodes[proxy].aabb.contains(aabb)) {
+			return false;
+		}
+
+		removeLeaf(proxy);
+		nodes[proxy].aabb = { aabb.min - glm::vec3{ AABB_MARGIN }, aabb.max + glm::vec3{ AABB_MARGIN } };
+		insertLeaf(proxy);
+		return true;
+	}
+
+	void Vk3dAabbTree::queryFrustum(const Vk3dFrustum& frustum, std::vector<uint32_t>& userData) const {
+		query(frustum, userData);
+	}
+
+	void Vk3dAabbTree::querySphere(const Vk3dSphere& sphere, std::vector<uint32_t>& userData) const {
+		query(sphere, userData);
+	}
+
+	template <typename Volume>
+	void Vk3dAabbTree::query(const Volume& volume, std::vector<uint32_t>& userData) const {
+		if (root == NULL_NODE) {
+			return;
+		}
+
+		// the height is logarithmic, this stack only grows for degenerate trees
+		std::vector<uint32_t> stack;
+		stack.reserve(64);
+		stack.push_back(root);
+		while (!stack.empty()) {
+			uint32_t index = stack.back();
+			stack.pop_back();
+			const Node& node = nodes[index];
+
+			Vk3dFrustum::Intersection intersection = volume.intersect(node.aabb);
+			if (intersection == Vk3dFrustum::Intersection::Outside) {
+				continue;
+			}
+			if (node.isLeaf()) {
+				userData.push_back(node.userData);
+			}
+			else if (intersection == Vk3dFrustum::Intersection::Inside) {
+				appendLeaves(index, userData);
+			}
+			else {
+				stack.push_back(node.child1);
+				stack.push_back(node.child2);
+			}
+		}
+	}
+
+	void Vk3dAabbTree::appendLeaves(uint32_t node, std::vector<uint32_t>& userData) const {
+		if (nodes[node].isLeaf()) {
+			userData.push_back(nodes[node].userData);
+			return;
+		}
+		appendLeaves(nodes[node].child1, userData);
+		appendLeaves(nodes[node].child2, userData);
+	}
+
+	uint32_t Vk3dAabbTree::allocateNode() {
+		if (freeList == NULL_NODE) {
+			nodes.emplace_back();
+			return static_cast<uint32_t>(nodes.size() - 1);
+		}
+
+		uint32_t node = freeList;
+		freeList = nodes[node].parent;
+		nodes[node] = Node{};
+		return node;
+	}
+
+	void Vk3dAabbTree::freeNode(uint32_t node) {
+		nodes[node].parent = freeList;
+		nodes[node].child1 = NULL_NODE;
+		nodes[node].child2 = NULL_NODE;
+		nodes[node].height = -1;
+		freeList = node;
+	}
+
+	void Vk3dAabbTree::insertLeaf(uint32_t leaf) {
+		if (root == NULL_NODE) {
+			root = leaf;
+			nodes[leaf].parent = NULL_NODE;
+			return;
+		}
+
+		// descend while splitting a child is cheaper than making the leaf a sibling of the current node
+		const Vk3dAabb leafAabb = nodes[leaf].aabb;
+		uint32_t index = root;
+		while (!nodes[index].isLeaf()) {
+			const Node& node = nodes[index];
+			float combinedPerimeter = Vk3dAabb::combine(node.aabb, leafAabb).perimeter();
+			// a new parent of node and leaf
+			float cost = 2.f * combinedPerimeter;
+			// every ancestor grows the same whichever child the leaf goes under
+			float inheritanceCost = 2.f * (combinedPerimeter - node.aabb.perimeter());
+
+			auto childCost = [&](uint32_t child) {
+				float perimeter = Vk3dAabb::combine(nodes[child].aabb, leafAabb).perimeter();
+				return nodes[child].isLeaf() ? perimeter + inheritanceCost : perimeter - nodes[child].aabb.perimeter() + inheritanceCost;
+			};
+			float cost1 = childCost(node.child1);
+			float cost2 = childCost(node.child2);
+
+			if (cost < cost1 && cost < cost2) {
+				break;
+			}
+			index = cost1 < cost2 ? node.child1 : node.child2;
+		}
+
+		uint32_t sibling = index;
+		uint32_t oldParent = nodes[sibling].parent;
+		uint32_t newParent = allocateNode();
+		nodes[newParent].parent = oldParent;
+		nodes[newParent].aabb = Vk3dAabb::combine(leafAabb, nodes[sibling].aabb);
+		nodes[newParent].height = nodes[sibling].height + 1;
+		nodes[newParent].child1 = sibling;
+		nodes[newParent].child2 = leaf;
+		nodes[sibling].parent = newParent;
+		nodes[leaf].parent = newParent;
+
+		if (oldParent == NULL_NODE) {
+			root = newParent;
+		}
+		else if (nodes[oldParent].child1 == sibling) {
+			nodes[oldParent].child1 = newParent;
+		}
+		else {
+			nodes[oldParent].child2 = newParent;
+		}
+
+		refit(nodes[leaf].parent);
+	}
+
+	void Vk3dAabbTree::removeLeaf(uint32_t leaf) {
+		if (leaf == root) {
+			root = NULL_NODE;
+			return;
+		}
+
+		// the sibling takes the place of the parent
+		uint32_t parent = nodes[leaf].parent;
+		uint32_t grandParent = nodes[parent].parent;
+		uint32_t sibling = nodes[parent].child1 == leaf ? nodes[parent].child2 : nodes[parent].child1;
+		nodes[sibling].parent = grandParent;
+		freeNode(parent);
+
+		if (grandParent == NULL_NODE) {
+			root = sibling;
+			return;
+		}
+		if (nodes[grandParent].child1 == parent) {
+			nodes[grandParent].child1 = sibling;
+		}
+		else {
+			nodes[grandParent].child2 = sibling;
+		}
+		refit(grandParent);
+	}
+
+	void Vk3dAabbTree::refit(uint32_t node) {
+		while (node != NULL_NODE) {
+			node = balance(node);
+
+			Node& current = nodes[node];
+			const Node& child1 = nodes[current.child1];
+			const Node& child2 = nodes[current.child2];
+			current.height = 1 + std::max(child1.height, child2.height);
+			current.aabb = Vk3dAabb::combine(child1.aabb, child2.aabb);
+
+			node = current.parent;
+		}
+	}
+
+	uint32_t Vk3dAabbTree::balance(uint32_t a) {
+		Node& nodeA = nodes[a];
+		if (nodeA.isLeaf() || nodeA.height < 2) {
+			return a;
+		}
+
+		uint32_t b = nodeA.child1;
+		uint32_t c = nodeA.child2;
+		int32_t heightDifference = nodes[c].height - nodes[b].height;
+		if (heightDifference >= -1 && heightDifference <= 1) {
+			return a;
+		}
+
+		// the taller child goes up and a takes its place, keeping the taller grandchild
+		// and handing the shorter one to a
+		uint32_t up = heightDifference > 1 ? c : b;
+		uint32_t other = heightDifference > 1 ? b : c;
+		Node& nodeUp = nodes[up];
+		uint32_t f = nodeUp.child1;
+		uint32_t g = nodeUp.child2;
+
+		nodeUp.child1 = a;
+		nodeUp.parent = nodeA.parent;
+		nodeA.parent = up;
+		if (nodeUp.parent == NULL_NODE) {
+			root = up;
+		}
+		else if (nodes[nodeUp.parent].child1 == a) {
+			nodes[nodeUp.parent].child1 = up;
+		}
+		else {
+			nodes[nodeUp.parent].child2 = up;
+		}
+
+		uint32_t taller = nodes[f].height > nodes[g].height ? f : g;
+		uint32_t shorter = taller == f ? g : f;
+		nodeUp.child2 = taller;
+		if (up == c) {
+			nodeA.child2 = shorter;
+		}
+		else {
+			nodeA.child1 = shorter;
+		}
+		nodes[shorter].parent = a;
+
+		nodeA.aabb = Vk3dAabb::combine(nodes[other].aabb, nodes[shorter].aabb);
+		nodeA.height = 1 + std::max(nodes[other].height, nodes[shorter].height);
+		nodeUp.aabb = Vk3dAabb::combine(nodeA.aabb, nodes[taller].aabb);
+		nodeUp.height = 1 + std::max(nodeA.height, nodes[taller].height);
+		return up;
+	}
+
+	bool Vk3dAabbTree::validate() const {
+		if (root == NULL_NODE) {
+			return proxyCount == 0;
+		}
+		return nodes[root].parent == NULL_NODE && validateNode(root);
+	}
+
+	bool Vk3dAabbTree::validateNode(uint32_t node) const {
+		const Node& current = nodes[node];
+		if (current.isLeaf()) {
+			return current.height == 0 && current.child2 == NULL_NODE;
+		}
+
+		const Node& child1 = nodes[current.child1];
+		const Node& child2 = nodes[current.child2];
+		return child1.parent == node && child2.parent == node
+			&& current.height == 1 + std::max(child1.height, child2.height)
+			&& current.aabb.contains(child1.aabb) && current.aabb.contains(child2.aabb)
+			&& validateNode(current.child1) && validateNode(current.child2);
+	}
+
+}
@@ -0,0 +1,74 @@
+#pragma once
+
+#include "vk3d_frustum.hpp"
+
+// std
+#include <cstdint>
+#include <vector>
+
+namespace vk3d {
+	// Dynamic bounding volume hierarchy over moving boxes. Every proxy is a leaf holding a box enlarged by
+	// AABB_MARGIN, so small moves don't touch the tree; a proxy leaving its box is removed and inserted again.
+	// Leaves are inserted next to the sibling that grows the total perimeter the least, and the ancestors are
+	// rebalanced with AVL rotations on the way up, which keeps the height logarithmic whatever the insertion order.
+	class Vk3dAabbTree {
+	public:
+		static constexpr uint32_t NULL_NODE = UINT32_MAX;
+		static constexpr float AABB_MARGIN = 0.1f;
+
+		Vk3dAabbTree() = default;
+
+		Vk3dAabbTree(const Vk3dAabbTree&) = delete;
+		Vk3dAabbTree& operator=(const Vk3dAabbTree&) = delete;
+
+		// userData is returned by the queries, the proxy id stays valid until destroyProxy
+		uint32_t createProxy(const Vk3dAabb& aabb, uint32_t userData);
+		void destroyProxy(uint32_t proxy);
+		// Returns true when the proxy had to be reinserted
+		bool moveProxy(uint32_t proxy, const Vk3dAabb& aabb);
+
+		// Append the user data of every proxy whose enlarged box intersects the volume, in no particular order.
+		// Subtrees fully inside the volume are appended without testing their leaves.
+		void queryFrustum(const Vk3dFrustum& frustum, std::vector<uint32_t>& userData) const;
+		void querySphere(const Vk3dSphere& sphere, std::vector<uint32_t>& userData) const;
+
+		uint32_t getProxyCount() const { return proxyCount; }
+		// 0 when empty, 1 with a single proxy
+		uint32_t getHeight() const { return root != NULL_NODE ? static_cast<uint32_t>(nodes[root].height) + 1 : 0; }
+		// Checks the links, boxes and heights of every node, for debugging
+		bool validate() const;
+
+	private:
+		struct Node {
+			Vk3dAabb aabb;
+			// next free node while the node is free
+			uint32_t parent = NULL_NODE;
+			uint32_t child1 = NULL_NODE;
+			uint32_t child2 = NULL_NODE;
+			// 0 for leaves, -1 for free nodes
+			int32_t height = -1;
+			uint32_t userData = 0;
+
+			bool isLeaf() const { return child1 == NULL_NODE; }
+		};
+
+		uint32_t allocateNode();
+		void freeNode(uint32_t node);
+		void insertLeaf(uint32_t leaf);
+		void removeLeaf(uint32_t leaf);
+		// Walks from node to the root, rotating unbalanced nodes and refitting boxes and heights
+		void refit(uint32_t node);
+		// Returns the node now at the place of a
+		uint32_t balance(uint32_t a);
+		// Volume has intersect(const Vk3dAabb&) returning a Vk3dFrustum::Intersection
+		template <typename Volume>
+		void query(const Volume& volume, std::vector<uint32_t>& userData) const;
+		void appendLeaves(uint32_t node, std::vector<uint32_t>& userData) const;
+		bool validateNode(uint32_t node) const;
+
+		std::vector<Node> nodes;
+		uint32_t root = NULL_NODE;
+		uint32_t freeList = NULL_NODE;
+		uint32_t proxyCount = 0;
+	};
+}
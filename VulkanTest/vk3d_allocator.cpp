@@ -68,4 +68,10 @@ namespace vk3d {
 		vmaDestroyImage(allocator, image, constantImageAllocation);
 	}
 
+	VkDeviceSize Vk3dAllocator::getAllocationSize(VmaAllocation allocation) {
+		VmaAllocationInfo allocationInfo{};
+		vmaGetAllocationInfo(allocator, allocation, &allocationInfo);
+		return allocationInfo.size;
+	}
+
 }
\ No newline at end of file
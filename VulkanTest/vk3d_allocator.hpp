@@ -28,6 +28,8 @@ namespace vk3d {
             VkImage& image,
             VmaAllocation& constantImageAllocation);
         void destroyImage(VkImage& image, VmaAllocation& constantImageAllocation);
+        // device memory VMA reserved for the allocation, at least the requested size
+        VkDeviceSize getAllocationSize(VmaAllocation allocation);
 
     private:
         Vk3dDevice& device;
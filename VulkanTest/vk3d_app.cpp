@@ -2,6 +2,11 @@
 
 #include "keyboard_movement_controller.hpp"
 #include "vk3d_camera.hpp"
+#include "vk3d_profiler.hpp"
+#include "vk3d_frustum.hpp"
+#include "vk3d_gpu_scene.hpp"
+#include "vk3d_gpu_culler.hpp"
+#include "vk3d_render_queue.hpp"
 #include "systems/shadow_render_system.hpp"
 #include "systems/scene_render_system.hpp"
 #include "systems/reflection_render_system.hpp"
@@ -24,7 +29,22 @@
 
 
 namespace vk3d {
-	Vk3dApp::Vk3dApp() {
+	Vk3dApp::Vk3dApp(const Vk3dAppSettings& settings) : settings{ settings } {
+		if (!settings.cpuTracePath.empty()) {
+			if (!Vk3dProfiler::isCompiledIn()) {
+				std::cout << "CPU profiling was disabled at compile time, the trace will be empty" << std::endl;
+			}
+			VK3D_PROFILE_THREAD_NAME("main");
+			Vk3dProfiler::setEnabled(true);
+		}
+
+		// decided before any model loads, the GPU driven draws only take indexed ones
+		if (this->settings.gpuDrivenDraws && !vk3dDevice.supportsMultiDrawIndirect()) {
+			std::cout << "multiDrawIndirect is not supported, the passes draw from the CPU" << std::endl;
+			this->settings.gpuDrivenDraws = false;
+		}
+
+		VK3D_PROFILE_ZONE("Vk3dApp::loadGameObjects");
 		loadGameObjects();
 	}
 
@@ -32,15 +52,38 @@ namespace vk3d {
 	}
 
 	void Vk3dApp::run() {
-		ShadowRenderSystem shadowRenderSystem{ vk3dDevice, vk3dRenderer.getShadowRenderPass(), vk3dRenderer.getShadowDescriptorSetLayout() };
-		ReflectionRenderSystem reflectionRenderSystem{ vk3dDevice, vk3dRenderer.getMappingsRenderPass(), vk3dRenderer.getMappingsDescriptorSetLayout(), vk3dRenderer.getUVReflectionRenderPass(), vk3dRenderer.getUVReflectionDescriptorSetLayout() };
+		runFrameLoop();
+
+		if (!settings.cpuTracePath.empty()) {
+			Vk3dProfiler::setEnabled(false);
+			Vk3dProfiler::writeChromeTrace(settings.cpuTracePath);
+			std::cout << "CPU trace written to " << settings.cpuTracePath << std::endl;
+		}
+	}
+
+	void Vk3dApp::runFrameLoop() {
+		VK3D_PROFILE_ZONE("Vk3dApp::run");
+		bool gpuDriven = settings.gpuDrivenDraws;
+		// what every pass draws the objects with, read by slot
+		Vk3dGpuScene gpuScene{ vk3dDevice, vk3dAllocator, gpuDriven };
+		ShadowRenderSystem shadowRenderSystem{ vk3dDevice, vk3dRenderer.getShadowRenderPass(), vk3dRenderer.getShadowDescriptorSetLayout(), gpuScene.getDescriptorSetLayout(), settings.vertexFormat, settings.positionStream };
+		ReflectionRenderSystem reflectionRenderSystem{ vk3dDevice, vk3dRenderer.getMappingsRenderPass(), vk3dRenderer.getMappingsDescriptorSetLayout(), vk3dRenderer.getUVReflectionRenderPass(), vk3dRenderer.getUVReflectionDescriptorSetLayout(), gpuScene.getDescriptorSetLayout(), settings.vertexFormat };
 		SceneRenderSystem sceneRenderSystem{
 			vk3dDevice, 
 			vk3dRenderer.getLightingRenderPass(), 
 			vk3dRenderer.getGBufferDescriptorSetLayout(), 
 			vk3dRenderer.getCompositionDescriptorSetLayout(),
 			vk3dRenderer.getPostProcessingRenderPass(),
-			vk3dRenderer.getPostProcessingDescriptorSetLayout()};
+			vk3dRenderer.getPostProcessingDescriptorSetLayout(),
+			gpuScene.getDescriptorSetLayout(),
+			settings.vertexFormat};
+		// every pass draws through it, it lives as long as they do
+		std::unique_ptr<Vk3dGpuCuller> gpuCuller;
+		// what the passes draw without it
+		Vk3dRenderQueue renderQueue;
+		if (gpuDriven) {
+			gpuCuller = std::make_unique<Vk3dGpuCuller>(vk3dDevice, vk3dAllocator, vk3dRenderer.getGpuProfiler(), gpuScene.getDescriptorSetLayout(), settings.occlusionCulling);
+		}
 		PointLightSystem pointLightSystem{ vk3dDevice, vk3dRenderer.getLightingRenderPass(), vk3dRenderer.getGBufferDescriptorSetLayout(), vk3dRenderer.getCompositionDescriptorSetLayout() };
 		Vk3dCamera camera{};
 		Vk3dCamera light{};
@@ -53,6 +96,15 @@ namespace vk3d {
 
 		auto currentTime = std::chrono::high_resolution_clock::now();
 
+		std::unique_ptr<Vk3dBenchmark> benchmark;
+		if (settings.benchmarkFrames > 0) {
+			benchmark = std::make_unique<Vk3dBenchmark>(settings.benchmarkFrames);
+			// measured frames always draw the whole scene
+			vk3dModelLoader.finish();
+			vk3dUploadBatcher.finish();
+			reportLoadedModels();
+		}
+
 		Vk3dSwapChain::ShadowUbo shadowUbo{};
 		Vk3dSwapChain::GBufferUbo gBufferUbo{};
 		Vk3dSwapChain::CompositionUbo compositionUbo{};
@@ -96,8 +148,12 @@ namespace vk3d {
 			shadowUbo.projectionView[faceIndex] = light.getProjection() * light.getView();
 		}
 
-		while (!vk3dWindow.shouldClose()) {
-			glfwPollEvents();
+		std::vector<uint32_t> visibleObjects;
+		while (!vk3dWindow.shouldClose() && !(benchmark && benchmark->isFinished())) {
+			VK3D_PROFILE_ZONE("frame");
+			if (benchmark) {
+				benchmark->beginFrame();
+			}
 
 			auto newTime = std::chrono::high_resolution_clock::now();
 			float frameTime = std::chrono::duration<float, std::chrono::seconds::period>(newTime - currentTime).count();
@@ -105,13 +161,35 @@ namespace vk3d {
 
 			//Limit frameTime to avoid resizing delay
 			frameTime = glm::min(frameTime, MIN_SECONDS_PER_FRAME);
-			
-			cameraController.moveInPlaneXZ(vk3dWindow.getGLFWwindow(), frameTime, viewerObject);
+
+			if (!vk3dWindow.isHeadless()) {
+				glfwPollEvents();
+				cameraController.moveInPlaneXZ(vk3dWindow.getGLFWwindow(), frameTime, viewerObject);
+			}
+			else {
+				// fixed time step keeps headless runs deterministic
+				frameTime = MIN_SECONDS_PER_FRAME;
+			}
+			// models uploaded this frame are assigned first, so their bounds are in the tree before culling
+			streamModels();
+			// no render system is iterating the scene here
+			scene.compact();
+			scene.updateMatrices();
+
 			camera.setViewYXZ(viewerObject.transform.translation, viewerObject.transform.rotation);
 
 			float aspect = vk3dRenderer.getAspectRatio();
 			camera.setPerspectiveProjection(glm::radians(50.0f), aspect, CAMERA_NEAR_PLANE, CAMERA_FAR_PLANE);
 
+			glm::mat4 projectionView = camera.getProjection() * camera.getView();
+			// the GPU culler tests every object itself
+			if (!gpuCuller) {
+				scene.cullFrustum(Vk3dFrustum{ projectionView }, visibleObjects);
+				if (benchmark) {
+					benchmark->addCullingCounts("camera", scene.getDrawableCount(), static_cast<uint32_t>(visibleObjects.size()));
+				}
+			}
+
 			if (auto commandBuffer = vk3dRenderer.beginFrame()) {
 				VkExtent2D extent = vk3dRenderer.getExtent();
 				glm::vec2 invResolution = glm::vec2(1.f / extent.width, 1.f / extent.height);
@@ -119,6 +197,7 @@ namespace vk3d {
 				postProcessingUbo.invResolution = invResolution;
 
 				int frameIndex = vk3dRenderer.getFrameIndex();
+				gpuScene.update(commandBuffer, frameIndex, scene);
 
 				FrameInfo frameInfo{
 					frameIndex,
@@ -131,7 +210,14 @@ namespace vk3d {
 					vk3dRenderer.getCurrentGBufferDescriptorSet(),
 					vk3dRenderer.getCurrentCompositionDescriptorSet(),
 					vk3dRenderer.getCurrentPostProcessingDescriptorSet(),
-					gameObjects
+					scene,
+					renderQueue,
+					gpuScene.getDescriptorSet(frameIndex),
+					visibleObjects,
+					gpuCuller.get(),
+					viewerObject.transform.translation,
+					lightObject.transform.translation,
+					vk3dGeometryPool
 				};
 
 				vk3dRenderer.updateCurrentShadowUbo(&shadowUbo);
@@ -158,15 +244,64 @@ namespace vk3d {
 
 				vk3dRenderer.updateCurrentPostProcessingUbo(&postProcessingUbo);
 
-				// render shadows
+				// cull the shadow casters and the camera passes
+				if (gpuCuller) {
+					Vk3dGpuCuller::CullInfo cullInfo{};
+					cullInfo.projectionView = projectionView;
+					cullInfo.viewPosition = viewerObject.transform.translation;
+					cullInfo.projectionScale = camera.getProjection()[1][1];
+					cullInfo.faceProjectionViews = shadowUbo.projectionView;
+					cullInfo.lightPosition = lightObject.transform.translation;
+					cullInfo.shadowReach = LIGHT_FAR_PLANE * ShadowRenderSystem::farPlaneReach;
+					cullInfo.shadowLodScale = ShadowRenderSystem::lodScale;
+					gpuCuller->prepare(frameIndex, gpuScene, cullInfo, extent);
+					if (benchmark) {
+						// counts of an earlier frame, the GPU has finished it
+						const auto& statistics = gpuCuller->getStatistics();
+						if (statistics.drawable > 0) {
+							benchmark->addCullingCounts("camera", statistics.drawable, statistics.frustumVisible);
+							if (gpuCuller->isOcclusionCulling()) {
+								benchmark->addCullingCounts("occlusion", statistics.frustumVisible, statistics.earlyVisible + statistics.lateVisible);
+							}
+							benchmark->addCullingCounts("shadow", statistics.drawable, statistics.casters);
+							benchmark->addTriangleCounts("shadow", statistics.drawnShadowTriangles, statistics.savedShadowTriangles);
+						}
+					}
+					gpuCuller->cull(commandBuffer);
+				}
+				else {
+					renderQueue.clear();
+					shadowRenderSystem.cullCasters(frameInfo, shadowUbo.projectionView, LIGHT_FAR_PLANE);
+					if (benchmark) {
+						const auto& statistics = shadowRenderSystem.getCullingStatistics();
+						benchmark->addCullingCounts("shadow", scene.getDrawableCount(), statistics.casters);
+						benchmark->addTriangleCounts("shadow", statistics.drawnTriangles, statistics.savedTriangles);
+					}
+					reflectionRenderSystem.submitDraws(frameInfo);
+					sceneRenderSystem.submitDraws(frameInfo);
+					renderQueue.sort(gpuScene);
+				}
+
+				// render shadows, every caster only into the cube faces it touches
 				vk3dRenderer.beginShadowRenderPass(commandBuffer);
-				shadowRenderSystem.renderGameObjects(frameInfo);
+				for (uint32_t face = 0; face < Vk3dSwapChain::NUM_CUBE_FACES; face++) {
+					if (face > 0) {
+						vk3dRenderer.nextShadowSubpass(commandBuffer);
+					}
+					shadowRenderSystem.renderFace(frameInfo, face);
+				}
 				vk3dRenderer.endRenderPass(commandBuffer);
 
-				// render mappings
+				// render mappings, with occlusion culling its depth builds the pyramid and a late pass draws what it uncovers
 				vk3dRenderer.beginMappingsRenderPass(commandBuffer);
 				reflectionRenderSystem.renderMappings(frameInfo);
 				vk3dRenderer.endRenderPass(commandBuffer);
+				if (gpuCuller && gpuCuller->isOcclusionCulling()) {
+					gpuCuller->cullLate(commandBuffer, vk3dRenderer.getCurrentMappingsDepthAttachment());
+					vk3dRenderer.beginMappingsLateRenderPass(commandBuffer);
+					reflectionRenderSystem.renderMappings(frameInfo, Vk3dGpuCuller::Phase::Late);
+					vk3dRenderer.endRenderPass(commandBuffer);
+				}
 
 				// render reflection map
 				vk3dRenderer.beginUVReflectionRenderPass(commandBuffer);
@@ -175,7 +310,9 @@ namespace vk3d {
 
 				// render swap chain
 				vk3dRenderer.beginLightingRenderPass(commandBuffer);
-				sceneRenderSystem.renderGameObjectsLighting(frameInfo, glm::inverse(camera.getProjection() * camera.getView()), invResolution);
+				sceneRenderSystem.renderGBuffer(frameInfo);
+				vk3dRenderer.nextLightingSubpass(commandBuffer);
+				sceneRenderSystem.renderComposition(frameInfo, glm::inverse(camera.getProjection() * camera.getView()), invResolution);
 				pointLightSystem.render(frameInfo);
 				vk3dRenderer.endRenderPass(commandBuffer);
 				vk3dRenderer.beginPostProcessingRenderPass(commandBuffer);
@@ -184,104 +321,105 @@ namespace vk3d {
 
 				vk3dRenderer.endFrame();
 			}
+
+			if (benchmark) {
+				benchmark->endFrame();
+				benchmark->addGpuFrameTime(vk3dRenderer.getLastGpuFrameTime());
+			}
 		}
 		vkDeviceWaitIdle(vk3dDevice.device());
+		vk3dRenderer.getGpuProfiler().readPendingResults();
+
+		if (benchmark) {
+			benchmark->printReport(std::cout);
+			vk3dRenderer.getGpuProfiler().printRollingAverage(std::cout);
+		}
+
+		if (!settings.gpuProfilePath.empty()) {
+			exportGpuProfile();
+		}
+	}
+
+	void Vk3dApp::exportGpuProfile() {
+		auto& gpuProfiler = vk3dRenderer.getGpuProfiler();
+		const std::string& path = settings.gpuProfilePath;
+		const std::string jsonExtension = ".json";
+
+		if (path.size() >= jsonExtension.size() && path.compare(path.size() - jsonExtension.size(), jsonExtension.size(), jsonExtension) == 0) {
+			gpuProfiler.exportJson(path);
+		}
+		else {
+			gpuProfiler.exportCsv(path);
+		}
+		std::cout << "GPU profile written to " << path << std::endl;
 	}
 
 	void Vk3dApp::loadGameObjects() {
+		loadStartTime = std::chrono::high_resolution_clock::now();
+
+		// everything is placed relative to the room, moving it moves the whole scene
+		auto room = scene.createObject();
+
+		std::vector<Vk3dScene::Handle> quadObjects;
+		// floor
+		quadObjects.push_back(scene.createObject({ { 0.f, 0.f, 6.f }, { 9.f, 1.f, 3.f } }, room));
+		quadObjects.push_back(scene.createObject({ { -6.f, 0.f, 0.f }, { 3.f, 1.f, 3.f } }, room));
+		quadObjects.push_back(scene.createObject({ { 6.f, 0.f, 0.f }, { 3.f, 1.f, 3.f } }, room));
+		quadObjects.push_back(scene.createObject({ { 0.f, 0.f, -6.f }, { 9.f, 1.f, 3.f } }, room));
+		// walls: right, front, left, back and top
+		quadObjects.push_back(scene.createObject({ { 9.f, -9.f, 0.f }, { 9.f, 1.f, 9.f }, { 0.f, 0.f, glm::radians(-90.0f) } }, room));
+		quadObjects.push_back(scene.createObject({ { 0.f, -9.f, 9.f }, { 9.f, 1.f, 9.f }, { glm::radians(90.0f), 0.f, 0.f } }, room));
+		quadObjects.push_back(scene.createObject({ { -9.f, -9.f, 0.f }, { 9.f, 1.f, 9.f }, { 0.f, 0.f, glm::radians(90.0f) } }, room));
+		quadObjects.push_back(scene.createObject({ { 0.f, -9.f, -9.f }, { 9.f, 1.f, 9.f }, { glm::radians(-90.0f), 0.f, 0.f } }, room));
+		quadObjects.push_back(scene.createObject({ { 0.f, -18.f, 0.f }, { 9.f, 1.f, 9.f }, { glm::radians(180.0f), 0.f, 0.f } }, room));
+
+		std::vector<Vk3dScene::Handle> mirrorQuadObjects;
+		auto floorMirror = scene.createObject({ { 0.f, 0.f, 0.f }, { 3.f, 1.f, 3.f } }, room);
+		scene.setReflection(scene.getIndex(floorMirror), 1.0f);
+		mirrorQuadObjects.push_back(floorMirror);
+
+		std::vector<Vk3dScene::Handle> coloredCubeObjects;
+		coloredCubeObjects.push_back(scene.createObject({ { 1.f, -1.f, 0.5f }, { 0.5f, 1.f, 0.5f } }, room));
+		coloredCubeObjects.push_back(scene.createObject({ { -.5f, -1.f, 1.5f }, { 0.5f, 1.f, 0.5f } }, room));
+		coloredCubeObjects.push_back(scene.createObject({ { .5f, -1.f, 2.5f }, { 0.5f, 1.f, 0.5f } }, room));
+
+		// the objects are skipped by the render systems until their model is resident
+		vk3dModelRegistry.load("models/quad.obj", assignModel(std::move(quadObjects)));
+		vk3dModelRegistry.load("models/mirror_quad.obj", assignModel(std::move(mirrorQuadObjects)));
+		vk3dModelRegistry.load("models/colored_cube.obj", assignModel(std::move(coloredCubeObjects)));
+	}
 
-		std::shared_ptr<Vk3dModel> quadModel = Vk3dModel::createModelFromFile(vk3dDevice, "models/quad.obj", vk3dAllocator);
-
-		gameModels.push_back(std::move(quadModel));
-		auto floorFar = Vk3dGameObject::createGameObject();
-		floorFar.model = gameModels.back();
-		floorFar.transform.translation = {0.f, 0.f, 6.f };
-		floorFar.transform.scale = glm::vec3(9.f, 1.f, 3.f);
-		gameObjects.emplace(floorFar.getId(), std::move(floorFar));
-
-		auto floorLeft = Vk3dGameObject::createGameObject();
-		floorLeft.model = gameModels.back();
-		floorLeft.transform.translation = { -6.f, 0.f, 0.f };
-		floorLeft.transform.scale = glm::vec3(3.f, 1.f, 3.f);
-		gameObjects.emplace(floorLeft.getId(), std::move(floorLeft));
-
-		auto floorRight = Vk3dGameObject::createGameObject();
-		floorRight.model = gameModels.back();
-		floorRight.transform.translation = { 6.f, 0.f, 0.f };
-		floorRight.transform.scale = glm::vec3(3.f, 1.f, 3.f);
-		gameObjects.emplace(floorRight.getId(), std::move(floorRight));
-
-		auto floorNear = Vk3dGameObject::createGameObject();
-		floorNear.model = gameModels.back();
-		floorNear.transform.translation = { 0.f, 0.f, -6.f };
-		floorNear.transform.scale = glm::vec3(9.f, 1.f, 3.f);
-		gameObjects.emplace(floorNear.getId(), std::move(floorNear));
-
-		auto right = Vk3dGameObject::createGameObject();
-		right.model = gameModels.back();
-		right.transform.translation = { 9.f, -9.f, 0.f };
-		right.transform.scale = glm::vec3(9.f, 1.f, 9.f);
-		right.transform.rotation = glm::vec3(0.f, 0.f, glm::radians(-90.0f));
-		gameObjects.emplace(right.getId(), std::move(right));
-
-		auto front = Vk3dGameObject::createGameObject();
-		front.model = gameModels.back();
-		front.transform.translation = { 0.f, -9.f, 9.f };
-		front.transform.scale = glm::vec3(9.f, 1.f, 9.f);
-		front.transform.rotation = glm::vec3(glm::radians(90.0f), 0.f, 0.f);
-		gameObjects.emplace(front.getId(), std::move(front));
-
-		auto left = Vk3dGameObject::createGameObject();
-		left.model = gameModels.back();
-		left.transform.translation = { -9.f, -9.f, 0.f };
-		left.transform.scale = glm::vec3(9.f, 1.f, 9.f);
-		left.transform.rotation = glm::vec3(0.f, 0.f, glm::radians(90.0f));
-		gameObjects.emplace(left.getId(), std::move(left));
-
-		auto back = Vk3dGameObject::createGameObject();
-		back.model = gameModels.back();
-		back.transform.translation = { 0.f, -9.f, -9.f };
-		back.transform.scale = glm::vec3(9.f, 1.f, 9.f);
-		back.transform.rotation = glm::vec3(glm::radians(-90.0f), 0.f, 0.f);
-		gameObjects.emplace(back.getId(), std::move(back));
-
-		auto top = Vk3dGameObject::createGameObject();
-		top.model = gameModels.back();
-		top.transform.translation = { 0.f, -18.f, 0.f };
-		top.transform.scale = glm::vec3(9.f, 1.f, 9.f);
-		top.transform.rotation = glm::vec3(glm::radians(180.0f), 0.f, 0.f);
-		gameObjects.emplace(top.getId(), std::move(top));
-
-		std::shared_ptr<Vk3dModel> mirrorQuadModel = Vk3dModel::createModelFromFile(vk3dDevice, "models/mirror_quad.obj", vk3dAllocator);
-
-		gameModels.push_back(std::move(mirrorQuadModel));
-		auto floorMirror = Vk3dGameObject::createGameObject();
-		floorMirror.model = gameModels.back();
-		floorMirror.transform.translation = { 0.f, 0.f, 0.f };
-		floorMirror.transform.scale = glm::vec3(3.f, 1.f, 3.f);
-		floorMirror.reflection = 1.0f;
-		gameObjects.emplace(floorMirror.getId(), std::move(floorMirror));
-		
+	Vk3dModelLoader::Callback Vk3dApp::assignModel(std::vector<Vk3dScene::Handle> objects) {
+		return [this, objects](const std::shared_ptr<Vk3dModel>& model) {
+			// the cull shader only writes indexed commands, the objects would silently never be drawn
+			if (settings.gpuDrivenDraws && !model->isIndexed()) {
+				throw std::runtime_error("failed to load model without indices, GPU driven draws need them (use --cpu-draws)!");
+			}
+			for (auto object : objects) {
+				// destroyed while the model was streaming in
+				if (scene.isValid(object)) {
+					scene.setModel(scene.getIndex(object), model);
+				}
+			}
+		};
+	}
+
+	void Vk3dApp::streamModels() {
+		uint32_t resident = vk3dModelLoader.update();
+		// a single submission for every model uploaded this frame
+		vk3dUploadBatcher.flush();
+		vk3dModelRegistry.update();
+		if (resident > 0 && vk3dModelLoader.getPendingCount() == 0) {
+			reportLoadedModels();
+		}
+	}
 
-		std::shared_ptr<Vk3dModel> coloredCubeModel = Vk3dModel::createModelFromFile(vk3dDevice, "models/colored_cube.obj", vk3dAllocator);
-		gameModels.push_back(std::move(coloredCubeModel));
-		auto coloredCube = Vk3dGameObject::createGameObject();
-		coloredCube.model = gameModels.back();
-		coloredCube.transform.translation = { 1.f, -1.f, 0.5f };
-		coloredCube.transform.scale = glm::vec3(0.5f, 1.f, 0.5f);
-		gameObjects.emplace(coloredCube.getId(), std::move(coloredCube));
-
-		auto coloredCube2 = Vk3dGameObject::createGameObject();
-		coloredCube2.model = gameModels.back();
-		coloredCube2.transform.translation = { -.5f, -1.f, 1.5f };
-		coloredCube2.transform.scale = glm::vec3(0.5f, 1.f, 0.5f);
-		gameObjects.emplace(coloredCube2.getId(), std::move(coloredCube2));
-
-		auto coloredCube3 = Vk3dGameObject::createGameObject();
-		coloredCube3.model = gameModels.back();
-		coloredCube3.transform.translation = { .5f, -1.f, 2.5f };
-		coloredCube3.transform.scale = glm::vec3(0.5f, 1.f, 0.5f);
-		gameObjects.emplace(coloredCube3.getId(), std::move(coloredCube3));
+	void Vk3dApp::reportLoadedModels() {
+		double loadTime = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - loadStartTime).count();
+		std::cout << "Loaded " << vk3dModelRegistry.getModelCount() << " models in " << loadTime << " ms with " << vk3dUploadBatcher.getSubmitCount() << " upload submissions" << std::endl;
+		std::cout << "Vertex buffers: " << vk3dModelRegistry.getVertexBufferSize() << " bytes" << std::endl;
+		std::cout << "Geometry pool: " << vk3dModelRegistry.getResidentSize() << " of " << vk3dGeometryPool.getMemorySize()
+			<< " bytes used, budget " << vk3dModelRegistry.getBudget() << " bytes" << std::endl;
 	}
 
 }
\ No newline at end of file
@@ -3,14 +3,45 @@
 #include "vk3d_window.hpp"
 #include "vk3d_device.hpp"
 #include "vk3d_game_object.hpp"
+#include "vk3d_scene.hpp"
 #include "vk3d_allocator.hpp"
 #include "vk3d_renderer.hpp"
+#include "vk3d_geometry_pool.hpp"
+#include "vk3d_upload_batcher.hpp"
+#include "vk3d_model_loader.hpp"
+#include "vk3d_model_registry.hpp"
 #include "vk3d_swap_chain.hpp"
+#include "vk3d_benchmark.hpp"
 
+#include <chrono>
 #include <memory>
+#include <string>
 #include <vector>
 
 namespace vk3d {
+	struct Vk3dAppSettings {
+		// Render offscreen without a window or swap chain
+		bool headless = false;
+		// Number of frames to measure before exiting, 0 runs until the window is closed
+		uint32_t benchmarkFrames = 0;
+		// Per frame GPU pass timings are written here on exit, as JSON if the extension is .json and CSV otherwise
+		std::string gpuProfilePath;
+		// CPU zones are recorded and written here on exit in Chrome trace event format
+		std::string cpuTracePath;
+		// Layout of every vertex buffer, the compact ones need the *_compact shader variants
+		Vk3dModel::VertexFormat vertexFormat = Vk3dModel::VertexFormat::Standard;
+		// Resident model geometry in bytes before unreferenced models get evicted
+		VkDeviceSize modelBudget = Vk3dModelRegistry::DEFAULT_BUDGET;
+		// Keep a position only copy of the vertices for the shadow pass
+		bool positionStream = true;
+		// Cull the objects and pick their LOD in a compute shader, every pass is then a single indirect draw.
+		// Falls back to the CPU draw loops when the device lacks multiDrawIndirect. Models without indices fail to load.
+		bool gpuDrivenDraws = true;
+		// Test the objects in the camera frustum against a depth pyramid on the GPU before the camera passes draw them,
+		// only with GPU driven draws
+		bool occlusionCulling = true;
+	};
+
 	class Vk3dApp {
 	public:
 		static constexpr int SIERPINSKI_DEPTH = 3;
@@ -27,7 +58,7 @@ namespace vk3d {
 		static constexpr float CAMERA_NEAR_PLANE = 0.1f;
 		static constexpr float CAMERA_FAR_PLANE = 50.0f;
 
-		Vk3dApp();
+		Vk3dApp(const Vk3dAppSettings& settings = Vk3dAppSettings{});
 		~Vk3dApp();
 
 		Vk3dApp(const Vk3dApp&) = delete;
@@ -35,17 +66,28 @@ namespace vk3d {
 
 		void run();
 	private:
+		void runFrameLoop();
 		void loadGameObjects();
 		void updateModels(int powIteration);
+		// Uploads the models the loader has imported, called once per frame
+		void streamModels();
+		void reportLoadedModels();
+		Vk3dModelLoader::Callback assignModel(std::vector<Vk3dScene::Handle> objects);
+		void exportGpuProfile();
 
-		Vk3dWindow vk3dWindow{WIDTH, HEIGHT, "Vulkan3d App"};
+		Vk3dAppSettings settings;
+		Vk3dWindow vk3dWindow{WIDTH, HEIGHT, "Vulkan3d App", settings.headless};
 		Vk3dDevice vk3dDevice{ vk3dWindow };
 		Vk3dAllocator vk3dAllocator{ vk3dDevice };
 		Vk3dRenderer vk3dRenderer{ vk3dWindow, vk3dDevice, vk3dAllocator};
+		Vk3dUploadBatcher vk3dUploadBatcher{ vk3dDevice, vk3dAllocator };
+		Vk3dGeometryPool vk3dGeometryPool{ vk3dDevice, vk3dAllocator, vk3dUploadBatcher, settings.vertexFormat, settings.positionStream };
+		Vk3dModelLoader vk3dModelLoader{ vk3dDevice, vk3dGeometryPool };
+		Vk3dModelRegistry vk3dModelRegistry{ vk3dModelLoader, vk3dGeometryPool, settings.modelBudget };
 
 		// note: order of declarations matters
 
-		Vk3dGameObject::Map gameObjects;
-		std::vector<std::shared_ptr<Vk3dModel>> gameModels;
+		Vk3dScene scene;
+		std::chrono::high_resolution_clock::time_point loadStartTime;
 	};
 }
\ No newline at end of file
@@ -0,0 +1,120 @@
+#include "vk3d_benchmark.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <iomanip>
+#include <numeric>
+
+namespace vk3d {
+
+	Vk3dBenchmark::Vk3dBenchmark(uint32_t frames, uint32_t warmupFrames) : frames{ frames }, warmupFrames{ warmupFrames } {
+		cpuFrameTimes.reserve(frames);
+		gpuFrameTimes.reserve(frames);
+	}
+
+	void Vk3dBenchmark::beginFrame() {
+		frameStart = std::chrono::high_resolution_clock::now();
+		if (recordedFrames == warmupFrames) {
+			benchmarkStart = frameStart;
+		}
+	}
+
+	void Vk3dBenchmark::endFrame() {
+		auto frameEnd = std::chrono::high_resolution_clock::now();
+		recordedFrames++;
+
+		if (recordedFrames <= warmupFrames || isFinished()) {
+			return;
+		}
+
+		cpuFrameTimes.push_back(std::chrono::duration<double, std::milli>(frameEnd - frameStart).count());
+		elapsedTime = std::chrono::duration<double>(frameEnd - benchmarkStart).count();
+		measuredFrames++;
+	}
+
+	void Vk3dBenchmark::addGpuFrameTime(double gpuFrameTime) {
+		if (gpuFrameTime < 0.0 || recordedFrames <= warmupFrames || isFinished()) {
+			return;
+		}
+		gpuFrameTimes.push_back(gpuFrameTime);
+	}
+
+	void Vk3dBenchmark::addCullingCounts(const std::string& view, uint32_t objects, uint32_t visible) {
+		// called during the frame, before endFrame counts it
+		if (recordedFrames < warmupFrames || isFinished()) {
+			return;
+		}
+		CullingCounts& counts = cullingCounts[view];
+		counts.objects += objects;
+		counts.visible += visible;
+		counts.frames++;
+	}
+
+	void Vk3dBenchmark::addTriangleCounts(const std::string& view, uint64_t drawn, uint64_t saved) {
+		if (recordedFrames < warmupFrames || isFinished()) {
+			return;
+		}
+		CullingCounts& counts = cullingCounts[view];
+		counts.drawnTriangles += drawn;
+		counts.savedTriangles += saved;
+	}
+
+	void Vk3dBenchmark::printReport(std::ostream& out) const {
+		out << "Benchmark: " << measuredFrames << " frames (" << warmupFrames << " warmup frames discarded)" << std::endl;
+		if (elapsedTime > 0.0) {
+			out << "Average FPS: " << std::fixed << std::setprecision(2) << measuredFrames / elapsedTime << std::endl;
+		}
+		printStatistics(out, "CPU", cpuFrameTimes);
+		printStatistics(out, "GPU", gpuFrameTimes);
+		for (const auto& kv : cullingCounts) {
+			const CullingCounts& counts = kv.second;
+			double objects = static_cast<double>(counts.objects) / counts.frames;
+			double visible = static_cast<double>(counts.visible) / counts.frames;
+			out << std::fixed << std::setprecision(1)
+				<< "Culling (" << kv.first << "): " << visible << " of " << objects << " objects visible per frame, "
+				<< objects - visible << " culled (" << (objects > 0.0 ? 100.0 * (objects - visible) / objects : 0.0) << "%)";
+			if (counts.drawnTriangles > 0 || counts.savedTriangles > 0) {
+				out << ", " << static_cast<double>(counts.drawnTriangles) / counts.frames << " triangles drawn and "
+					<< static_cast<double>(counts.savedTriangles) / counts.frames << " saved per frame";
+			}
+			out << std::endl;
+		}
+	}
+
+	Vk3dBenchmark::Statistics Vk3dBenchmark::computeStatistics(std::vector<double> samples) {
+		std::sort(samples.begin(), samples.end());
+
+		// nearest-rank percentile
+		auto percentile = [&samples](double p) {
+			size_t rank = static_cast<size_t>(std::ceil(p / 100.0 * samples.size()));
+			return samples[std::max<size_t>(rank, 1) - 1];
+		};
+
+		Statistics statistics{};
+		statistics.min = samples.front();
+		statistics.max = samples.back();
+		statistics.mean = std::accumulate(samples.begin(), samples.end(), 0.0) / samples.size();
+		statistics.p50 = percentile(50.0);
+		statistics.p95 = percentile(95.0);
+		statistics.p99 = percentile(99.0);
+		return statistics;
+	}
+
+	void Vk3dBenchmark::printStatistics(std::ostream& out, const char* name, const std::vector<double>& samples) {
+		if (samples.empty()) {
+			out << name << " frame time: no samples" << std::endl;
+			return;
+		}
+
+		Statistics statistics = computeStatistics(samples);
+		out << std::fixed << std::setprecision(3)
+			<< name << " frame time (ms): "
+			<< "min " << statistics.min
+			<< ", mean " << statistics.mean
+			<< ", p50 " << statistics.p50
+			<< ", p95 " << statistics.p95
+			<< ", p99 " << statistics.p99
+			<< ", max " << statistics.max << std::endl;
+	}
+
+}
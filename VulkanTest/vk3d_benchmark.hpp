@@ -0,0 +1,62 @@
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+#include <map>
+#include <ostream>
+#include <string>
+#include <vector>
+
+namespace vk3d {
+	class Vk3dBenchmark {
+	public:
+		// First frames are discarded since pipelines, caches and clocks are still warming up
+		static constexpr uint32_t DEFAULT_WARMUP_FRAMES = 60;
+
+		Vk3dBenchmark(uint32_t frames, uint32_t warmupFrames = DEFAULT_WARMUP_FRAMES);
+
+		Vk3dBenchmark(const Vk3dBenchmark&) = delete;
+		Vk3dBenchmark& operator=(const Vk3dBenchmark&) = delete;
+
+		void beginFrame();
+		void endFrame();
+		// GPU times arrive MAX_FRAMES_IN_FLIGHT frames late, negative values are ignored
+		void addGpuFrameTime(double gpuFrameTime);
+		// Objects tested and left visible by the culling of a view this frame, averaged per view in the report
+		void addCullingCounts(const std::string& view, uint32_t objects, uint32_t visible);
+		// Triangles drawn and skipped thanks to culling in a view this frame, reported next to its culling counts
+		void addTriangleCounts(const std::string& view, uint64_t drawn, uint64_t saved);
+
+		bool isFinished() const { return measuredFrames >= frames; }
+		void printReport(std::ostream& out) const;
+
+	private:
+		struct Statistics {
+			double min, mean, p50, p95, p99, max;
+		};
+
+		static Statistics computeStatistics(std::vector<double> samples);
+		static void printStatistics(std::ostream& out, const char* name, const std::vector<double>& samples);
+
+		struct CullingCounts {
+			uint64_t objects = 0;
+			uint64_t visible = 0;
+			uint32_t frames = 0;
+			uint64_t drawnTriangles = 0;
+			uint64_t savedTriangles = 0;
+		};
+
+		uint32_t frames;
+		uint32_t warmupFrames;
+		uint32_t recordedFrames{ 0 };
+		uint32_t measuredFrames{ 0 };
+
+		std::chrono::high_resolution_clock::time_point frameStart;
+		std::chrono::high_resolution_clock::time_point benchmarkStart;
+		double elapsedTime{ 0.0 };
+
+		std::vector<double> cpuFrameTimes;
+		std::vector<double> gpuFrameTimes;
+		std::map<std::string, CullingCounts> cullingCounts;
+	};
+}
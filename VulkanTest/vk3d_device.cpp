@@ -50,13 +50,18 @@ void DestroyDebugUtilsMessengerEXT(
 Vk3dDevice::Vk3dDevice(Vk3dWindow &window) : window{window} {
   createInstance();
   setupDebugMessenger();
-  createSurface();
+  if (!isHeadless()) {
+    createSurface();
+  }
   pickPhysicalDevice();
   createLogicalDevice();
   createCommandPool();
 }
 
 Vk3dDevice::~Vk3dDevice() {
+  if (hasDedicatedTransferQueue()) {
+    vkDestroyCommandPool(device_, transferCommandPool, nullptr);
+  }
   vkDestroyCommandPool(device_, commandPool, nullptr);
   vkDestroyDevice(device_, nullptr);
 
@@ -64,7 +69,9 @@ Vk3dDevice::~Vk3dDevice() {
     DestroyDebugUtilsMessengerEXT(instance, debugMessenger, nullptr);
   }
 
-  vkDestroySurfaceKHR(instance, surface_, nullptr);
+  if (surface_ != VK_NULL_HANDLE) {
+    vkDestroySurfaceKHR(instance, surface_, nullptr);
+  }
   vkDestroyInstance(instance, nullptr);
 }
 
@@ -139,7 +146,9 @@ void Vk3dDevice::createLogicalDevice() {
   QueueFamilyIndices indices = findQueueFamilies(physicalDevice);
 
   std::vector<VkDeviceQueueCreateInfo> queueCreateInfos;
-  std::set<uint32_t> uniqueQueueFamilies = {indices.graphicsFamily, indices.presentFamily};
+  graphicsQueueFamily_ = indices.graphicsFamily;
+  transferQueueFamily_ = indices.transferFamilyHasValue ? indices.transferFamily : indices.graphicsFamily;
+  std::set<uint32_t> uniqueQueueFamilies = {indices.graphicsFamily, indices.presentFamily, transferQueueFamily_};
 
   float queuePriority = 1.0f;
   for (uint32_t queueFamily : uniqueQueueFamilies) {
@@ -151,8 +160,15 @@ void Vk3dDevice::createLogicalDevice() {
     queueCreateInfos.push_back(queueCreateInfo);
   }
 
+  VkPhysicalDeviceFeatures supportedFeatures;
+  vkGetPhysicalDeviceFeatures(physicalDevice, &supportedFeatures);
+  // a whole pass is one indirect draw, every command starts its instances at firstInstance
+  multiDrawIndirect_ = supportedFeatures.multiDrawIndirect && supportedFeatures.drawIndirectFirstInstance;
+
   VkPhysicalDeviceFeatures deviceFeatures = {};
   deviceFeatures.samplerAnisotropy = VK_TRUE;
+  deviceFeatures.multiDrawIndirect = multiDrawIndirect_ ? VK_TRUE : VK_FALSE;
+  deviceFeatures.drawIndirectFirstInstance = multiDrawIndirect_ ? VK_TRUE : VK_FALSE;
 
   VkDeviceCreateInfo createInfo = {};
   createInfo.sType = VK_STRUCTURE_TYPE_DEVICE_CREATE_INFO;
@@ -160,9 +176,11 @@ void Vk3dDevice::createLogicalDevice() {
   createInfo.queueCreateInfoCount = static_cast<uint32_t>(queueCreateInfos.size());
   createInfo.pQueueCreateInfos = queueCreateInfos.data();
 
+  auto requiredDeviceExtensions = getRequiredDeviceExtensions();
+
   createInfo.pEnabledFeatures = &deviceFeatures;
-  createInfo.enabledExtensionCount = static_cast<uint32_t>(deviceExtensions.size());
-  createInfo.ppEnabledExtensionNames = deviceExtensions.data();
+  createInfo.enabledExtensionCount = static_cast<uint32_t>(requiredDeviceExtensions.size());
+  createInfo.ppEnabledExtensionNames = requiredDeviceExtensions.data();
 
   // might not really be necessary anymore because device specific validation layers
   // have been deprecated
@@ -186,6 +204,13 @@ void Vk3dDevice::createLogicalDevice() {
 
   vkGetDeviceQueue(device_, indices.graphicsFamily, 0, &graphicsQueue_);
   vkGetDeviceQueue(device_, indices.presentFamily, 0, &presentQueue_);
+  vkGetDeviceQueue(device_, transferQueueFamily_, 0, &transferQueue_);
+
+  if (hasDedicatedTransferQueue()) {
+    std::cout << "transfer queue family: " << transferQueueFamily_ << std::endl;
+  } else {
+    std::cout << "no transfer only queue family, uploads use the graphics queue" << std::endl;
+  }
 }
 
 void Vk3dDevice::createCommandPool() {
@@ -200,6 +225,16 @@ void Vk3dDevice::createCommandPool() {
   if (vkCreateCommandPool(device_, &poolInfo, nullptr, &commandPool) != VK_SUCCESS) {
     throw std::runtime_error("failed to create command pool!");
   }
+
+  if (!hasDedicatedTransferQueue()) {
+    transferCommandPool = commandPool;
+    return;
+  }
+
+  poolInfo.queueFamilyIndex = transferQueueFamily_;
+  if (vkCreateCommandPool(device_, &poolInfo, nullptr, &transferCommandPool) != VK_SUCCESS) {
+    throw std::runtime_error("failed to create transfer command pool!");
+  }
 }
 
 void Vk3dDevice::createSurface() { window.createWindowSurface(instance, &surface_); }
@@ -209,8 +244,9 @@ bool Vk3dDevice::isDeviceSuitable(VkPhysicalDevice device) {
 
   bool extensionsSupported = checkDeviceExtensionSupport(device);
 
-  bool swapChainAdequate = false;
-  if (extensionsSupported) {
+  // Headless devices render into offscreen images, so no surface support is needed
+  bool swapChainAdequate = isHeadless();
+  if (extensionsSupported && !isHeadless()) {
     SwapChainSupportDetails swapChainSupport = querySwapChainSupport(device);
     swapChainAdequate = !swapChainSupport.formats.empty() && !swapChainSupport.presentModes.empty();
   }
@@ -270,11 +306,14 @@ bool Vk3dDevice::checkValidationLayerSupport() {
 }
 
 std::vector<const char *> Vk3dDevice::getRequiredExtensions() {
-  uint32_t glfwExtensionCount = 0;
-  const char **glfwExtensions;
-  glfwExtensions = glfwGetRequiredInstanceExtensions(&glfwExtensionCount);
+  std::vector<const char *> extensions;
 
-  std::vector<const char *> extensions(glfwExtensions, glfwExtensions + glfwExtensionCount);
+  if (!isHeadless()) {
+    uint32_t glfwExtensionCount = 0;
+    const char **glfwExtensions;
+    glfwExtensions = glfwGetRequiredInstanceExtensions(&glfwExtensionCount);
+    extensions.assign(glfwExtensions, glfwExtensions + glfwExtensionCount);
+  }
 
   if (enableValidationLayers) {
     extensions.push_back(VK_EXT_DEBUG_UTILS_EXTENSION_NAME);
@@ -283,6 +322,16 @@ std::vector<const char *> Vk3dDevice::getRequiredExtensions() {
   return extensions;
 }
 
+std::vector<const char *> Vk3dDevice::getRequiredDeviceExtensions() {
+  std::vector<const char *> extensions(deviceExtensions.begin(), deviceExtensions.end());
+
+  if (!isHeadless()) {
+    extensions.insert(extensions.end(), presentationExtensions.begin(), presentationExtensions.end());
+  }
+
+  return extensions;
+}
+
 void Vk3dDevice::hasGflwRequiredInstanceExtensions() {
   uint32_t extensionCount = 0;
   vkEnumerateInstanceExtensionProperties(nullptr, &extensionCount, nullptr);
@@ -317,7 +366,8 @@ bool Vk3dDevice::checkDeviceExtensionSupport(VkPhysicalDevice device) {
       &extensionCount,
       availableExtensions.data());
 
-  std::set<std::string> requiredExtensions(deviceExtensions.begin(), deviceExtensions.end());
+  auto requiredDeviceExtensions = getRequiredDeviceExtensions();
+  std::set<std::string> requiredExtensions(requiredDeviceExtensions.begin(), requiredDeviceExtensions.end());
 
   for (const auto &extension : availableExtensions) {
     requiredExtensions.erase(extension.extensionName);
@@ -337,18 +387,30 @@ QueueFamilyIndices Vk3dDevice::findQueueFamilies(VkPhysicalDevice device) {
 
   int i = 0;
   for (const auto &queueFamily : queueFamilies) {
-    if (queueFamily.queueCount > 0 && queueFamily.queueFlags & VK_QUEUE_GRAPHICS_BIT) {
-      indices.graphicsFamily = i;
-      indices.graphicsFamilyHasValue = true;
-    }
-    VkBool32 presentSupport = false;
-    vkGetPhysicalDeviceSurfaceSupportKHR(device, i, surface_, &presentSupport);
-    if (queueFamily.queueCount > 0 && presentSupport) {
-      indices.presentFamily = i;
-      indices.presentFamilyHasValue = true;
+    if (!indices.isComplete()) {
+      if (queueFamily.queueCount > 0 && queueFamily.queueFlags & VK_QUEUE_GRAPHICS_BIT) {
+        indices.graphicsFamily = i;
+        indices.graphicsFamilyHasValue = true;
+      }
+      VkBool32 presentSupport = false;
+      if (isHeadless()) {
+        // Nothing is presented, the graphics queue doubles as present queue
+        presentSupport = queueFamily.queueFlags & VK_QUEUE_GRAPHICS_BIT;
+      } else {
+        vkGetPhysicalDeviceSurfaceSupportKHR(device, i, surface_, &presentSupport);
+      }
+      if (queueFamily.queueCount > 0 && presentSupport) {
+        indices.presentFamily = i;
+        indices.presentFamilyHasValue = true;
+      }
     }
-    if (indices.isComplete()) {
-      break;
+
+    // the transfer family stays optional, the graphics queue is used without one
+    VkQueueFlags engineFlags = VK_QUEUE_GRAPHICS_BIT | VK_QUEUE_COMPUTE_BIT;
+    if (!indices.transferFamilyHasValue && queueFamily.queueCount > 0 &&
+        (queueFamily.queueFlags & VK_QUEUE_TRANSFER_BIT) && !(queueFamily.queueFlags & engineFlags)) {
+      indices.transferFamily = i;
+      indices.transferFamilyHasValue = true;
     }
 
     i++;
@@ -476,12 +538,12 @@ void Vk3dDevice::endSingleTimeCommands(VkCommandBuffer commandBuffer) {
   vkFreeCommandBuffers(device_, commandPool, 1, &commandBuffer);
 }
 
-void Vk3dDevice::copyBuffer(VkBuffer srcBuffer, VkBuffer dstBuffer, VkDeviceSize size) {
+void Vk3dDevice::copyBuffer(VkBuffer srcBuffer, VkBuffer dstBuffer, VkDeviceSize size, VkDeviceSize srcOffset, VkDeviceSize dstOffset) {
   VkCommandBuffer commandBuffer = beginSingleTimeCommands();
 
   VkBufferCopy copyRegion{};
-  copyRegion.srcOffset = 0;  // Optional
-  copyRegion.dstOffset = 0;  // Optional
+  copyRegion.srcOffset = srcOffset;
+  copyRegion.dstOffset = dstOffset;
   copyRegion.size = size;
   vkCmdCopyBuffer(commandBuffer, srcBuffer, dstBuffer, 1, &copyRegion);
 
@@ -17,8 +17,11 @@ struct SwapChainSupportDetails {
 struct QueueFamilyIndices {
   uint32_t graphicsFamily;
   uint32_t presentFamily;
+  // family with transfer but neither graphics nor compute support, a copy engine next to the graphics queue
+  uint32_t transferFamily;
   bool graphicsFamilyHasValue = false;
   bool presentFamilyHasValue = false;
+  bool transferFamilyHasValue = false;
   bool isComplete() { return graphicsFamilyHasValue && presentFamilyHasValue; }
 };
 
@@ -46,6 +49,16 @@ class Vk3dDevice {
   VkSurfaceKHR surface() { return surface_; }
   VkQueue graphicsQueue() { return graphicsQueue_; }
   VkQueue presentQueue() { return presentQueue_; }
+  // Uploads go through the transfer queue and its own command pool. Without a transfer only family
+  // (lavapipe, most integrated GPUs) they are the graphics queue and the graphics command pool.
+  VkQueue transferQueue() { return transferQueue_; }
+  VkCommandPool getTransferCommandPool() { return transferCommandPool; }
+  bool hasDedicatedTransferQueue() { return transferQueueFamily_ != graphicsQueueFamily_; }
+  uint32_t graphicsQueueFamily() { return graphicsQueueFamily_; }
+  uint32_t transferQueueFamily() { return transferQueueFamily_; }
+  bool isHeadless() { return window.isHeadless(); }
+  // multiDrawIndirect and drawIndirectFirstInstance, enabled when both are there
+  bool supportsMultiDrawIndirect() { return multiDrawIndirect_; }
 
   SwapChainSupportDetails getSwapChainSupport() { return querySwapChainSupport(physicalDevice); }
   uint32_t findMemoryType(uint32_t typeFilter, VkMemoryPropertyFlags properties);
@@ -62,7 +75,7 @@ class Vk3dDevice {
       VkDeviceMemory &bufferMemory);
   VkCommandBuffer beginSingleTimeCommands();
   void endSingleTimeCommands(VkCommandBuffer commandBuffer);
-  void copyBuffer(VkBuffer srcBuffer, VkBuffer dstBuffer, VkDeviceSize size);
+  void copyBuffer(VkBuffer srcBuffer, VkBuffer dstBuffer, VkDeviceSize size, VkDeviceSize srcOffset = 0, VkDeviceSize dstOffset = 0);
   void copyBufferToImage(
       VkBuffer buffer, VkImage image, uint32_t width, uint32_t height, uint32_t layerCount);
 
@@ -85,6 +98,7 @@ class Vk3dDevice {
   // helper functions
   bool isDeviceSuitable(VkPhysicalDevice device);
   std::vector<const char *> getRequiredExtensions();
+  std::vector<const char *> getRequiredDeviceExtensions();
   bool checkValidationLayerSupport();
   QueueFamilyIndices findQueueFamilies(VkPhysicalDevice device);
   void populateDebugMessengerCreateInfo(VkDebugUtilsMessengerCreateInfoEXT &createInfo);
@@ -97,14 +111,20 @@ class Vk3dDevice {
   VkPhysicalDevice physicalDevice = VK_NULL_HANDLE;
   Vk3dWindow &window;
   VkCommandPool commandPool;
+  VkCommandPool transferCommandPool;
 
   VkDevice device_;
-  VkSurfaceKHR surface_;
+  VkSurfaceKHR surface_ = VK_NULL_HANDLE;
   VkQueue graphicsQueue_;
   VkQueue presentQueue_;
+  VkQueue transferQueue_;
+  uint32_t graphicsQueueFamily_;
+  uint32_t transferQueueFamily_;
+  bool multiDrawIndirect_ = false;
 
   const std::vector<const char *> validationLayers = {"VK_LAYER_KHRONOS_validation"};
-  const std::vector<const char *> deviceExtensions = {VK_KHR_SWAPCHAIN_EXTENSION_NAME, VK_KHR_MULTIVIEW_EXTENSION_NAME };
+  const std::vector<const char *> deviceExtensions = {VK_KHR_MULTIVIEW_EXTENSION_NAME };
+  const std::vector<const char *> presentationExtensions = {VK_KHR_SWAPCHAIN_EXTENSION_NAME};
 };
 
 }  // namespace vk3d
\ No newline at end of file
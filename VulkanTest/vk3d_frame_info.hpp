@@ -1,11 +1,17 @@
 #pragma once
 
 #include "vk3d_camera.hpp"
-#include "vk3d_game_object.hpp"
+#include "vk3d_scene.hpp"
+#include "vk3d_geometry_pool.hpp"
+#include "vk3d_gpu_culler.hpp"
+#include "vk3d_render_queue.hpp"
 
 //lib
 #include <vulkan/vulkan.h>
 
+// std
+#include <vector>
+
 namespace vk3d {
 	struct FrameInfo {
 		int frameIndex;
@@ -18,6 +24,20 @@ namespace vk3d {
 		VkDescriptorSet gBufferDescriptorSet;
 		VkDescriptorSet compositionDescriptorSet;
 		VkDescriptorSet postProcessingDescriptorSet;
-		Vk3dGameObject::Map& gameObjects;
+		Vk3dScene& scene;
+		// packets of the passes drawn from the CPU, sorted before the first pass records
+		Vk3dRenderQueue& renderQueue;
+		// Vk3dGpuScene set of the frame, the passes bind it as set 1
+		VkDescriptorSet objectDescriptorSet;
+		// dense indices of the objects in the camera frustum, in increasing order, for every pass drawn from the camera.
+		// Empty with a GPU culler.
+		const std::vector<uint32_t>& visibleObjects;
+		// null when the passes draw from the CPU, otherwise every pass is a single indirect draw through it
+		Vk3dGpuCuller* gpuCuller;
+		// used to select the LOD of every object in the camera and the shadow passes
+		glm::vec3 viewPosition;
+		glm::vec3 lightPosition;
+		// every model draws out of it, passes bind it once before their draws
+		Vk3dGeometryPool& geometryPool;
 	};
 }
\ No newline at end of file
@@ -0,0 +1,81 @@
+#include "vk3d_frustum.hpp"
+
+namespace vk3d {
+
+	bool Vk3dAabb::contains(const Vk3dAabb& other) const {
+		return glm::all(glm::lessThanEqual(min, other.min)) && glm::all(glm::greaterThanEqual(max, other.max));
+	}
+
+	glm::vec3 Vk3dAabb::center() const {
+		return (min + max) * 0.5f;
+	}
+
+	float Vk3dAabb::perimeter() const {
+		glm::vec3 size = max - min;
+		return size.x * size.y + size.y * size.z + size.z * size.x;
+	}
+
+	Vk3dAabb Vk3dAabb::transform(const glm::mat4& matrix) const {
+		glm::vec3 center{ matrix * glm::vec4((min + max) * .5f, 1.f) };
+		glm::vec3 extent = (max - min) * .5f;
+		// every axis of the box contributes the absolute value of its transformed extent
+		glm::vec3 worldExtent = glm::abs(glm::vec3{ matrix[0] }) * extent.x
+			+ glm::abs(glm::vec3{ matrix[1] }) * extent.y
+			+ glm::abs(glm::vec3{ matrix[2] }) * extent.z;
+		return { center - worldExtent, center + worldExtent };
+	}
+
+	Vk3dAabb Vk3dAabb::combine(const Vk3dAabb& a, const Vk3dAabb& b) {
+		return { glm::min(a.min, b.min), glm::max(a.max, b.max) };
+	}
+
+	Vk3dFrustum::Vk3dFrustum(const glm::mat4& projectionView) {
+		// rows of the matrix, glm stores columns
+		glm::vec4 rows[4];
+		for (int i = 0; i < 4; i++) {
+			rows[i] = { projectionView[0][i], projectionView[1][i], projectionView[2][i], projectionView[3][i] };
+		}
+
+		// left, right, bottom, top, near (z >= 0) and far (z <= w)
+		planes[0] = rows[3] + rows[0];
+		planes[1] = rows[3] - rows[0];
+		planes[2] = rows[3] + rows[1];
+		planes[3] = rows[3] - rows[1];
+		planes[4] = rows[2];
+		planes[5] = rows[3] - rows[2];
+		for (glm::vec4& plane : planes) {
+			plane /= glm::length(glm::vec3{ plane });
+		}
+	}
+
+	Vk3dFrustum::Intersection Vk3dFrustum::intersect(const Vk3dAabb& aabb) const {
+		glm::vec3 center = (aabb.min + aabb.max) * .5f;
+		glm::vec3 extent = (aabb.max - aabb.min) * .5f;
+		Intersection intersection = Intersection::Inside;
+		for (const glm::vec4& plane : planes) {
+			glm::vec3 normal{ plane };
+			float distance = glm::dot(normal, center) + plane.w;
+			// distance from the center to the corner furthest along the normal
+			float radius = glm::dot(glm::abs(normal), extent);
+			if (distance + radius < 0.f) {
+				return Intersection::Outside;
+			}
+			if (distance - radius < 0.f) {
+				intersection = Intersection::Intersecting;
+			}
+		}
+		return intersection;
+	}
+
+	Vk3dFrustum::Intersection Vk3dSphere::intersect(const Vk3dAabb& aabb) const {
+		// closest and furthest points of the box from the center
+		glm::vec3 closest = glm::clamp(center, aabb.min, aabb.max) - center;
+		glm::vec3 furthest = glm::max(glm::abs(aabb.min - center), glm::abs(aabb.max - center));
+		float radiusSquared = radius * radius;
+		if (glm::dot(closest, closest) > radiusSquared) {
+			return Vk3dFrustum::Intersection::Outside;
+		}
+		return glm::dot(furthest, furthest) <= radiusSquared ? Vk3dFrustum::Intersection::Inside : Vk3dFrustum::Intersection::Intersecting;
+	}
+
+}
@@ -0,0 +1,49 @@
+#pragma once
+
+// libs
+#define GLM_FORCE_RADIANS
+#define GLM_FORCE_DEPTH_ZERO_TO_ONE
+#include <glm/glm.hpp>
+
+namespace vk3d {
+	struct Vk3dAabb {
+		glm::vec3 min{ 0.f };
+		glm::vec3 max{ 0.f };
+
+		bool contains(const Vk3dAabb& other) const;
+		glm::vec3 center() const;
+		// half the surface area, the cost of a node in the AABB tree
+		float perimeter() const;
+		// box around this one transformed by matrix
+		Vk3dAabb transform(const glm::mat4& matrix) const;
+
+		static Vk3dAabb combine(const Vk3dAabb& a, const Vk3dAabb& b);
+	};
+
+	// The 6 planes of a projection * view matrix, with the normals pointing inside. Depth is expected in [0, 1].
+	class Vk3dFrustum {
+	public:
+		enum class Intersection {
+			Outside,
+			Intersecting,
+			Inside
+		};
+
+		explicit Vk3dFrustum(const glm::mat4& projectionView);
+
+		Intersection intersect(const Vk3dAabb& aabb) const;
+		// left, right, bottom, top, near and far, for the shaders testing bounds the same way
+		const glm::vec4* getPlanes() const { return planes; }
+
+	private:
+		// xyz normal, w distance, a point p is inside when dot(xyz, p) + w >= 0 for every plane
+		glm::vec4 planes[6];
+	};
+
+	struct Vk3dSphere {
+		glm::vec3 center{ 0.f };
+		float radius = 0.f;
+
+		Vk3dFrustum::Intersection intersect(const Vk3dAabb& aabb) const;
+	};
+}
@@ -1,14 +1,11 @@
 #pragma once
 
-#include "vk3d_model.hpp"
-
 // libs
+#define GLM_FORCE_RADIANS
+#define GLM_FORCE_DEPTH_ZERO_TO_ONE
+#include <glm/glm.hpp>
 #include <glm/gtc/matrix_transform.hpp>
 
-// std
-#include <memory>
-#include <unordered_map>
-
 namespace vk3d {
 
 	struct TransformComponent {
@@ -21,10 +18,10 @@ namespace vk3d {
 		void resetRotation();
 	};
 
+	// The viewer and the light, the drawable objects live in Vk3dScene
 	class Vk3dGameObject {
 	public:
 		using id_t = unsigned int;
-		using Map = std::unordered_map<id_t, Vk3dGameObject>;
 
 		static Vk3dGameObject createGameObject() {
 			static id_t currentId = 0;
@@ -40,10 +37,7 @@ namespace vk3d {
 
 		const id_t getId() { return id; }
 
-		std::shared_ptr<Vk3dModel> model{};
-		glm::vec4 color{};
 		TransformComponent transform{};
-		float reflection = 0.0f;
 
 	private:
 		Vk3dGameObject(id_t objId) : id{ objId } {}
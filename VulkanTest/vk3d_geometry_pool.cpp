@@ -0,0 +1,106 @@
+#include "vk3d_geometry_pool.hpp"
+
+// std
+#include <cassert>
+#include <stdexcept>
+
+namespace vk3d {
+
+	Vk3dGeometryPool::Vk3dGeometryPool(Vk3dDevice& device, Vk3dAllocator& allocator, Vk3dUploadBatcher& uploadBatcher, Vk3dModel::VertexFormat vertexFormat, bool positionStream)
+		: vk3dDevice{ device }, vk3dAllocator{ allocator }, vk3dUploadBatcher{ uploadBatcher }, vertexFormat{ vertexFormat } {
+		vertexSize = Vk3dModel::getBindingDescriptions(vertexFormat)[0].stride;
+
+		vertexBuffer = std::make_unique<Vk3dBuffer>(
+			vk3dDevice,
+			vertexSize,
+			VERTEX_CAPACITY,
+			VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+			VMA_MEMORY_USAGE_GPU_ONLY,
+			VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+			vk3dAllocator);
+
+		indexBuffer = std::make_unique<Vk3dBuffer>(
+			vk3dDevice,
+			sizeof(uint32_t),
+			INDEX_CAPACITY,
+			VK_BUFFER_USAGE_INDEX_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+			VMA_MEMORY_USAGE_GPU_ONLY,
+			VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+			vk3dAllocator);
+
+		if (positionStream) {
+			positionSize = Vk3dModel::getPositionSize(vertexFormat);
+			positionBuffer = std::make_unique<Vk3dBuffer>(
+				vk3dDevice,
+				positionSize,
+				VERTEX_CAPACITY,
+				VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+				VMA_MEMORY_USAGE_GPU_ONLY,
+				VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+				vk3dAllocator);
+		}
+	}
+
+	Vk3dGeometryPool::~Vk3dGeometryPool() {
+		assert(vertexRanges.getFreeSize() == VERTEX_CAPACITY && indexRanges.getFreeSize() == INDEX_CAPACITY && "Geometry pool destroyed while models still use it");
+	}
+
+	uint32_t Vk3dGeometryPool::allocateVertices(uint32_t vertexCount) {
+		uint32_t firstVertex = vertexRanges.allocate(vertexCount);
+		while (firstVertex == Vk3dRangeAllocator::INVALID_OFFSET && reclaimCallback && reclaimCallback()) {
+			firstVertex = vertexRanges.allocate(vertexCount);
+		}
+		if (firstVertex == Vk3dRangeAllocator::INVALID_OFFSET) {
+			throw std::runtime_error("failed to allocate vertices from the geometry pool!");
+		}
+		return firstVertex;
+	}
+
+	uint32_t Vk3dGeometryPool::allocateIndices(uint32_t indexCount) {
+		uint32_t firstIndex = indexRanges.allocate(indexCount);
+		while (firstIndex == Vk3dRangeAllocator::INVALID_OFFSET && reclaimCallback && reclaimCallback()) {
+			firstIndex = indexRanges.allocate(indexCount);
+		}
+		if (firstIndex == Vk3dRangeAllocator::INVALID_OFFSET) {
+			throw std::runtime_error("failed to allocate indices from the geometry pool!");
+		}
+		return firstIndex;
+	}
+
+	void Vk3dGeometryPool::freeVertices(uint32_t firstVertex, uint32_t vertexCount) {
+		vertexRanges.free(firstVertex, vertexCount);
+	}
+
+	void Vk3dGeometryPool::freeIndices(uint32_t firstIndex, uint32_t indexCount) {
+		indexRanges.free(firstIndex, indexCount);
+	}
+
+	void Vk3dGeometryPool::uploadVertices(uint32_t firstVertex, const void* vertices, uint32_t vertexCount) {
+		vk3dUploadBatcher.upload(vertexBuffer->getBuffer(), static_cast<VkDeviceSize>(firstVertex) * vertexSize, vertices, static_cast<VkDeviceSize>(vertexCount) * vertexSize);
+	}
+
+	void Vk3dGeometryPool::uploadIndices(uint32_t firstIndex, const uint32_t* indices, uint32_t indexCount) {
+		vk3dUploadBatcher.upload(indexBuffer->getBuffer(), static_cast<VkDeviceSize>(firstIndex) * sizeof(uint32_t), indices, static_cast<VkDeviceSize>(indexCount) * sizeof(uint32_t));
+	}
+
+	void Vk3dGeometryPool::uploadPositions(uint32_t firstVertex, const void* positions, uint32_t vertexCount) {
+		assert(positionBuffer != nullptr && "Geometry pool has no position stream");
+		vk3dUploadBatcher.upload(positionBuffer->getBuffer(), static_cast<VkDeviceSize>(firstVertex) * positionSize, positions, static_cast<VkDeviceSize>(vertexCount) * positionSize);
+	}
+
+	void Vk3dGeometryPool::bind(VkCommandBuffer commandBuffer) {
+		VkBuffer buffers[] = { vertexBuffer->getBuffer() };
+		VkDeviceSize offsets[] = { 0 };
+		vkCmdBindVertexBuffers(commandBuffer, 0, 1, buffers, offsets);
+		vkCmdBindIndexBuffer(commandBuffer, indexBuffer->getBuffer(), 0, VK_INDEX_TYPE_UINT32);
+	}
+
+	void Vk3dGeometryPool::bindPositions(VkCommandBuffer commandBuffer) {
+		assert(positionBuffer != nullptr && "Geometry pool has no position stream");
+		VkBuffer buffers[] = { positionBuffer->getBuffer() };
+		VkDeviceSize offsets[] = { 0 };
+		vkCmdBindVertexBuffers(commandBuffer, 0, 1, buffers, offsets);
+		vkCmdBindIndexBuffer(commandBuffer, indexBuffer->getBuffer(), 0, VK_INDEX_TYPE_UINT32);
+	}
+
+}
@@ -0,0 +1,82 @@
+#pragma once
+
+#include "vk3d_device.hpp"
+#include "vk3d_buffer.hpp"
+#include "vk3d_allocator.hpp"
+#include "vk3d_model.hpp"
+#include "vk3d_range_allocator.hpp"
+#include "vk3d_upload_batcher.hpp"
+
+// std
+#include <functional>
+#include <memory>
+
+namespace vk3d {
+	// One device local vertex buffer and one index buffer shared by every model. Models sub-allocate ranges
+	// and draw with vertexOffset/firstIndex, so a pass binds the geometry once instead of once per object.
+	// With a position stream the pool also keeps every vertex position tightly packed in a buffer of its own,
+	// at the same vertex offsets, for the passes that only need depth.
+	class Vk3dGeometryPool {
+	public:
+		static constexpr uint32_t VERTEX_CAPACITY = 1 << 20;
+		static constexpr uint32_t INDEX_CAPACITY = 1 << 22;
+		// Frees ranges of the pool on demand, returns false when there is nothing left to free
+		using ReclaimCallback = std::function<bool()>;
+
+		Vk3dGeometryPool(Vk3dDevice& device, Vk3dAllocator& allocator, Vk3dUploadBatcher& uploadBatcher, Vk3dModel::VertexFormat vertexFormat, bool positionStream);
+		~Vk3dGeometryPool();
+
+		Vk3dGeometryPool(const Vk3dGeometryPool&) = delete;
+		Vk3dGeometryPool& operator=(const Vk3dGeometryPool&) = delete;
+
+		// Return the first vertex/index of the range. When the pool is full the reclaim callback frees ranges until
+		// the new one fits, they throw once it can't.
+		uint32_t allocateVertices(uint32_t vertexCount);
+		uint32_t allocateIndices(uint32_t indexCount);
+		void freeVertices(uint32_t firstVertex, uint32_t vertexCount);
+		void freeIndices(uint32_t firstIndex, uint32_t indexCount);
+
+		// vertices must already be in the pool vertex format. The copies are queued on the upload batcher,
+		// they reach the GPU with its next flush.
+		void uploadVertices(uint32_t firstVertex, const void* vertices, uint32_t vertexCount);
+		void uploadIndices(uint32_t firstIndex, const uint32_t* indices, uint32_t indexCount);
+		// positions in the position stream format, see Vk3dModel::getPositionSize
+		void uploadPositions(uint32_t firstVertex, const void* positions, uint32_t vertexCount);
+
+		void bind(VkCommandBuffer commandBuffer);
+		// Binds the position stream in place of the vertices, for the pipelines built with positionOnly
+		void bindPositions(VkCommandBuffer commandBuffer);
+
+		Vk3dModel::VertexFormat getVertexFormat() const { return vertexFormat; }
+		uint32_t getVertexSize() const { return vertexSize; }
+		bool hasPositionStream() const { return positionBuffer != nullptr; }
+		uint32_t getPositionSize() const { return positionSize; }
+		Vk3dAllocator& getAllocator() { return vk3dAllocator; }
+		void setReclaimCallback(ReclaimCallback callback) { reclaimCallback = std::move(callback); }
+		// device memory of both buffers as allocated by VMA
+		VkDeviceSize getMemorySize() {
+			return vertexBuffer->getAllocationSize() + indexBuffer->getAllocationSize() + (positionBuffer ? positionBuffer->getAllocationSize() : 0);
+		}
+		// bytes of the buffers handed out to models
+		VkDeviceSize getUsedSize() const {
+			return static_cast<VkDeviceSize>(VERTEX_CAPACITY - vertexRanges.getFreeSize()) * (vertexSize + positionSize)
+				+ static_cast<VkDeviceSize>(INDEX_CAPACITY - indexRanges.getFreeSize()) * sizeof(uint32_t);
+		}
+
+	private:
+		Vk3dDevice& vk3dDevice;
+		Vk3dAllocator& vk3dAllocator;
+		Vk3dUploadBatcher& vk3dUploadBatcher;
+		Vk3dModel::VertexFormat vertexFormat;
+		uint32_t vertexSize;
+		// 0 without a position stream
+		uint32_t positionSize = 0;
+
+		std::unique_ptr<Vk3dBuffer> vertexBuffer;
+		std::unique_ptr<Vk3dBuffer> indexBuffer;
+		std::unique_ptr<Vk3dBuffer> positionBuffer;
+		Vk3dRangeAllocator vertexRanges{ VERTEX_CAPACITY };
+		Vk3dRangeAllocator indexRanges{ INDEX_CAPACITY };
+		ReclaimCallback reclaimCallback;
+	};
+}
@@ -0,0 +1,571 @@
+#include "vk3d_gpu_culler.hpp"
+
+#include "vk3d_frustum.hpp"
+#include "vk3d_profiler.hpp"
+
+// std
+#include <algorithm>
+#include <array>
+#include <cassert>
+#include <stdexcept>
+
+namespace vk3d {
+
+	namespace {
+		constexpr uint32_t CULL_GROUP_SIZE = 64;
+		constexpr uint32_t PYRAMID_GROUP_SIZE = 8;
+		// 2^16 pixels on the longest side
+		constexpr uint32_t MAX_PYRAMID_LEVELS = 16;
+		// phases of the cull shader
+		constexpr uint32_t PHASE_RESET = 0;
+		constexpr uint32_t PHASE_EARLY = 1;
+		constexpr uint32_t PHASE_LATE = 2;
+		// early, late and main, then one per cube face
+		constexpr uint32_t FIRST_FACE_SECTION = 3;
+		constexpr uint32_t SECTION_COUNT = FIRST_FACE_SECTION + Vk3dSwapChain::NUM_CUBE_FACES;
+		constexpr uint32_t PLANE_COUNT = 6;
+
+		// CullUbo of the cull shader
+		struct CullUbo {
+			glm::mat4 projectionView;
+			glm::vec4 frustumPlanes[PLANE_COUNT];
+			glm::vec4 facePlanes[PLANE_COUNT * Vk3dSwapChain::NUM_CUBE_FACES];
+			glm::vec4 viewPosition;
+			glm::vec4 lightPosition;
+			glm::ivec2 depthSize;
+			uint32_t slotCount;
+			uint32_t batchCount;
+			uint32_t commandCount;
+			uint32_t instanceCount;
+			uint32_t pyramidLevels;
+			uint32_t hasPyramid;
+			uint32_t occlusionCulling;
+			float shadowLodScale;
+			float lodScreenSize;
+		};
+
+		struct CullStatistics {
+			uint32_t drawable;
+			uint32_t frustumVisible;
+			uint32_t earlyVisible;
+			uint32_t lateVisible;
+			uint32_t casters;
+			uint32_t faceDraws;
+			uint32_t drawnShadowTriangles;
+			uint32_t savedShadowTriangles;
+		};
+
+		struct CullPushConstantData {
+			uint32_t phase;
+		};
+
+		struct PyramidPushConstantData {
+			glm::ivec2 sourceSize;
+			glm::ivec2 destinationSize;
+		};
+
+		bool hasStencilComponent(VkFormat format) {
+			return format == VK_FORMAT_D32_SFLOAT_S8_UINT || format == VK_FORMAT_D24_UNORM_S8_UINT;
+		}
+	}
+
+	Vk3dGpuCuller::Vk3dGpuCuller(Vk3dDevice& device, Vk3dAllocator& allocator, Vk3dGpuProfiler& gpuProfiler, VkDescriptorSetLayout objectSetLayout, bool occlusionCulling)
+		: vk3dDevice{ device }, vk3dAllocator{ allocator }, gpuProfiler{ gpuProfiler }, occlusionCulling{ occlusionCulling } {
+		uint32_t frameCount = Vk3dSwapChain::MAX_FRAMES_IN_FLIGHT;
+		descriptorPool = Vk3dDescriptorPool::Builder(vk3dDevice)
+			.setMaxSets(2 * frameCount + MAX_PYRAMID_LEVELS)
+			.setPoolFlags(VK_DESCRIPTOR_POOL_CREATE_FREE_DESCRIPTOR_SET_BIT)
+			.addPoolSize(VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 2 * frameCount + MAX_PYRAMID_LEVELS)
+			.addPoolSize(VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, frameCount + MAX_PYRAMID_LEVELS)
+			.addPoolSize(VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, frameCount)
+			.addPoolSize(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 3 * frameCount)
+			.build();
+
+		pyramidSetLayout = Vk3dDescriptorSetLayout::Builder(vk3dDevice)
+			.addBinding(0, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, VK_SHADER_STAGE_COMPUTE_BIT)
+			.addBinding(1, VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, VK_SHADER_STAGE_COMPUTE_BIT)
+			.build();
+
+		cullSetLayout = Vk3dDescriptorSetLayout::Builder(vk3dDevice)
+			.addBinding(0, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT)
+			.addBinding(1, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT)
+			.addBinding(2, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT)
+			.addBinding(3, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, VK_SHADER_STAGE_COMPUTE_BIT)
+			.addBinding(4, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT)
+			.build();
+
+		createPipelineLayouts(objectSetLayout);
+		createPipelines();
+		createSampler();
+
+		frames.resize(frameCount);
+		for (auto& frame : frames) {
+			createFrameResources(frame);
+			createCommandBuffer(frame, INITIAL_CAPACITY);
+			createVisibilityBuffer(frame, INITIAL_CAPACITY);
+			descriptorPool->allocateDescriptor(cullSetLayout->getDescriptorSetLayout(), frame.cullDescriptorSet);
+			descriptorPool->allocateDescriptor(pyramidSetLayout->getDescriptorSetLayout(), frame.depthDescriptorSet);
+		}
+		// without occlusion culling the pyramid is never built, the cull shader only needs something bound
+		if (!occlusionCulling) {
+			createPyramid({ 1, 1 });
+		}
+	}
+
+	Vk3dGpuCuller::~Vk3dGpuCuller() {
+		destroyPyramid();
+		for (auto& frame : frames) {
+			vkDestroyImageView(vk3dDevice.device(), frame.depthView, nullptr);
+		}
+		vkDestroySampler(vk3dDevice.device(), sampler, nullptr);
+		vkDestroyPipelineLayout(vk3dDevice.device(), cullPipelineLayout, nullptr);
+		vkDestroyPipelineLayout(vk3dDevice.device(), pyramidPipelineLayout, nullptr);
+	}
+
+	void Vk3dGpuCuller::createPipelineLayouts(VkDescriptorSetLayout objectSetLayout) {
+		VkPushConstantRange pushConstantRange{};
+		pushConstantRange.stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+		pushConstantRange.offset = 0;
+		pushConstantRange.size = sizeof(PyramidPushConstantData);
+
+		VkDescriptorSetLayout pyramidDescriptorSetLayout = pyramidSetLayout->getDescriptorSetLayout();
+
+		VkPipelineLayoutCreateInfo pipelineLayoutInfo{};
+		pipelineLayoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+		pipelineLayoutInfo.setLayoutCount = 1;
+		pipelineLayoutInfo.pSetLayouts = &pyramidDescriptorSetLayout;
+		pipelineLayoutInfo.pushConstantRangeCount = 1;
+		pipelineLayoutInfo.pPushConstantRanges = &pushConstantRange;
+		if (vkCreatePipelineLayout(vk3dDevice.device(), &pipelineLayoutInfo, nullptr, &pyramidPipelineLayout) != VK_SUCCESS) {
+			throw std::runtime_error("failed to create pipeline layout!");
+		}
+
+		pushConstantRange.size = sizeof(CullPushConstantData);
+		std::vector<VkDescriptorSetLayout> cullDescriptorSetLayouts{ objectSetLayout, cullSetLayout->getDescriptorSetLayout() };
+		pipelineLayoutInfo.setLayoutCount = static_cast<uint32_t>(cullDescriptorSetLayouts.size());
+		pipelineLayoutInfo.pSetLayouts = cullDescriptorSetLayouts.data();
+		if (vkCreatePipelineLayout(vk3dDevice.device(), &pipelineLayoutInfo, nullptr, &cullPipelineLayout) != VK_SUCCESS) {
+			throw std::runtime_error("failed to create pipeline layout!");
+		}
+	}
+
+	void Vk3dGpuCuller::createPipelines() {
+		pyramidPipeline = std::make_unique<Vk3dPipeline>(vk3dDevice, "shaders/depth_pyramid.comp.spv", pyramidPipelineLayout);
+		cullPipeline = std::make_unique<Vk3dPipeline>(vk3dDevice, "shaders/gpu_cull.comp.spv", cullPipelineLayout);
+	}
+
+	void Vk3dGpuCuller::createSampler() {
+		// only read with texelFetch
+		VkSamplerCreateInfo samplerCreateInfo{};
+		samplerCreateInfo.sType = VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO;
+		samplerCreateInfo.magFilter = VK_FILTER_NEAREST;
+		samplerCreateInfo.minFilter = VK_FILTER_NEAREST;
+		samplerCreateInfo.mipmapMode = VK_SAMPLER_MIPMAP_MODE_NEAREST;
+		samplerCreateInfo.addressModeU = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+		samplerCreateInfo.addressModeV = samplerCreateInfo.addressModeU;
+		samplerCreateInfo.addressModeW = samplerCreateInfo.addressModeU;
+		samplerCreateInfo.maxAnisotropy = 1.0f;
+		samplerCreateInfo.minLod = 0.0f;
+		samplerCreateInfo.maxLod = VK_LOD_CLAMP_NONE;
+		samplerCreateInfo.borderColor = VK_BORDER_COLOR_FLOAT_OPAQUE_WHITE;
+		if (vkCreateSampler(vk3dDevice.device(), &samplerCreateInfo, nullptr, &sampler) != VK_SUCCESS) {
+			throw std::runtime_error("failed to create depth pyramid sampler!");
+		}
+	}
+
+	void Vk3dGpuCuller::createFrameResources(FrameResources& frame) {
+		frame.uniformBuffer = std::make_unique<Vk3dBuffer>(
+			vk3dDevice,
+			sizeof(CullUbo),
+			1,
+			VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT,
+			VMA_MEMORY_USAGE_CPU_TO_GPU,
+			VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT,
+			vk3dAllocator);
+		frame.uniformBuffer->map();
+
+		frame.statisticsBuffer = std::make_unique<Vk3dBuffer>(
+			vk3dDevice,
+			sizeof(CullStatistics),
+			1,
+			VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+			VMA_MEMORY_USAGE_GPU_TO_CPU,
+			VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT,
+			vk3dAllocator);
+		frame.statisticsBuffer->map();
+	}
+
+	void Vk3dGpuCuller::createCommandBuffer(FrameResources& frame, uint32_t capacity) {
+		// only written by the cull shader
+		frame.commandBuffer = std::make_unique<Vk3dBuffer>(
+			vk3dDevice,
+			sizeof(VkDrawIndexedIndirectCommand),
+			SECTION_COUNT * capacity,
+			VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT,
+			VMA_MEMORY_USAGE_GPU_ONLY,
+			VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+			vk3dAllocator);
+		frame.commandCapacity = capacity;
+	}
+
+	void Vk3dGpuCuller::createVisibilityBuffer(FrameResources& frame, uint32_t capacity) {
+		frame.visibilityBuffer = std::make_unique<Vk3dBuffer>(
+			vk3dDevice,
+			sizeof(uint32_t),
+			capacity,
+			VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+			VMA_MEMORY_USAGE_GPU_ONLY,
+			VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+			vk3dAllocator);
+		frame.slotCapacity = capacity;
+	}
+
+	void Vk3dGpuCuller::createPyramid(VkExtent2D extent) {
+		// level 0 is half the depth, rounded up to a power of two so every level halves the previous one exactly
+		// and each texel covers a square of pixels. Past the depth the edge is repeated.
+		uint32_t width = 1;
+		while (width < (extent.width + 1) / 2) {
+			width *= 2;
+		}
+		uint32_t height = 1;
+		while (height < (extent.height + 1) / 2) {
+			height *= 2;
+		}
+		pyramidLevels = 1;
+		while ((width >> pyramidLevels) > 0 || (height >> pyramidLevels) > 0) {
+			pyramidLevels++;
+		}
+		assert(pyramidLevels <= MAX_PYRAMID_LEVELS && "Depth too large for the pyramid");
+
+		VkImageCreateInfo imageInfo{};
+		imageInfo.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+		imageInfo.imageType = VK_IMAGE_TYPE_2D;
+		imageInfo.extent.width = width;
+		imageInfo.extent.height = height;
+		imageInfo.extent.depth = 1;
+		imageInfo.mipLevels = pyramidLevels;
+		imageInfo.arrayLayers = 1;
+		imageInfo.format = VK_FORMAT_R32_SFLOAT;
+		imageInfo.tiling = VK_IMAGE_TILING_OPTIMAL;
+		imageInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+		imageInfo.usage = VK_IMAGE_USAGE_STORAGE_BIT | VK_IMAGE_USAGE_SAMPLED_BIT;
+		imageInfo.samples = VK_SAMPLE_COUNT_1_BIT;
+		imageInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+		vk3dAllocator.createImage(&imageInfo, VMA_MEMORY_USAGE_GPU_ONLY, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, pyramid, pyramidMemory);
+
+		VkImageViewCreateInfo viewInfo{};
+		viewInfo.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
+		viewInfo.image = pyramid;
+		viewInfo.viewType = VK_IMAGE_VIEW_TYPE_2D;
+		viewInfo.format = VK_FORMAT_R32_SFLOAT;
+		viewInfo.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+		viewInfo.subresourceRange.baseMipLevel = 0;
+		viewInfo.subresourceRange.levelCount = pyramidLevels;
+		viewInfo.subresourceRange.baseArrayLayer = 0;
+		viewInfo.subresourceRange.layerCount = 1;
+		if (vkCreateImageView(vk3dDevice.device(), &viewInfo, nullptr, &pyramidView) != VK_SUCCESS) {
+			throw std::runtime_error("failed to create depth pyramid image view!");
+		}
+
+		levelViews.resize(pyramidLevels);
+		viewInfo.subresourceRange.levelCount = 1;
+		for (uint32_t level = 0; level < pyramidLevels; level++) {
+			viewInfo.subresourceRange.baseMipLevel = level;
+			if (vkCreateImageView(vk3dDevice.device(), &viewInfo, nullptr, &levelViews[level]) != VK_SUCCESS) {
+				throw std::runtime_error("failed to create depth pyramid image view!");
+			}
+		}
+
+		levelDescriptorSets.assign(pyramidLevels, VK_NULL_HANDLE);
+		for (uint32_t level = 1; level < pyramidLevels; level++) {
+			VkDescriptorImageInfo source{ sampler, levelViews[level - 1], VK_IMAGE_LAYOUT_GENERAL };
+			VkDescriptorImageInfo destination{ VK_NULL_HANDLE, levelViews[level], VK_IMAGE_LAYOUT_GENERAL };
+			Vk3dDescriptorWriter(*pyramidSetLayout, *descriptorPool)
+				.writeImage(0, &source)
+				.writeImage(1, &destination)
+				.build(levelDescriptorSets[level]);
+		}
+
+		pyramidExtent = extent;
+		pyramidSize = { static_cast<int>(width), static_cast<int>(height) };
+		hasPyramid = false;
+
+		// the cull shader binds it in the general layout before the first build
+		VkCommandBuffer commandBuffer = vk3dDevice.beginSingleTimeCommands();
+		VkImageMemoryBarrier barrier{};
+		barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+		barrier.oldLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+		barrier.newLayout = VK_IMAGE_LAYOUT_GENERAL;
+		barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+		barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+		barrier.image = pyramid;
+		barrier.subresourceRange = { VK_IMAGE_ASPECT_COLOR_BIT, 0, pyramidLevels, 0, 1 };
+		barrier.srcAccessMask = 0;
+		barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+		vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+			0, 0, nullptr, 0, nullptr, 1, &barrier);
+		vk3dDevice.endSingleTimeCommands(commandBuffer);
+	}
+
+	void Vk3dGpuCuller::destroyPyramid() {
+		if (pyramid == VK_NULL_HANDLE) {
+			return;
+		}
+		std::vector<VkDescriptorSet> descriptorSets(levelDescriptorSets.begin() + 1, levelDescriptorSets.end());
+		if (!descriptorSets.empty()) {
+			descriptorPool->freeDescriptors(descriptorSets);
+		}
+		levelDescriptorSets.clear();
+		for (VkImageView view : levelViews) {
+			vkDestroyImageView(vk3dDevice.device(), view, nullptr);
+		}
+		levelViews.clear();
+		vkDestroyImageView(vk3dDevice.device(), pyramidView, nullptr);
+		pyramidView = VK_NULL_HANDLE;
+		vk3dAllocator.destroyImage(pyramid, pyramidMemory);
+		pyramid = VK_NULL_HANDLE;
+	}
+
+	void Vk3dGpuCuller::writeCullDescriptorSet(FrameResources& frame) {
+		auto uniformInfo = frame.uniformBuffer->descriptorInfo();
+		auto commandInfo = frame.commandBuffer->descriptorInfo();
+		auto statisticsInfo = frame.statisticsBuffer->descriptorInfo();
+		VkDescriptorImageInfo pyramidInfo{ sampler, pyramidView, VK_IMAGE_LAYOUT_GENERAL };
+		auto visibilityInfo = frame.visibilityBuffer->descriptorInfo();
+		Vk3dDescriptorWriter(*cullSetLayout, *descriptorPool)
+			.writeBuffer(0, &uniformInfo)
+			.writeBuffer(1, &commandInfo)
+			.writeBuffer(2, &statisticsInfo)
+			.writeImage(3, &pyramidInfo)
+			.writeBuffer(4, &visibilityInfo)
+			.overwrite(frame.cullDescriptorSet);
+	}
+
+	void Vk3dGpuCuller::readStatistics(FrameResources& frame) {
+		frame.statisticsBuffer->invalidate();
+		auto* counts = static_cast<CullStatistics*>(frame.statisticsBuffer->getMappedMemory());
+		statistics.drawable = counts->drawable;
+		statistics.frustumVisible = counts->frustumVisible;
+		statistics.earlyVisible = counts->earlyVisible;
+		statistics.lateVisible = counts->lateVisible;
+		statistics.casters = counts->casters;
+		statistics.faceDraws = counts->faceDraws;
+		statistics.drawnShadowTriangles = counts->drawnShadowTriangles;
+		statistics.savedShadowTriangles = counts->savedShadowTriangles;
+	}
+
+	void Vk3dGpuCuller::prepare(int frameIndex, Vk3dGpuScene& gpuScene, const CullInfo& cullInfo, VkExtent2D extent) {
+		VK3D_PROFILE_ZONE("Vk3dGpuCuller::prepare");
+		assert(cullInfo.faceProjectionViews != nullptr && "Shadow faces missing from the cull info");
+		this->frameIndex = frameIndex;
+		FrameResources& frame = frames[frameIndex];
+		// the fence of the frame was waited on, its counts are final
+		if (frame.slotCount > 0) {
+			readStatistics(frame);
+		}
+
+		if (occlusionCulling && (extent.width != pyramidExtent.width || extent.height != pyramidExtent.height)) {
+			// the other frame in flight may still read the old pyramid
+			vkDeviceWaitIdle(vk3dDevice.device());
+			destroyPyramid();
+			createPyramid(extent);
+		}
+
+		slotCount = gpuScene.getSlotCount();
+		batchCount = gpuScene.getBatchCount();
+		commandCount = gpuScene.getCommandCount();
+		gpuScene.reserveInstances(frameIndex, SECTION_COUNT * gpuScene.getInstanceCount());
+		objectDescriptorSet = gpuScene.getDescriptorSet(frameIndex);
+		if (commandCount > frame.commandCapacity) {
+			uint32_t capacity = frame.commandCapacity;
+			while (capacity < commandCount) {
+				capacity *= 2;
+			}
+			createCommandBuffer(frame, capacity);
+		}
+		if (slotCount > frame.slotCapacity) {
+			uint32_t capacity = frame.slotCapacity;
+			while (capacity < slotCount) {
+				capacity *= 2;
+			}
+			createVisibilityBuffer(frame, capacity);
+		}
+		writeCullDescriptorSet(frame);
+
+		CullUbo ubo{};
+		ubo.projectionView = cullInfo.projectionView;
+		Vk3dFrustum frustum{ cullInfo.projectionView };
+		std::copy(frustum.getPlanes(), frustum.getPlanes() + PLANE_COUNT, ubo.frustumPlanes);
+		for (uint32_t face = 0; face < Vk3dSwapChain::NUM_CUBE_FACES; face++) {
+			Vk3dFrustum faceFrustum{ cullInfo.faceProjectionViews[face] };
+			std::copy(faceFrustum.getPlanes(), faceFrustum.getPlanes() + PLANE_COUNT, ubo.facePlanes + face * PLANE_COUNT);
+		}
+		ubo.viewPosition = glm::vec4{ cullInfo.viewPosition, cullInfo.projectionScale };
+		ubo.lightPosition = glm::vec4{ cullInfo.lightPosition, cullInfo.shadowReach };
+		ubo.depthSize = glm::ivec2{ static_cast<int>(pyramidExtent.width), static_cast<int>(pyramidExtent.height) };
+		ubo.slotCount = slotCount;
+		ubo.batchCount = batchCount;
+		ubo.commandCount = commandCount;
+		ubo.instanceCount = gpuScene.getInstanceCount();
+		ubo.pyramidLevels = pyramidLevels;
+		ubo.hasPyramid = hasPyramid ? 1 : 0;
+		ubo.occlusionCulling = occlusionCulling ? 1 : 0;
+		ubo.shadowLodScale = cullInfo.shadowLodScale;
+		ubo.lodScreenSize = Vk3dScene::LOD_SCREEN_SIZE;
+		frame.uniformBuffer->writeToBuffer(&ubo);
+		frame.uniformBuffer->flush();
+
+		*static_cast<CullStatistics*>(frame.statisticsBuffer->getMappedMemory()) = CullStatistics{};
+		frame.statisticsBuffer->flush();
+		frame.slotCount = slotCount;
+	}
+
+	void Vk3dGpuCuller::dispatchCull(VkCommandBuffer commandBuffer, uint32_t phase, uint32_t invocationCount) {
+		FrameResources& frame = frames[frameIndex];
+		cullPipeline->bind(commandBuffer);
+		std::array<VkDescriptorSet, 2> descriptorSets{ objectDescriptorSet, frame.cullDescriptorSet };
+		vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, cullPipelineLayout, 0,
+			static_cast<uint32_t>(descriptorSets.size()), descriptorSets.data(), 0, nullptr);
+
+		CullPushConstantData push{};
+		push.phase = phase;
+		vkCmdPushConstants(commandBuffer, cullPipelineLayout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(CullPushConstantData), &push);
+
+		if (invocationCount > 0) {
+			vkCmdDispatch(commandBuffer, (invocationCount + CULL_GROUP_SIZE - 1) / CULL_GROUP_SIZE, 1, 1);
+		}
+
+		// commands and instances to the draws, and to the next phase that appends to them
+		VkMemoryBarrier barrier{};
+		barrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+		barrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+		barrier.dstAccessMask = VK_ACCESS_INDIRECT_COMMAND_READ_BIT | VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT;
+		vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+			VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT | VK_PIPELINE_STAGE_VERTEX_SHADER_BIT | VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+			0, 1, &barrier, 0, nullptr, 0, nullptr);
+	}
+
+	void Vk3dGpuCuller::cull(VkCommandBuffer commandBuffer) {
+		VK3D_PROFILE_ZONE("Vk3dGpuCuller::cull");
+		gpuProfiler.beginScope(commandBuffer, "gpu_cull");
+		dispatchCull(commandBuffer, PHASE_RESET, batchCount);
+		dispatchCull(commandBuffer, PHASE_EARLY, slotCount);
+		gpuProfiler.endScope(commandBuffer);
+	}
+
+	void Vk3dGpuCuller::cullLate(VkCommandBuffer commandBuffer, const Vk3dSwapChain::FrameBufferAttachment& depth) {
+		VK3D_PROFILE_ZONE("Vk3dGpuCuller::cullLate");
+		assert(occlusionCulling && "Late phase without occlusion culling");
+		gpuProfiler.beginScope(commandBuffer, "occlusion_late");
+		buildPyramid(commandBuffer, depth);
+		dispatchCull(commandBuffer, PHASE_LATE, slotCount);
+		gpuProfiler.endScope(commandBuffer);
+	}
+
+	void Vk3dGpuCuller::buildPyramid(VkCommandBuffer commandBuffer, const Vk3dSwapChain::FrameBufferAttachment& depth) {
+		FrameResources& frame = frames[frameIndex];
+
+		// layer 0 is the camera view, the mappings pass draws the same depth to both layers
+		vkDestroyImageView(vk3dDevice.device(), frame.depthView, nullptr);
+		VkImageViewCreateInfo viewInfo{};
+		viewInfo.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
+		viewInfo.image = depth.image;
+		viewInfo.viewType = VK_IMAGE_VIEW_TYPE_2D;
+		viewInfo.format = depth.format;
+		viewInfo.subresourceRange = { VK_IMAGE_ASPECT_DEPTH_BIT, 0, 1, 0, 1 };
+		if (vkCreateImageView(vk3dDevice.device(), &viewInfo, nullptr, &frame.depthView) != VK_SUCCESS) {
+			throw std::runtime_error("failed to create depth pyramid image view!");
+		}
+
+		VkDescriptorImageInfo source{ sampler, frame.depthView, VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL };
+		VkDescriptorImageInfo destination{ VK_NULL_HANDLE, levelViews[0], VK_IMAGE_LAYOUT_GENERAL };
+		Vk3dDescriptorWriter(*pyramidSetLayout, *descriptorPool)
+			.writeImage(0, &source)
+			.writeImage(1, &destination)
+			.overwrite(frame.depthDescriptorSet);
+
+		VkImageAspectFlags depthAspect = hasStencilComponent(depth.format) ? VK_IMAGE_ASPECT_DEPTH_BIT | VK_IMAGE_ASPECT_STENCIL_BIT : VK_IMAGE_ASPECT_DEPTH_BIT;
+		std::array<VkImageMemoryBarrier, 2> barriers{};
+		for (auto& barrier : barriers) {
+			barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+			barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+			barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+		}
+		barriers[0].oldLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
+		barriers[0].newLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL;
+		barriers[0].image = depth.image;
+		barriers[0].subresourceRange = { depthAspect, 0, 1, 0, VK_REMAINING_ARRAY_LAYERS };
+		barriers[0].srcAccessMask = VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
+		barriers[0].dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+		// the previous pyramid was read by the early phase, its content is dropped
+		barriers[1].oldLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+		barriers[1].newLayout = VK_IMAGE_LAYOUT_GENERAL;
+		barriers[1].image = pyramid;
+		barriers[1].subresourceRange = { VK_IMAGE_ASPECT_COLOR_BIT, 0, pyramidLevels, 0, 1 };
+		barriers[1].srcAccessMask = 0;
+		barriers[1].dstAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+		vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+			0, 0, nullptr, 0, nullptr, static_cast<uint32_t>(barriers.size()), barriers.data());
+
+		pyramidPipeline->bind(commandBuffer);
+		glm::ivec2 sourceSize{ static_cast<int>(pyramidExtent.width), static_cast<int>(pyramidExtent.height) };
+		glm::ivec2 destinationSize = pyramidSize;
+		for (uint32_t level = 0; level < pyramidLevels; level++) {
+			VkDescriptorSet descriptorSet = level == 0 ? frame.depthDescriptorSet : levelDescriptorSets[level];
+			vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, pyramidPipelineLayout, 0, 1, &descriptorSet, 0, nullptr);
+
+			PyramidPushConstantData push{};
+			push.sourceSize = sourceSize;
+			push.destinationSize = destinationSize;
+			vkCmdPushConstants(commandBuffer, pyramidPipelineLayout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(PyramidPushConstantData), &push);
+			vkCmdDispatch(commandBuffer,
+				(push.destinationSize.x + PYRAMID_GROUP_SIZE - 1) / PYRAMID_GROUP_SIZE,
+				(push.destinationSize.y + PYRAMID_GROUP_SIZE - 1) / PYRAMID_GROUP_SIZE,
+				1);
+
+			// the level is read by the next one, then by the late phase
+			VkMemoryBarrier barrier{};
+			barrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+			barrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+			barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+			vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+				0, 1, &barrier, 0, nullptr, 0, nullptr);
+			sourceSize = destinationSize;
+			destinationSize = glm::max(destinationSize / 2, glm::ivec2{ 1 });
+		}
+
+		// back to an attachment for the late mappings pass
+		barriers[0].oldLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL;
+		barriers[0].newLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
+		barriers[0].srcAccessMask = 0;
+		barriers[0].dstAccessMask = VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_READ_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
+		vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT,
+			0, 0, nullptr, 0, nullptr, 1, &barriers[0]);
+
+		hasPyramid = true;
+	}
+
+	void Vk3dGpuCuller::drawSection(VkCommandBuffer commandBuffer, uint32_t section) {
+		if (commandCount == 0) {
+			return;
+		}
+		// the device caps the commands of one indirect draw, past it the section takes several
+		uint32_t maxDrawCount = vk3dDevice.properties.limits.maxDrawIndirectCount;
+		uint32_t drawCount = 0;
+		for (uint32_t first = 0; first < commandCount; first += drawCount) {
+			drawCount = std::min(commandCount - first, maxDrawCount);
+			VkDeviceSize offset = (static_cast<VkDeviceSize>(section) * commandCount + first) * sizeof(VkDrawIndexedIndirectCommand);
+			vkCmdDrawIndexedIndirect(commandBuffer, frames[frameIndex].commandBuffer->getBuffer(), offset, drawCount, sizeof(VkDrawIndexedIndirectCommand));
+		}
+	}
+
+	void Vk3dGpuCuller::draw(VkCommandBuffer commandBuffer, Phase phase) {
+		assert((phase != Phase::Late || occlusionCulling) && "Late phase without occlusion culling");
+		drawSection(commandBuffer, static_cast<uint32_t>(phase));
+	}
+
+	void Vk3dGpuCuller::drawShadowFace(VkCommandBuffer commandBuffer, uint32_t face) {
+		drawSection(commandBuffer, FIRST_FACE_SECTION + face);
+	}
+
+}
@@ -0,0 +1,172 @@
+#pragma once
+
+#include "vk3d_device.hpp"
+#include "vk3d_allocator.hpp"
+#include "vk3d_buffer.hpp"
+#include "vk3d_descriptors.hpp"
+#include "vk3d_pipeline.hpp"
+#include "vk3d_swap_chain.hpp"
+#include "vk3d_gpu_scene.hpp"
+#include "vk3d_gpu_profiler.hpp"
+
+// libs
+#define GLM_FORCE_RADIANS
+#define GLM_FORCE_DEPTH_ZERO_TO_ONE
+#include <glm/glm.hpp>
+
+// std
+#include <memory>
+#include <vector>
+
+namespace vk3d {
+	// Culls the objects of the Vk3dGpuScene and picks their LOD in a compute shader. Every pass has one indexed
+	// indirect command per LOD of every batch of the scene, the objects sharing a model. The shader resets them
+	// without instances, then appends the slot of every visible object to the instances of its command. Each pass
+	// is a single vkCmdDrawIndexedIndirect over the commands, recording a frame costs the same whatever the objects.
+	// Only a device with a maxDrawIndirectCount below the commands of a pass splits it into several.
+	//
+	// The camera passes test the objects against the view frustum, and with occlusion culling against a hierarchical
+	// depth pyramid built in compute from the depth of the mappings pass, the first pass drawing the camera view.
+	// Occlusion works in two phases every frame. The early phase tests the objects against the pyramid of the previous
+	// frame and the mappings pass draws the ones that pass. The pyramid is then rebuilt from that depth and the late
+	// phase tests the rejected objects against it, a second mappings pass draws the ones that were wrongly rejected,
+	// mostly objects the camera just uncovered. The UV reflection and G-buffer passes draw everything either phase kept.
+	//
+	// The shadow casters are tested against the reach of the light and the frustum of every cube face, like
+	// ShadowRenderSystem::cullCasters does on the CPU.
+	class Vk3dGpuCuller {
+	public:
+		enum class Phase {
+			Early,	// mappings pass, everything in the frustum without occlusion culling
+			Late,	// late mappings pass
+			Main,	// UV reflection and G-buffer passes, both phases
+		};
+
+		// What the frame is culled against
+		struct CullInfo {
+			glm::mat4 projectionView{ 1.f };
+			glm::vec3 viewPosition{ 0.f };
+			// [1][1] entry of the camera projection, see Vk3dScene::selectLod
+			float projectionScale = 1.f;
+			// NUM_CUBE_FACES matrices of ShadowUbo
+			const glm::mat4* faceProjectionViews = nullptr;
+			glm::vec3 lightPosition{ 0.f };
+			// radius of the sphere the casters are first culled against
+			float shadowReach = 0.f;
+			// projection scale of the shadow LOD selection
+			float shadowLodScale = 1.f;
+		};
+
+		// Counts of a frame already finished on the GPU
+		struct Statistics {
+			// slots with an indexed model
+			uint32_t drawable = 0;
+			uint32_t frustumVisible = 0;
+			uint32_t earlyVisible = 0;
+			uint32_t lateVisible = 0;
+			uint32_t casters = 0;
+			uint32_t faceDraws = 0;
+			uint64_t drawnShadowTriangles = 0;
+			uint64_t savedShadowTriangles = 0;
+		};
+
+		static constexpr uint32_t INITIAL_CAPACITY = 256;
+
+		// objectSetLayout is the layout of the Vk3dGpuScene set
+		Vk3dGpuCuller(Vk3dDevice& device, Vk3dAllocator& allocator, Vk3dGpuProfiler& gpuProfiler, VkDescriptorSetLayout objectSetLayout, bool occlusionCulling);
+		~Vk3dGpuCuller();
+
+		Vk3dGpuCuller(const Vk3dGpuCuller&) = delete;
+		Vk3dGpuCuller& operator=(const Vk3dGpuCuller&) = delete;
+
+		// Writes what the frame is culled against and reserves its instances, after Vk3dGpuScene::update. The frame
+		// in flight must be started, its previous use of the buffers is over. A new extent recreates the pyramid, the
+		// first frame after it draws everything in the frustum in the early phase.
+		void prepare(int frameIndex, Vk3dGpuScene& gpuScene, const CullInfo& cullInfo, VkExtent2D extent);
+		// Before the shadow and mappings passes, fills the commands of the shadow faces and of the early phase
+		void cull(VkCommandBuffer commandBuffer);
+		// After the mappings pass, builds the pyramid from its depth and tests the objects rejected by cull.
+		// The depth is left as an attachment for the late mappings pass. Only with occlusion culling.
+		void cullLate(VkCommandBuffer commandBuffer, const Vk3dSwapChain::FrameBufferAttachment& depth);
+
+		// Draws the objects of the phase, the geometry pool and the object set of the frame must be bound
+		void draw(VkCommandBuffer commandBuffer, Phase phase);
+		// Draws the casters touching the face, in its subpass of the shadow pass
+		void drawShadowFace(VkCommandBuffer commandBuffer, uint32_t face);
+
+		bool isOcclusionCulling() const { return occlusionCulling; }
+		const Statistics& getStatistics() const { return statistics; }
+
+	private:
+		struct FrameResources {
+			std::unique_ptr<Vk3dBuffer> uniformBuffer;
+			std::unique_ptr<Vk3dBuffer> statisticsBuffer;
+			std::unique_ptr<Vk3dBuffer> commandBuffer;
+			// commands of a section
+			uint32_t commandCapacity = 0;
+			// early visibility of every slot, for the late phase
+			std::unique_ptr<Vk3dBuffer> visibilityBuffer;
+			uint32_t slotCapacity = 0;
+			// slots culled the last time the frame was used, 0 before
+			uint32_t slotCount = 0;
+			VkDescriptorSet cullDescriptorSet = VK_NULL_HANDLE;
+			// pyramid level 0 from the depth of the frame, views of a swap chain image are made every frame
+			VkImageView depthView = VK_NULL_HANDLE;
+			VkDescriptorSet depthDescriptorSet = VK_NULL_HANDLE;
+		};
+
+		void createPipelineLayouts(VkDescriptorSetLayout objectSetLayout);
+		void createPipelines();
+		void createSampler();
+		void createFrameResources(FrameResources& frame);
+		void createCommandBuffer(FrameResources& frame, uint32_t capacity);
+		void createVisibilityBuffer(FrameResources& frame, uint32_t capacity);
+		void createPyramid(VkExtent2D extent);
+		void destroyPyramid();
+		void writeCullDescriptorSet(FrameResources& frame);
+		void readStatistics(FrameResources& frame);
+		void dispatchCull(VkCommandBuffer commandBuffer, uint32_t phase, uint32_t invocationCount);
+		void buildPyramid(VkCommandBuffer commandBuffer, const Vk3dSwapChain::FrameBufferAttachment& depth);
+		void drawSection(VkCommandBuffer commandBuffer, uint32_t section);
+
+		Vk3dDevice& vk3dDevice;
+		Vk3dAllocator& vk3dAllocator;
+		Vk3dGpuProfiler& gpuProfiler;
+		bool occlusionCulling;
+
+		std::unique_ptr<Vk3dDescriptorPool> descriptorPool;
+		std::unique_ptr<Vk3dDescriptorSetLayout> pyramidSetLayout;
+		std::unique_ptr<Vk3dDescriptorSetLayout> cullSetLayout;
+		VkPipelineLayout pyramidPipelineLayout;
+		VkPipelineLayout cullPipelineLayout;
+		std::unique_ptr<Vk3dPipeline> pyramidPipeline;
+		std::unique_ptr<Vk3dPipeline> cullPipeline;
+		VkSampler sampler;
+
+		std::vector<FrameResources> frames;
+		int frameIndex = 0;
+		uint32_t slotCount = 0;
+		uint32_t batchCount = 0;
+		// commands of every section of the frame
+		uint32_t commandCount = 0;
+		VkDescriptorSet objectDescriptorSet = VK_NULL_HANDLE;
+
+		// size of the depth the pyramid is built from
+		VkExtent2D pyramidExtent{ 0, 0 };
+		// level 0, half the depth rounded up to powers of two
+		glm::ivec2 pyramidSize{ 0 };
+		uint32_t pyramidLevels = 0;
+		VkImage pyramid = VK_NULL_HANDLE;
+		VmaAllocation pyramidMemory = VK_NULL_HANDLE;
+		// every level, read by the cull shader
+		VkImageView pyramidView = VK_NULL_HANDLE;
+		// one per level, read for the next level and written
+		std::vector<VkImageView> levelViews;
+		// level n reads level n - 1 and writes level n, level 0 uses the depth set of the frame
+		std::vector<VkDescriptorSet> levelDescriptorSets;
+		// built on a previous frame since the last resize
+		bool hasPyramid = false;
+
+		Statistics statistics{};
+	};
+}
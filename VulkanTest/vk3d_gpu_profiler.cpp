@@ -0,0 +1,267 @@
+#include "vk3d_gpu_profiler.hpp"
+
+// std
+#include <algorithm>
+#include <cassert>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <stdexcept>
+
+namespace vk3d {
+
+	// Query 0 and 1 hold the frame begin/end, every scope takes the next two
+	static constexpr uint32_t FRAME_QUERY_COUNT = 2;
+	static constexpr uint32_t MAX_QUERIES_PER_FRAME = FRAME_QUERY_COUNT + 2 * Vk3dGpuProfiler::MAX_SCOPES_PER_FRAME;
+
+	Vk3dGpuProfiler::Vk3dGpuProfiler(Vk3dDevice& device, uint32_t framesInFlight) : vk3dDevice{ device } {
+		supported = vk3dDevice.properties.limits.timestampComputeAndGraphics;
+		if (!supported) {
+			std::cout << "Timestamp queries not supported, GPU timings will not be available" << std::endl;
+			return;
+		}
+
+		// timestampPeriod is the number of nanoseconds per timestamp tick
+		timestampPeriod = vk3dDevice.properties.limits.timestampPeriod / 1000000.0;
+
+		frames.resize(framesInFlight);
+
+		VkQueryPoolCreateInfo queryPoolInfo{};
+		queryPoolInfo.sType = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO;
+		queryPoolInfo.queryType = VK_QUERY_TYPE_TIMESTAMP;
+		queryPoolInfo.queryCount = MAX_QUERIES_PER_FRAME;
+
+		for (auto& frame : frames) {
+			if (vkCreateQueryPool(vk3dDevice.device(), &queryPoolInfo, nullptr, &frame.queryPool) != VK_SUCCESS) {
+				throw std::runtime_error("failed to create timestamp query pool!");
+			}
+			frame.scopes.reserve(MAX_SCOPES_PER_FRAME);
+		}
+	}
+
+	Vk3dGpuProfiler::~Vk3dGpuProfiler() {
+		for (auto& frame : frames) {
+			vkDestroyQueryPool(vk3dDevice.device(), frame.queryPool, nullptr);
+		}
+	}
+
+	void Vk3dGpuProfiler::beginFrame(VkCommandBuffer commandBuffer, int frameIndex) {
+		if (!supported) {
+			return;
+		}
+		assert(currentFrame == nullptr && "Can't begin a profiler frame while another one is in progress");
+
+		// The fence of this frame slot has already been waited on, so its previous results are available
+		currentFrame = &frames[frameIndex];
+		if (currentFrame->written) {
+			readResults(*currentFrame);
+		}
+
+		currentFrame->written = false;
+		currentFrame->scopes.clear();
+		currentFrame->queryCount = FRAME_QUERY_COUNT;
+		currentFrame->frameNumber = frameCounter++;
+
+		vkCmdResetQueryPool(commandBuffer, currentFrame->queryPool, 0, MAX_QUERIES_PER_FRAME);
+		vkCmdWriteTimestamp(commandBuffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, currentFrame->queryPool, 0);
+	}
+
+	void Vk3dGpuProfiler::endFrame(VkCommandBuffer commandBuffer) {
+		if (!supported) {
+			return;
+		}
+		assert(currentFrame != nullptr && "Can't end a profiler frame that has not begun");
+		assert(openScopes.empty() && "All profiler scopes must be closed before ending the frame");
+
+		vkCmdWriteTimestamp(commandBuffer, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, currentFrame->queryPool, 1);
+		currentFrame->written = true;
+		currentFrame = nullptr;
+	}
+
+	void Vk3dGpuProfiler::beginScope(VkCommandBuffer commandBuffer, const char* name) {
+		if (!supported) {
+			return;
+		}
+		assert(currentFrame != nullptr && "Can't begin a profiler scope outside of a frame");
+		assert(currentFrame->queryCount + 2 <= MAX_QUERIES_PER_FRAME && "Too many profiler scopes in a single frame");
+
+		ScopeQueries scope{ getScopeIndex(name), currentFrame->queryCount };
+		currentFrame->queryCount += 2;
+
+		vkCmdWriteTimestamp(commandBuffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, currentFrame->queryPool, scope.firstQuery);
+
+		openScopes.push_back(currentFrame->scopes.size());
+		currentFrame->scopes.push_back(scope);
+	}
+
+	void Vk3dGpuProfiler::endScope(VkCommandBuffer commandBuffer) {
+		if (!supported) {
+			return;
+		}
+		assert(!openScopes.empty() && "Can't end a profiler scope that has not begun");
+
+		const ScopeQueries& scope = currentFrame->scopes[openScopes.back()];
+		openScopes.pop_back();
+
+		vkCmdWriteTimestamp(commandBuffer, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, currentFrame->queryPool, scope.firstQuery + 1);
+	}
+
+	void Vk3dGpuProfiler::readPendingResults() {
+		assert(currentFrame == nullptr && "Can't read pending results while a profiler frame is in progress");
+
+		std::vector<FrameQueries*> pendingFrames;
+		for (auto& frame : frames) {
+			if (frame.written) {
+				pendingFrames.push_back(&frame);
+			}
+		}
+
+		// keep the log ordered by frame number
+		std::sort(pendingFrames.begin(), pendingFrames.end(), [](const FrameQueries* a, const FrameQueries* b) {
+			return a->frameNumber < b->frameNumber;
+		});
+
+		for (auto frame : pendingFrames) {
+			readResults(*frame);
+			frame->written = false;
+		}
+	}
+
+	uint32_t Vk3dGpuProfiler::getScopeIndex(const char* name) {
+		for (uint32_t i = 0; i < scopeNames.size(); i++) {
+			if (scopeNames[i] == name) {
+				return i;
+			}
+		}
+		scopeNames.emplace_back(name);
+		return static_cast<uint32_t>(scopeNames.size() - 1);
+	}
+
+	void Vk3dGpuProfiler::readResults(FrameQueries& frame) {
+		uint64_t timestamps[MAX_QUERIES_PER_FRAME];
+
+		auto result = vkGetQueryPoolResults(
+			vk3dDevice.device(),
+			frame.queryPool,
+			0,
+			frame.queryCount,
+			sizeof(timestamps),
+			timestamps,
+			sizeof(uint64_t),
+			VK_QUERY_RESULT_64_BIT);
+
+		// never wait for results, a frame which is not ready is simply dropped
+		if (result != VK_SUCCESS) {
+			return;
+		}
+
+		FrameTimings timings{};
+		timings.frameNumber = frame.frameNumber;
+		timings.frameTime = (timestamps[1] - timestamps[0]) * timestampPeriod;
+		timings.scopeTimes.resize(scopeNames.size(), 0.0);
+		for (auto& scope : frame.scopes) {
+			timings.scopeTimes[scope.scopeIndex] += (timestamps[scope.firstQuery + 1] - timestamps[scope.firstQuery]) * timestampPeriod;
+		}
+
+		if (frameLog.size() < MAX_LOGGED_FRAMES) {
+			frameLog.push_back(timings);
+		}
+
+		recentFrames.push_back(std::move(timings));
+		if (recentFrames.size() > ROLLING_AVERAGE_FRAMES) {
+			recentFrames.pop_front();
+		}
+	}
+
+	Vk3dGpuProfiler::FrameTimings Vk3dGpuProfiler::getRollingAverage() const {
+		FrameTimings average{};
+		average.frameTime = 0.0;
+		average.scopeTimes.resize(scopeNames.size(), 0.0);
+
+		if (recentFrames.empty()) {
+			return average;
+		}
+
+		for (auto& frame : recentFrames) {
+			average.frameTime += frame.frameTime;
+			for (size_t i = 0; i < frame.scopeTimes.size(); i++) {
+				average.scopeTimes[i] += frame.scopeTimes[i];
+			}
+		}
+
+		average.frameNumber = recentFrames.back().frameNumber;
+		average.frameTime /= recentFrames.size();
+		for (auto& scopeTime : average.scopeTimes) {
+			scopeTime /= recentFrames.size();
+		}
+		return average;
+	}
+
+	void Vk3dGpuProfiler::printRollingAverage(std::ostream& out) const {
+		if (recentFrames.empty()) {
+			out << "GPU profiler: no samples" << std::endl;
+			return;
+		}
+
+		FrameTimings average = getRollingAverage();
+		out << std::fixed << std::setprecision(3)
+			<< "GPU profiler, average of the last " << recentFrames.size() << " frames (ms):" << std::endl;
+		for (size_t i = 0; i < scopeNames.size(); i++) {
+			out << "  " << std::left << std::setw(20) << scopeNames[i] << std::right << average.scopeTimes[i] << std::endl;
+		}
+		out << "  " << std::left << std::setw(20) << "frame" << std::right << average.frameTime << std::endl;
+	}
+
+	void Vk3dGpuProfiler::exportCsv(const std::string& filepath) const {
+		std::ofstream file{ filepath };
+		if (!file.is_open()) {
+			throw std::runtime_error("failed to open file: " + filepath);
+		}
+
+		file << "frame,total";
+		for (auto& name : scopeNames) {
+			file << ',' << name;
+		}
+		file << '\n';
+
+		file << std::fixed << std::setprecision(6);
+		for (auto& frame : frameLog) {
+			file << frame.frameNumber << ',' << frame.frameTime;
+			for (size_t i = 0; i < scopeNames.size(); i++) {
+				file << ',';
+				// scopes registered after this frame was read are left empty
+				if (i < frame.scopeTimes.size()) {
+					file << frame.scopeTimes[i];
+				}
+			}
+			file << '\n';
+		}
+	}
+
+	void Vk3dGpuProfiler::exportJson(const std::string& filepath) const {
+		std::ofstream file{ filepath };
+		if (!file.is_open()) {
+			throw std::runtime_error("failed to open file: " + filepath);
+		}
+
+		FrameTimings average = getRollingAverage();
+
+		file << std::fixed << std::setprecision(6);
+		file << "{\n  \"unit\": \"ms\",\n  \"rollingAverage\": {\"total\": " << average.frameTime;
+		for (size_t i = 0; i < scopeNames.size(); i++) {
+			file << ", \"" << scopeNames[i] << "\": " << average.scopeTimes[i];
+		}
+		file << "},\n  \"frames\": [";
+
+		for (size_t f = 0; f < frameLog.size(); f++) {
+			auto& frame = frameLog[f];
+			file << (f == 0 ? "\n" : ",\n") << "    {\"frame\": " << frame.frameNumber << ", \"total\": " << frame.frameTime;
+			for (size_t i = 0; i < frame.scopeTimes.size(); i++) {
+				file << ", \"" << scopeNames[i] << "\": " << frame.scopeTimes[i];
+			}
+			file << "}";
+		}
+		file << "\n  ]\n}\n";
+	}
+
+}
@@ -0,0 +1,84 @@
+#pragma once
+
+#include "vk3d_device.hpp"
+
+// std
+#include <deque>
+#include <ostream>
+#include <string>
+#include <vector>
+
+namespace vk3d {
+	// Measures GPU time of named scopes with timestamp queries. Every frame in flight owns its
+	// query pool, results are read back when the frame slot is reused so reading never stalls.
+	// Scopes must not be opened or closed inside a multiview render pass, since timestamps there
+	// are written once per view.
+	class Vk3dGpuProfiler {
+	public:
+		static constexpr uint32_t MAX_SCOPES_PER_FRAME = 16;
+		static constexpr uint32_t ROLLING_AVERAGE_FRAMES = 120;
+		static constexpr size_t MAX_LOGGED_FRAMES = 1 << 16;
+
+		struct FrameTimings {
+			uint64_t frameNumber;
+			double frameTime;
+			// milliseconds per scope, indexed like getScopeNames()
+			std::vector<double> scopeTimes;
+		};
+
+		Vk3dGpuProfiler(Vk3dDevice& device, uint32_t framesInFlight);
+		~Vk3dGpuProfiler();
+
+		Vk3dGpuProfiler(const Vk3dGpuProfiler&) = delete;
+		Vk3dGpuProfiler& operator=(const Vk3dGpuProfiler&) = delete;
+
+		bool isSupported() const { return supported; }
+
+		void beginFrame(VkCommandBuffer commandBuffer, int frameIndex);
+		void endFrame(VkCommandBuffer commandBuffer);
+		void beginScope(VkCommandBuffer commandBuffer, const char* name);
+		void endScope(VkCommandBuffer commandBuffer);
+		// Reads the frames still in flight, the device must be idle
+		void readPendingResults();
+
+		// GPU time in milliseconds of the last frame read back, negative if there is none yet
+		double getLastFrameTime() const { return recentFrames.empty() ? -1.0 : recentFrames.back().frameTime; }
+		const std::vector<std::string>& getScopeNames() const { return scopeNames; }
+		const std::vector<FrameTimings>& getFrameLog() const { return frameLog; }
+		FrameTimings getRollingAverage() const;
+
+		void printRollingAverage(std::ostream& out) const;
+		void exportCsv(const std::string& filepath) const;
+		void exportJson(const std::string& filepath) const;
+
+	private:
+		struct ScopeQueries {
+			uint32_t scopeIndex;
+			uint32_t firstQuery;
+		};
+
+		struct FrameQueries {
+			VkQueryPool queryPool = VK_NULL_HANDLE;
+			uint32_t queryCount = 0;
+			uint64_t frameNumber = 0;
+			bool written = false;
+			std::vector<ScopeQueries> scopes;
+		};
+
+		uint32_t getScopeIndex(const char* name);
+		void readResults(FrameQueries& frame);
+
+		Vk3dDevice& vk3dDevice;
+		bool supported{ false };
+		double timestampPeriod{ 1.0 };
+
+		std::vector<FrameQueries> frames;
+		FrameQueries* currentFrame{ nullptr };
+		std::vector<size_t> openScopes;
+		uint64_t frameCounter{ 0 };
+
+		std::vector<std::string> scopeNames;
+		std::deque<FrameTimings> recentFrames;
+		std::vector<FrameTimings> frameLog;
+	};
+}
@@ -0,0 +1,355 @@
+#include "vk3d_gpu_scene.hpp"
+
+#include "vk3d_swap_chain.hpp"
+#include "vk3d_profiler.hpp"
+
+// std
+#include <cassert>
+#include <cstring>
+
+namespace vk3d {
+
+	Vk3dGpuScene::Vk3dGpuScene(Vk3dDevice& device, Vk3dAllocator& allocator, bool gpuInstances)
+		: vk3dDevice{ device }, vk3dAllocator{ allocator }, gpuInstances{ gpuInstances } {
+		uint32_t frameCount = Vk3dSwapChain::MAX_FRAMES_IN_FLIGHT;
+		descriptorPool = Vk3dDescriptorPool::Builder(vk3dDevice)
+			.setMaxSets(frameCount)
+			.addPoolSize(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 3 * frameCount)
+			.build();
+
+		setLayout = Vk3dDescriptorSetLayout::Builder(vk3dDevice)
+			.addBinding(0, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_COMPUTE_BIT)
+			.addBinding(1, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_COMPUTE_BIT)
+			.addBinding(2, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT)
+			.build();
+
+		createObjectBuffer(INITIAL_CAPACITY);
+		createBatchBuffer(INITIAL_CAPACITY);
+		frames.resize(frameCount);
+		for (auto& frame : frames) {
+			createStagingBuffer(frame, INITIAL_CAPACITY * sizeof(ObjectData));
+			createInstanceBuffer(frame, INITIAL_CAPACITY);
+			writeDescriptorSet(frame);
+		}
+	}
+
+	Vk3dGpuScene::~Vk3dGpuScene() {
+	}
+
+	void Vk3dGpuScene::createObjectBuffer(uint32_t capacity) {
+		objectBuffer = std::make_unique<Vk3dBuffer>(
+			vk3dDevice,
+			sizeof(ObjectData),
+			capacity,
+			VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+			VMA_MEMORY_USAGE_GPU_ONLY,
+			VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+			vk3dAllocator);
+		this->capacity = capacity;
+		for (auto& frame : frames) {
+			writeDescriptorSet(frame);
+		}
+	}
+
+	void Vk3dGpuScene::createBatchBuffer(uint32_t capacity) {
+		batchBuffer = std::make_unique<Vk3dBuffer>(
+			vk3dDevice,
+			sizeof(BatchData),
+			capacity,
+			VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+			VMA_MEMORY_USAGE_GPU_ONLY,
+			VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+			vk3dAllocator);
+		batchCapacity = capacity;
+		for (auto& frame : frames) {
+			writeDescriptorSet(frame);
+		}
+	}
+
+	void Vk3dGpuScene::createStagingBuffer(FrameResources& frame, VkDeviceSize size) {
+		frame.stagingBuffer = std::make_unique<Vk3dBuffer>(
+			vk3dDevice,
+			1,
+			static_cast<uint32_t>(size),
+			VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+			VMA_MEMORY_USAGE_CPU_TO_GPU,
+			VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT,
+			vk3dAllocator);
+		frame.stagingBuffer->map();
+		frame.stagingSize = size;
+	}
+
+	void Vk3dGpuScene::createInstanceBuffer(FrameResources& frame, uint32_t capacity) {
+		if (gpuInstances) {
+			frame.instanceBuffer = std::make_unique<Vk3dBuffer>(
+				vk3dDevice,
+				sizeof(uint32_t),
+				capacity,
+				VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+				VMA_MEMORY_USAGE_GPU_ONLY,
+				VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+				vk3dAllocator);
+		}
+		else {
+			frame.instanceBuffer = std::make_unique<Vk3dBuffer>(
+				vk3dDevice,
+				sizeof(uint32_t),
+				capacity,
+				VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+				VMA_MEMORY_USAGE_CPU_TO_GPU,
+				VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT,
+				vk3dAllocator);
+			frame.instanceBuffer->map();
+		}
+		frame.instanceCapacity = capacity;
+	}
+
+	void Vk3dGpuScene::writeDescriptorSet(FrameResources& frame) {
+		auto objectInfo = objectBuffer->descriptorInfo();
+		auto instanceInfo = frame.instanceBuffer->descriptorInfo();
+		auto batchInfo = batchBuffer->descriptorInfo();
+		Vk3dDescriptorWriter writer{ *setLayout, *descriptorPool };
+		writer.writeBuffer(0, &objectInfo)
+			.writeBuffer(1, &instanceInfo)
+			.writeBuffer(2, &batchInfo);
+		if (frame.descriptorSet == VK_NULL_HANDLE) {
+			writer.build(frame.descriptorSet);
+		}
+		else {
+			writer.overwrite(frame.descriptorSet);
+		}
+	}
+
+	bool Vk3dGpuScene::assignBatch(const Vk3dScene& scene, uint32_t slot) {
+		// only the indexed models are drawn by the cull shader
+		const Vk3dModel* model = nullptr;
+		uint32_t index = scene.getSlotIndex(slot);
+		if (index != Vk3dScene::INVALID_INDEX && scene.getModels()[index] && scene.getModels()[index]->isIndexed()) {
+			model = scene.getModels()[index].get();
+		}
+
+		uint32_t& batchIndex = slotBatches[slot];
+		const Vk3dModel* current = batchIndex == INVALID_BATCH ? nullptr : batches[batchIndex].model;
+		if (model == current) {
+			return false;
+		}
+
+		if (batchIndex != INVALID_BATCH) {
+			Batch& batch = batches[batchIndex];
+			if (--batch.objectCount == 0) {
+				modelBatches.erase(batch.model);
+				batch.model = nullptr;
+				freeBatches.push_back(batchIndex);
+			}
+			batchIndex = INVALID_BATCH;
+		}
+		if (model) {
+			auto it = modelBatches.find(model);
+			if (it == modelBatches.end()) {
+				uint32_t newBatch = static_cast<uint32_t>(batches.size());
+				if (!freeBatches.empty()) {
+					newBatch = freeBatches.back();
+					freeBatches.pop_back();
+				}
+				else {
+					batches.emplace_back();
+				}
+				batches[newBatch].model = model;
+				it = modelBatches.emplace(model, newBatch).first;
+			}
+			batchIndex = it->second;
+			batches[batchIndex].objectCount++;
+		}
+		return true;
+	}
+
+	void Vk3dGpuScene::layoutBatches() {
+		// a batch of n objects with k LODs takes k commands and k * n instances of every section
+		batchData.resize(batches.size());
+		commandCount = 0;
+		instanceCount = 0;
+		for (size_t i = 0; i < batches.size(); i++) {
+			const Batch& batch = batches[i];
+			BatchData& data = batchData[i];
+			data = BatchData{};
+			if (!batch.model) {
+				continue;
+			}
+
+			data.lodCount = batch.model->getLodCount();
+			for (uint32_t lod = 0; lod < data.lodCount; lod++) {
+				VkDrawIndexedIndirectCommand command = batch.model->getDrawCommand(lod);
+				data.lodFirstIndex[lod] = command.firstIndex;
+				data.lodIndexCount[lod] = command.indexCount;
+				data.vertexOffset = command.vertexOffset;
+			}
+			data.firstCommand = commandCount;
+			data.firstInstance = instanceCount;
+			data.objectCount = batch.objectCount;
+			commandCount += data.lodCount;
+			instanceCount += data.lodCount * batch.objectCount;
+		}
+
+		if (batches.size() > batchCapacity) {
+			uint32_t newCapacity = batchCapacity;
+			while (newCapacity < batches.size()) {
+				newCapacity *= 2;
+			}
+			// the frames in flight still read the old buffer
+			vkDeviceWaitIdle(vk3dDevice.device());
+			createBatchBuffer(newCapacity);
+		}
+	}
+
+	Vk3dGpuScene::ObjectData Vk3dGpuScene::getObjectData(const Vk3dScene& scene, uint32_t slot) {
+		ObjectData data{};
+		uint32_t index = scene.getSlotIndex(slot);
+		// free slot, or an object only used to group others
+		if (index == Vk3dScene::INVALID_INDEX || !scene.getModels()[index]) {
+			return data;
+		}
+
+		const Vk3dModel& model = *scene.getModels()[index];
+		data.modelMatrix = scene.getWorldMatrix(index) * model.getPositionTransform();
+		data.normalMatrix = glm::mat4{ scene.getNormalMatrix(index) };
+		const Vk3dAabb& bounds = scene.getWorldBounds()[index];
+		data.boundsMin = glm::vec4{ bounds.min, 0.f };
+		data.boundsMax = glm::vec4{ bounds.max, 0.f };
+		Vk3dSphere sphere = scene.getWorldBoundingSphere(index);
+		data.boundingSphere = glm::vec4{ sphere.center, sphere.radius };
+		data.reflection = scene.getReflections()[index];
+
+		// models without indices are only drawn by the CPU loops, which still read the matrices
+		if (model.isIndexed()) {
+			data.lodCount = model.getLodCount();
+			for (uint32_t lod = 0; lod < data.lodCount; lod++) {
+				VkDrawIndexedIndirectCommand command = model.getDrawCommand(lod);
+				data.lodFirstIndex[lod] = command.firstIndex;
+				data.lodIndexCount[lod] = command.indexCount;
+				data.vertexOffset = command.vertexOffset;
+			}
+		}
+		return data;
+	}
+
+	void Vk3dGpuScene::update(VkCommandBuffer commandBuffer, int frameIndex, Vk3dScene& scene) {
+		VK3D_PROFILE_ZONE("Vk3dGpuScene::update");
+		this->frameIndex = frameIndex;
+		FrameResources& frame = frames[frameIndex];
+		frame.instanceCount = 0;
+
+		uint32_t sceneSlotCount = scene.getSlotCount();
+		if (sceneSlotCount > capacity) {
+			uint32_t newCapacity = capacity;
+			while (newCapacity < sceneSlotCount) {
+				newCapacity *= 2;
+			}
+			// the frames in flight still read the old buffer
+			vkDeviceWaitIdle(vk3dDevice.device());
+			createObjectBuffer(newCapacity);
+			// the new buffer starts empty
+			uploadSlots.resize(sceneSlotCount);
+			for (uint32_t slot = 0; slot < sceneSlotCount; slot++) {
+				uploadSlots[slot] = slot;
+			}
+		}
+		else {
+			uploadSlots.assign(scene.getChangedSlots().begin(), scene.getChangedSlots().end());
+		}
+		scene.clearChangedSlots();
+		slotCount = sceneSlotCount;
+		slotBatches.resize(slotCount, INVALID_BATCH);
+
+		// created, destroyed and remodeled objects move between batches, the ranges of every batch follow
+		bool batchesChanged = false;
+		for (uint32_t slot : uploadSlots) {
+			if (assignBatch(scene, slot)) {
+				batchesChanged = true;
+			}
+		}
+		if (batchesChanged) {
+			layoutBatches();
+		}
+		if (!gpuInstances) {
+			reserveInstances(frameIndex, CPU_INSTANCE_PASSES * slotCount);
+		}
+		if (uploadSlots.empty() && !batchesChanged) {
+			return;
+		}
+
+		// the fence of the frame was waited on, its staging buffer is free
+		uint32_t uploadCount = static_cast<uint32_t>(uploadSlots.size());
+		VkDeviceSize objectSize = static_cast<VkDeviceSize>(uploadCount) * sizeof(ObjectData);
+		VkDeviceSize batchSize = batchesChanged ? batchData.size() * sizeof(BatchData) : 0;
+		if (objectSize + batchSize > frame.stagingSize) {
+			VkDeviceSize newSize = frame.stagingSize;
+			while (newSize < objectSize + batchSize) {
+				newSize *= 2;
+			}
+			createStagingBuffer(frame, newSize);
+		}
+
+		auto* staging = static_cast<char*>(frame.stagingBuffer->getMappedMemory());
+		auto* objects = reinterpret_cast<ObjectData*>(staging);
+		regions.resize(uploadCount);
+		for (uint32_t j = 0; j < uploadCount; j++) {
+			objects[j] = getObjectData(scene, uploadSlots[j]);
+			uint32_t batch = slotBatches[uploadSlots[j]];
+			objects[j].batch = batch == INVALID_BATCH ? 0 : batch;
+			regions[j].srcOffset = j * sizeof(ObjectData);
+			regions[j].dstOffset = static_cast<VkDeviceSize>(uploadSlots[j]) * sizeof(ObjectData);
+			regions[j].size = sizeof(ObjectData);
+		}
+		if (batchSize > 0) {
+			std::memcpy(staging + objectSize, batchData.data(), batchSize);
+		}
+		frame.stagingBuffer->flush();
+
+		// the previous frame may still be drawing with the objects being replaced
+		vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_VERTEX_SHADER_BIT | VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT,
+			0, 0, nullptr, 0, nullptr, 0, nullptr);
+		if (uploadCount > 0) {
+			vkCmdCopyBuffer(commandBuffer, frame.stagingBuffer->getBuffer(), objectBuffer->getBuffer(), uploadCount, regions.data());
+		}
+		if (batchSize > 0) {
+			VkBufferCopy batchRegion{ objectSize, 0, batchSize };
+			vkCmdCopyBuffer(commandBuffer, frame.stagingBuffer->getBuffer(), batchBuffer->getBuffer(), 1, &batchRegion);
+		}
+
+		VkMemoryBarrier barrier{};
+		barrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+		barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+		barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+		vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_VERTEX_SHADER_BIT | VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+			0, 1, &barrier, 0, nullptr, 0, nullptr);
+	}
+
+	void Vk3dGpuScene::reserveInstances(int frameIndex, uint32_t count) {
+		FrameResources& frame = frames[frameIndex];
+		if (count <= frame.instanceCapacity) {
+			return;
+		}
+		uint32_t newCapacity = frame.instanceCapacity;
+		while (newCapacity < count) {
+			newCapacity *= 2;
+		}
+		// the fence of the frame was waited on, nothing reads its instances anymore
+		createInstanceBuffer(frame, newCapacity);
+		writeDescriptorSet(frame);
+	}
+
+	uint32_t Vk3dGpuScene::writeInstances(const uint32_t* slots, uint32_t count) {
+		assert(!gpuInstances && "The instances are written by the GPU");
+		FrameResources& frame = frames[frameIndex];
+		assert(frame.instanceCount + count <= frame.instanceCapacity && "More instances than reserved for the frame");
+		uint32_t firstInstance = frame.instanceCount;
+		if (count == 0) {
+			return firstInstance;
+		}
+		std::memcpy(static_cast<uint32_t*>(frame.instanceBuffer->getMappedMemory()) + firstInstance, slots, count * sizeof(uint32_t));
+		frame.instanceBuffer->flush(count * sizeof(uint32_t), firstInstance * sizeof(uint32_t));
+		frame.instanceCount += count;
+		return firstInstance;
+	}
+
+}
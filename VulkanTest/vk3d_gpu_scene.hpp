@@ -0,0 +1,154 @@
+#pragma once
+
+#include "vk3d_device.hpp"
+#include "vk3d_allocator.hpp"
+#include "vk3d_buffer.hpp"
+#include "vk3d_descriptors.hpp"
+#include "vk3d_scene.hpp"
+
+// libs
+#define GLM_FORCE_RADIANS
+#define GLM_FORCE_DEPTH_ZERO_TO_ONE
+#include <glm/glm.hpp>
+
+// std
+#include <memory>
+#include <unordered_map>
+#include <vector>
+
+namespace vk3d {
+	// Copy of the scene on the GPU: what every object is drawn and culled with, in a storage buffer indexed by slot.
+	// Slots don't move when the scene compacts, so only the slots the scene reports as changed are uploaded, and the
+	// CPU cost of a frame follows the objects that changed instead of the objects in the scene.
+	//
+	// Objects sharing a model are drawn together, one instanced draw per model and LOD. The vertex shaders read the
+	// slot of their object in the instance buffer of the frame at gl_InstanceIndex. The instances are written by
+	// Vk3dGpuCuller, or by Vk3dRenderQueue when the passes draw from the CPU. For the GPU the objects are grouped in
+	// batches, one per model, whose ranges of commands and instances only move when objects are added or removed.
+	class Vk3dGpuScene {
+	public:
+		// std430 ObjectData of the shaders
+		struct ObjectData {
+			// world matrix with the position transform of the model applied
+			glm::mat4 modelMatrix{ 1.f };
+			glm::mat4 normalMatrix{ 1.f };
+			// world bounding box, w unused
+			glm::vec4 boundsMin{ 0.f };
+			glm::vec4 boundsMax{ 0.f };
+			// world bounding sphere, radius in w, for the LOD selection
+			glm::vec4 boundingSphere{ 0.f };
+			// index range of every LOD in the geometry pool
+			glm::uvec4 lodFirstIndex{ 0 };
+			glm::uvec4 lodIndexCount{ 0 };
+			int32_t vertexOffset = 0;
+			// 0 for free slots and objects without an indexed model, the indirect draws skip them
+			uint32_t lodCount = 0;
+			float reflection = 0.f;
+			// index in the batch buffer
+			uint32_t batch = 0;
+		};
+
+		// std430 BatchData of the cull shader, the objects sharing a model
+		struct BatchData {
+			glm::uvec4 lodFirstIndex{ 0 };
+			glm::uvec4 lodIndexCount{ 0 };
+			int32_t vertexOffset = 0;
+			// 0 for free batches
+			uint32_t lodCount = 0;
+			// first of the lodCount commands of the batch in every section
+			uint32_t firstCommand = 0;
+			// first instance of the batch in every section, each LOD takes objectCount instances
+			uint32_t firstInstance = 0;
+			uint32_t objectCount = 0;
+			uint32_t padding[3]{};
+		};
+
+		static constexpr uint32_t INITIAL_CAPACITY = 256;
+		// instances the CPU draws at most per object and frame: six cube faces, mappings, UV reflection and G-buffer
+		static constexpr uint32_t CPU_INSTANCE_PASSES = 9;
+
+		// gpuInstances keeps the instance buffers on the device for Vk3dGpuCuller, otherwise the CPU writes them
+		Vk3dGpuScene(Vk3dDevice& device, Vk3dAllocator& allocator, bool gpuInstances);
+		~Vk3dGpuScene();
+
+		Vk3dGpuScene(const Vk3dGpuScene&) = delete;
+		Vk3dGpuScene& operator=(const Vk3dGpuScene&) = delete;
+
+		// Records the upload of the changed slots and batches and clears the slots in the scene. Call it once per frame
+		// after updateMatrices, outside of a render pass and before anything reads the objects or the descriptor set.
+		void update(VkCommandBuffer commandBuffer, int frameIndex, Vk3dScene& scene);
+		// Grows the instance buffer of the frame, before its descriptor set is bound
+		void reserveInstances(int frameIndex, uint32_t instanceCount);
+		// Appends the slots to the instance buffer of the frame and returns the instance of the first one. Only when
+		// the CPU writes the instances.
+		uint32_t writeInstances(const uint32_t* slots, uint32_t count);
+
+		// Storage buffers of the objects at binding 0 and of the instances at binding 1, read by the vertex and compute
+		// shaders, and of the batches at binding 2, read by the compute shaders
+		VkDescriptorSetLayout getDescriptorSetLayout() const { return setLayout->getDescriptorSetLayout(); }
+		VkDescriptorSet getDescriptorSet(int frameIndex) const { return frames[frameIndex].descriptorSet; }
+		// Slots of the scene at the last update
+		uint32_t getSlotCount() const { return slotCount; }
+		// Batches, free ones included, and commands and instances of a section, as of the last update
+		uint32_t getBatchCount() const { return static_cast<uint32_t>(batches.size()); }
+		uint32_t getCommandCount() const { return commandCount; }
+		uint32_t getInstanceCount() const { return instanceCount; }
+
+	private:
+		struct FrameResources {
+			// bytes of the objects and batches uploaded by the frame
+			std::unique_ptr<Vk3dBuffer> stagingBuffer;
+			VkDeviceSize stagingSize = 0;
+			std::unique_ptr<Vk3dBuffer> instanceBuffer;
+			uint32_t instanceCapacity = 0;
+			// instances written by writeInstances this frame
+			uint32_t instanceCount = 0;
+			VkDescriptorSet descriptorSet = VK_NULL_HANDLE;
+		};
+
+		struct Batch {
+			// null for free batches
+			const Vk3dModel* model = nullptr;
+			uint32_t objectCount = 0;
+		};
+
+		void createObjectBuffer(uint32_t capacity);
+		void createBatchBuffer(uint32_t capacity);
+		void createStagingBuffer(FrameResources& frame, VkDeviceSize size);
+		void createInstanceBuffer(FrameResources& frame, uint32_t capacity);
+		void writeDescriptorSet(FrameResources& frame);
+		// moves the slot to the batch of its model, true when the batches changed
+		bool assignBatch(const Vk3dScene& scene, uint32_t slot);
+		void layoutBatches();
+		static ObjectData getObjectData(const Vk3dScene& scene, uint32_t slot);
+
+		Vk3dDevice& vk3dDevice;
+		Vk3dAllocator& vk3dAllocator;
+		bool gpuInstances;
+
+		std::unique_ptr<Vk3dDescriptorPool> descriptorPool;
+		std::unique_ptr<Vk3dDescriptorSetLayout> setLayout;
+
+		std::unique_ptr<Vk3dBuffer> objectBuffer;
+		uint32_t capacity = 0;
+		uint32_t slotCount = 0;
+		std::vector<FrameResources> frames;
+		int frameIndex = 0;
+
+		std::unique_ptr<Vk3dBuffer> batchBuffer;
+		uint32_t batchCapacity = 0;
+		std::vector<Batch> batches;
+		std::vector<BatchData> batchData;
+		std::vector<uint32_t> freeBatches;
+		std::unordered_map<const Vk3dModel*, uint32_t> modelBatches;
+		static constexpr uint32_t INVALID_BATCH = UINT32_MAX;
+		// batch of every slot, INVALID_BATCH when the slot is not drawn by the GPU
+		std::vector<uint32_t> slotBatches;
+		uint32_t commandCount = 0;
+		uint32_t instanceCount = 0;
+
+		// reused every frame
+		std::vector<uint32_t> uploadSlots;
+		std::vector<VkBufferCopy> regions;
+	};
+}
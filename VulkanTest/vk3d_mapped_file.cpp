@@ -0,0 +1,91 @@
+#include "vk3d_mapped_file.hpp"
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace vk3d {
+
+#ifdef _WIN32
+	Vk3dMappedFile::Vk3dMappedFile(const std::string& filepath) {
+		HANDLE file = CreateFileA(filepath.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+		if (file == INVALID_HANDLE_VALUE) {
+			return;
+		}
+		fileHandle = file;
+
+		LARGE_INTEGER size;
+		if (!GetFileSizeEx(file, &size) || size.QuadPart == 0) {
+			close();
+			return;
+		}
+		fileSize = static_cast<size_t>(size.QuadPart);
+
+		mappingHandle = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+		if (mappingHandle == nullptr) {
+			close();
+			return;
+		}
+
+		mapped = MapViewOfFile(mappingHandle, FILE_MAP_READ, 0, 0, 0);
+		if (mapped == nullptr) {
+			close();
+		}
+	}
+
+	void Vk3dMappedFile::close() {
+		if (mapped != nullptr) {
+			UnmapViewOfFile(mapped);
+		}
+		if (mappingHandle != nullptr) {
+			CloseHandle(mappingHandle);
+		}
+		if (fileHandle != nullptr) {
+			CloseHandle(fileHandle);
+		}
+		mapped = nullptr;
+		mappingHandle = nullptr;
+		fileHandle = nullptr;
+		fileSize = 0;
+	}
+#else
+	Vk3dMappedFile::Vk3dMappedFile(const std::string& filepath) {
+		int file = open(filepath.c_str(), O_RDONLY);
+		if (file < 0) {
+			return;
+		}
+
+		struct stat fileStat;
+		if (fstat(file, &fileStat) == 0 && fileStat.st_size > 0) {
+			void* data = mmap(nullptr, static_cast<size_t>(fileStat.st_size), PROT_READ, MAP_PRIVATE, file, 0);
+			if (data != MAP_FAILED) {
+				mapped = data;
+				fileSize = static_cast<size_t>(fileStat.st_size);
+			}
+		}
+
+		// the mapping stays valid after the descriptor is closed
+		::close(file);
+	}
+
+	void Vk3dMappedFile::close() {
+		if (mapped != nullptr) {
+			munmap(const_cast<void*>(mapped), fileSize);
+		}
+		mapped = nullptr;
+		fileSize = 0;
+	}
+#endif
+
+	Vk3dMappedFile::~Vk3dMappedFile() {
+		close();
+	}
+
+}
@@ -0,0 +1,31 @@
+#pragma once
+
+// std
+#include <cstddef>
+#include <string>
+
+namespace vk3d {
+	// Read-only memory mapping of a whole file. A missing or empty file leaves the mapping closed instead of throwing.
+	class Vk3dMappedFile {
+	public:
+		Vk3dMappedFile(const std::string& filepath);
+		~Vk3dMappedFile();
+
+		Vk3dMappedFile(const Vk3dMappedFile&) = delete;
+		Vk3dMappedFile& operator=(const Vk3dMappedFile&) = delete;
+
+		bool isOpen() const { return mapped != nullptr; }
+		const void* data() const { return mapped; }
+		size_t size() const { return fileSize; }
+
+	private:
+		void close();
+
+		const void* mapped = nullptr;
+		size_t fileSize = 0;
+#ifdef _WIN32
+		void* fileHandle = nullptr;
+		void* mappingHandle = nullptr;
+#endif
+	};
+}
@@ -0,0 +1,104 @@
+#include "vk3d_mesh_cache.hpp"
+
+// std
+#include <algorithm>
+#include <cassert>
+#include <cstdio>
+#include <fstream>
+#include <iostream>
+#include <limits>
+#include <stdexcept>
+
+namespace vk3d {
+
+	Vk3dMeshCache::Vk3dMeshCache(const std::string& cachePath, uint64_t sourceHash) : file{ cachePath } {
+		if (!file.isOpen() || file.size() < sizeof(Header)) {
+			return;
+		}
+
+		const Header& header = getHeader();
+		size_t expectedSize = sizeof(Header)
+			+ static_cast<size_t>(header.lodCount) * sizeof(Vk3dModel::Lod)
+			+ static_cast<size_t>(header.vertexCount) * sizeof(Vk3dModel::Vertex)
+			+ static_cast<size_t>(header.indexCount) * sizeof(uint32_t);
+
+		valid = header.magic == MAGIC
+			&& header.version == VERSION
+			&& header.vertexSize == sizeof(Vk3dModel::Vertex)
+			&& header.sourceHash == sourceHash
+			&& header.lodCount <= Vk3dModel::MAX_LODS
+			&& file.size() == expectedSize;
+	}
+
+	const Vk3dModel::Lod* Vk3dMeshCache::getLods() const {
+		assert(valid && "Can't read LODs from an invalid mesh cache");
+		return reinterpret_cast<const Vk3dModel::Lod*>(static_cast<const char*>(file.data()) + sizeof(Header));
+	}
+
+	const Vk3dModel::Vertex* Vk3dMeshCache::getVertices() const {
+		assert(valid && "Can't read vertices from an invalid mesh cache");
+		return reinterpret_cast<const Vk3dModel::Vertex*>(getLods() + getHeader().lodCount);
+	}
+
+	const uint32_t* Vk3dMeshCache::getIndices() const {
+		assert(valid && "Can't read indices from an invalid mesh cache");
+		return reinterpret_cast<const uint32_t*>(getVertices() + getHeader().vertexCount);
+	}
+
+	uint64_t Vk3dMeshCache::hashFile(const std::string& filepath) {
+		Vk3dMappedFile source{ filepath };
+		if (!source.isOpen()) {
+			throw std::runtime_error("failed to open file: " + filepath);
+		}
+
+		// 64-bit FNV-1a
+		uint64_t hash = 0xcbf29ce484222325ull;
+		const unsigned char* bytes = static_cast<const unsigned char*>(source.data());
+		for (size_t i = 0; i < source.size(); i++) {
+			hash ^= bytes[i];
+			hash *= 0x100000001b3ull;
+		}
+		return hash;
+	}
+
+	void Vk3dMeshCache::write(const std::string& cachePath, const Vk3dModel::Builder& builder, uint64_t sourceHash) {
+		Header header{};
+		header.magic = MAGIC;
+		header.version = VERSION;
+		header.vertexSize = sizeof(Vk3dModel::Vertex);
+		header.vertexCount = static_cast<uint32_t>(builder.vertices.size());
+		header.indexCount = static_cast<uint32_t>(builder.indices.size());
+		header.lodCount = static_cast<uint32_t>(builder.lods.size());
+		header.sourceHash = sourceHash;
+
+		for (int axis = 0; axis < 3; axis++) {
+			header.boundsMin[axis] = std::numeric_limits<float>::max();
+			header.boundsMax[axis] = std::numeric_limits<float>::lowest();
+		}
+		for (const auto& vertex : builder.vertices) {
+			for (int axis = 0; axis < 3; axis++) {
+				header.boundsMin[axis] = std::min(header.boundsMin[axis], vertex.position[axis]);
+				header.boundsMax[axis] = std::max(header.boundsMax[axis], vertex.position[axis]);
+			}
+		}
+
+		// a cache that can't be written only costs the OBJ parse on the next launch
+		std::ofstream file{ cachePath, std::ios::binary | std::ios::trunc };
+		if (!file.is_open()) {
+			std::cerr << "failed to write mesh cache: " << cachePath << std::endl;
+			return;
+		}
+
+		file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+		file.write(reinterpret_cast<const char*>(builder.lods.data()), builder.lods.size() * sizeof(Vk3dModel::Lod));
+		file.write(reinterpret_cast<const char*>(builder.vertices.data()), builder.vertices.size() * sizeof(Vk3dModel::Vertex));
+		file.write(reinterpret_cast<const char*>(builder.indices.data()), builder.indices.size() * sizeof(uint32_t));
+
+		if (!file.good()) {
+			file.close();
+			std::remove(cachePath.c_str());
+			std::cerr << "failed to write mesh cache: " << cachePath << std::endl;
+		}
+	}
+
+}
@@ -0,0 +1,53 @@
+#pragma once
+
+#include "vk3d_mapped_file.hpp"
+#include "vk3d_model.hpp"
+
+// std
+#include <cstdint>
+#include <string>
+
+namespace vk3d {
+	// Binary cache of the already deduplicated vertex and index arrays of an OBJ file, stored next to it.
+	// File layout: Header, lodCount Lod, vertexCount Vertex, indexCount uint32_t. It is memory mapped so the arrays can
+	// be copied straight into the staging buffers, and ignored whenever the OBJ content hash differs.
+	class Vk3dMeshCache {
+	public:
+		static constexpr uint32_t MAGIC = 0x4d443356; // "V3DM"
+		// bump whenever Vk3dModel::Vertex, the deduplication or the mesh optimization changes
+		static constexpr uint32_t VERSION = 4;
+		static constexpr const char* EXTENSION = ".v3dmesh";
+
+		struct Header {
+			uint32_t magic;
+			uint32_t version;
+			uint32_t vertexSize;
+			uint32_t vertexCount;
+			uint32_t indexCount;
+			uint32_t lodCount;
+			uint64_t sourceHash;
+			float boundsMin[3];
+			float boundsMax[3];
+		};
+
+		Vk3dMeshCache(const std::string& cachePath, uint64_t sourceHash);
+
+		Vk3dMeshCache(const Vk3dMeshCache&) = delete;
+		Vk3dMeshCache& operator=(const Vk3dMeshCache&) = delete;
+
+		// false if the cache is missing, truncated, from another version or built from a different source
+		bool isValid() const { return valid; }
+		const Header& getHeader() const { return *static_cast<const Header*>(file.data()); }
+		const Vk3dModel::Lod* getLods() const;
+		const Vk3dModel::Vertex* getVertices() const;
+		const uint32_t* getIndices() const;
+
+		static std::string getCachePath(const std::string& sourcePath) { return sourcePath + EXTENSION; }
+		static uint64_t hashFile(const std::string& filepath);
+		static void write(const std::string& cachePath, const Vk3dModel::Builder& builder, uint64_t sourceHash);
+
+	private:
+		Vk3dMappedFile file;
+		bool valid = false;
+	};
+}
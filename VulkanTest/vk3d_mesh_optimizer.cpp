@@ -0,0 +1,241 @@
+#include "vk3d_mesh_optimizer.hpp"
+
+#include "vk3d_profiler.hpp"
+
+// std
+#include <algorithm>
+#include <cassert>
+#include <numeric>
+
+namespace vk3d {
+
+	namespace {
+		constexpr uint32_t INVALID_VERTEX = UINT32_MAX;
+
+		// Triangles adjacent to every vertex, in compressed rows
+		struct VertexAdjacency {
+			std::vector<uint32_t> offsets;
+			std::vector<uint32_t> triangles;
+
+			VertexAdjacency(const std::vector<uint32_t>& indices, size_t vertexCount) : offsets(vertexCount + 1, 0), triangles(indices.size()) {
+				for (uint32_t index : indices) {
+					offsets[index + 1]++;
+				}
+				std::partial_sum(offsets.begin(), offsets.end(), offsets.begin());
+
+				std::vector<uint32_t> cursor(offsets.begin(), offsets.end() - 1);
+				for (size_t i = 0; i < indices.size(); i++) {
+					triangles[cursor[indices[i]]++] = static_cast<uint32_t>(i / 3);
+				}
+			}
+		};
+	}
+
+	void Vk3dMeshOptimizer::optimize(std::vector<Vk3dModel::Vertex>& vertices, std::vector<uint32_t>& indices, bool sortClusters) {
+		VK3D_PROFILE_ZONE("Vk3dMeshOptimizer::optimize");
+		std::vector<uint32_t> clusters;
+		indices = optimizeVertexCache(indices, vertices.size(), CACHE_SIZE, clusters);
+		if (sortClusters) {
+			optimizeOverdraw(vertices, indices, clusters);
+		}
+		optimizeVertexFetch(vertices, indices);
+	}
+
+	std::vector<uint32_t> Vk3dMeshOptimizer::optimizeVertexCache(const std::vector<uint32_t>& indices, size_t vertexCount, uint32_t cacheSize, std::vector<uint32_t>& clusters) {
+		assert(indices.size() % 3 == 0 && "Index count must be a multiple of 3");
+		size_t triangleCount = indices.size() / 3;
+		clusters.clear();
+
+		std::vector<uint32_t> output;
+		output.reserve(indices.size());
+		if (triangleCount == 0) {
+			return output;
+		}
+
+		VertexAdjacency adjacency{ indices, vertexCount };
+
+		// triangles not emitted yet around every vertex
+		std::vector<uint32_t> liveTriangles(vertexCount);
+		for (size_t v = 0; v < vertexCount; v++) {
+			liveTriangles[v] = adjacency.offsets[v + 1] - adjacency.offsets[v];
+		}
+
+		// a vertex is in the cache while time - cacheTime[v] <= cacheSize
+		std::vector<uint32_t> cacheTime(vertexCount, 0);
+		uint32_t time = cacheSize + 1;
+
+		std::vector<bool> emitted(triangleCount, false);
+		std::vector<uint32_t> deadEnd;
+		std::vector<uint32_t> candidates;
+		uint32_t inputCursor = 0;
+
+		// start from the first vertex with triangles, then keep fanning around the best vertex in the cache
+		uint32_t fanningVertex = indices[0];
+		clusters.push_back(0);
+
+		while (fanningVertex != INVALID_VERTEX) {
+			candidates.clear();
+
+			for (uint32_t a = adjacency.offsets[fanningVertex]; a < adjacency.offsets[fanningVertex + 1]; a++) {
+				uint32_t triangle = adjacency.triangles[a];
+				if (emitted[triangle]) {
+					continue;
+				}
+				emitted[triangle] = true;
+
+				for (uint32_t k = 0; k < 3; k++) {
+					uint32_t vertex = indices[triangle * 3 + k];
+					output.push_back(vertex);
+					deadEnd.push_back(vertex);
+					candidates.push_back(vertex);
+					liveTriangles[vertex]--;
+
+					if (time - cacheTime[vertex] > cacheSize) {
+						cacheTime[vertex] = time++;
+					}
+				}
+			}
+
+			// prefer the oldest candidate still in the cache that will stay there while its remaining triangles are emitted
+			uint32_t nextVertex = INVALID_VERTEX;
+			int bestPriority = -1;
+			for (uint32_t vertex : candidates) {
+				if (liveTriangles[vertex] == 0) {
+					continue;
+				}
+				int priority = 0;
+				if (time - cacheTime[vertex] + 2 * liveTriangles[vertex] <= cacheSize) {
+					priority = static_cast<int>(time - cacheTime[vertex]);
+				}
+				if (priority > bestPriority) {
+					bestPriority = priority;
+					nextVertex = vertex;
+				}
+			}
+
+			if (nextVertex == INVALID_VERTEX) {
+				// dead end: restart from the most recent vertex with triangles left, which starts a new cluster
+				while (!deadEnd.empty() && nextVertex == INVALID_VERTEX) {
+					uint32_t vertex = deadEnd.back();
+					deadEnd.pop_back();
+					if (liveTriangles[vertex] > 0) {
+						nextVertex = vertex;
+					}
+				}
+				while (nextVertex == INVALID_VERTEX && inputCursor < vertexCount) {
+					if (liveTriangles[inputCursor] > 0) {
+						nextVertex = inputCursor;
+					}
+					inputCursor++;
+				}
+				if (nextVertex != INVALID_VERTEX) {
+					clusters.push_back(static_cast<uint32_t>(output.size() / 3));
+				}
+			}
+
+			fanningVertex = nextVertex;
+		}
+
+		assert(output.size() == indices.size() && "Tipsify must emit every triangle once");
+		return output;
+	}
+
+	void Vk3dMeshOptimizer::optimizeOverdraw(const std::vector<Vk3dModel::Vertex>& vertices, std::vector<uint32_t>& indices, const std::vector<uint32_t>& clusters) {
+		uint32_t triangleCount = static_cast<uint32_t>(indices.size() / 3);
+		if (clusters.size() < 2) {
+			return;
+		}
+
+		glm::vec3 meshCenter{ 0.f };
+		for (const auto& vertex : vertices) {
+			meshCenter += vertex.position;
+		}
+		meshCenter /= static_cast<float>(vertices.size());
+
+		struct Cluster {
+			uint32_t begin;
+			uint32_t end;
+			float sortKey;
+		};
+		std::vector<Cluster> sortedClusters(clusters.size());
+
+		for (size_t c = 0; c < clusters.size(); c++) {
+			Cluster& cluster = sortedClusters[c];
+			cluster.begin = clusters[c];
+			cluster.end = c + 1 < clusters.size() ? clusters[c + 1] : triangleCount;
+
+			// area weighted centroid and normal of the cluster
+			glm::vec3 centroid{ 0.f };
+			glm::vec3 normal{ 0.f };
+			float area = 0.f;
+			for (uint32_t t = cluster.begin; t < cluster.end; t++) {
+				const glm::vec3& p0 = vertices[indices[t * 3 + 0]].position;
+				const glm::vec3& p1 = vertices[indices[t * 3 + 1]].position;
+				const glm::vec3& p2 = vertices[indices[t * 3 + 2]].position;
+				glm::vec3 triangleNormal = glm::cross(p1 - p0, p2 - p0);
+				float triangleArea = glm::length(triangleNormal);
+
+				centroid += (p0 + p1 + p2) * (triangleArea / 3.f);
+				normal += triangleNormal;
+				area += triangleArea;
+			}
+
+			float normalLength = glm::length(normal);
+			if (area > 0.f && normalLength > 0.f) {
+				cluster.sortKey = glm::dot(centroid / area - meshCenter, normal / normalLength);
+			}
+			else {
+				cluster.sortKey = 0.f;
+			}
+		}
+
+		std::stable_sort(sortedClusters.begin(), sortedClusters.end(), [](const Cluster& a, const Cluster& b) {
+			return a.sortKey > b.sortKey;
+		});
+
+		std::vector<uint32_t> sortedIndices;
+		sortedIndices.reserve(indices.size());
+		for (const auto& cluster : sortedClusters) {
+			sortedIndices.insert(sortedIndices.end(), indices.begin() + cluster.begin * 3, indices.begin() + cluster.end * 3);
+		}
+		indices.swap(sortedIndices);
+	}
+
+	void Vk3dMeshOptimizer::optimizeVertexFetch(std::vector<Vk3dModel::Vertex>& vertices, std::vector<uint32_t>& indices) {
+		std::vector<uint32_t> remap(vertices.size(), INVALID_VERTEX);
+		std::vector<Vk3dModel::Vertex> fetchOrder;
+		fetchOrder.reserve(vertices.size());
+
+		for (uint32_t& index : indices) {
+			if (remap[index] == INVALID_VERTEX) {
+				remap[index] = static_cast<uint32_t>(fetchOrder.size());
+				fetchOrder.push_back(vertices[index]);
+			}
+			index = remap[index];
+		}
+
+		// vertices no triangle references are dropped
+		vertices.swap(fetchOrder);
+	}
+
+	Vk3dVertexCacheStatistics Vk3dMeshOptimizer::analyzeVertexCache(const std::vector<uint32_t>& indices, size_t vertexCount, uint32_t cacheSize) {
+		Vk3dVertexCacheStatistics statistics{};
+		if (indices.empty() || vertexCount == 0) {
+			return statistics;
+		}
+
+		std::vector<uint32_t> cacheTime(vertexCount, 0);
+		uint32_t time = cacheSize + 1;
+		for (uint32_t index : indices) {
+			if (time - cacheTime[index] > cacheSize) {
+				cacheTime[index] = time++;
+				statistics.transformedVertices++;
+			}
+		}
+
+		statistics.acmr = static_cast<float>(statistics.transformedVertices) / (indices.size() / 3);
+		statistics.atvr = static_cast<float>(statistics.transformedVertices) / vertexCount;
+		return statistics;
+	}
+
+}
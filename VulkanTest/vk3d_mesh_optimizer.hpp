@@ -0,0 +1,40 @@
+#pragma once
+
+#include "vk3d_model.hpp"
+
+// std
+#include <cstdint>
+#include <vector>
+
+namespace vk3d {
+	// Post-transform vertex cache efficiency of an index buffer, simulated with a FIFO cache
+	struct Vk3dVertexCacheStatistics {
+		uint32_t transformedVertices = 0;
+		// transformed vertices per triangle, 3 is the worst case and about 0.5 the best one for large meshes
+		float acmr = 0.f;
+		// transformed vertices per vertex, 1 means every vertex is transformed only once
+		float atvr = 0.f;
+	};
+
+	// Reorders the welded mesh of a Vk3dModel::Builder for the GPU: triangles for the post-transform vertex cache
+	// (Tipsify, Sander et al. 2007), clusters of triangles to reduce overdraw and vertices for fetch locality.
+	// The set of triangles is never changed, only their order, the winding of each triangle is kept.
+	class Vk3dMeshOptimizer {
+	public:
+		// Cache size targeted by Tipsify and simulated by analyzeVertexCache, smaller than most GPUs actually have
+		static constexpr uint32_t CACHE_SIZE = 16;
+
+		// Runs every stage in order, clusters are only sorted for overdraw when sortClusters is set
+		static void optimize(std::vector<Vk3dModel::Vertex>& vertices, std::vector<uint32_t>& indices, bool sortClusters = true);
+
+		// Returns the reordered indices. clusters receives the first triangle of every cluster, a new cluster starts
+		// whenever Tipsify reaches a dead end and has to restart from a vertex which was not fanned from the previous one.
+		static std::vector<uint32_t> optimizeVertexCache(const std::vector<uint32_t>& indices, size_t vertexCount, uint32_t cacheSize, std::vector<uint32_t>& clusters);
+		// Draws clusters facing away from the mesh center first, they are the most likely to occlude the others
+		static void optimizeOverdraw(const std::vector<Vk3dModel::Vertex>& vertices, std::vector<uint32_t>& indices, const std::vector<uint32_t>& clusters);
+		// Renumbers the vertices in the order they are first referenced by the indices
+		static void optimizeVertexFetch(std::vector<Vk3dModel::Vertex>& vertices, std::vector<uint32_t>& indices);
+
+		static Vk3dVertexCacheStatistics analyzeVertexCache(const std::vector<uint32_t>& indices, size_t vertexCount, uint32_t cacheSize = CACHE_SIZE);
+	};
+}
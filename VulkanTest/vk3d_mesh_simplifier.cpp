@@ -0,0 +1,276 @@
+#include "vk3d_mesh_simplifier.hpp"
+
+#include "vk3d_profiler.hpp"
+
+// std
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+#include <numeric>
+#include <unordered_set>
+
+namespace vk3d {
+
+	namespace {
+		// Sum of the squared distances to a set of planes, weighted by the area of the triangles they come from
+		struct Quadric {
+			double a00 = 0.0, a01 = 0.0, a02 = 0.0, a11 = 0.0, a12 = 0.0, a22 = 0.0;
+			double b0 = 0.0, b1 = 0.0, b2 = 0.0;
+			double c = 0.0;
+			double weight = 0.0;
+
+			static Quadric fromPlane(const glm::vec3& normal, double d, double weight) {
+				Quadric q{};
+				q.a00 = weight * normal.x * normal.x;
+				q.a01 = weight * normal.x * normal.y;
+				q.a02 = weight * normal.x * normal.z;
+				q.a11 = weight * normal.y * normal.y;
+				q.a12 = weight * normal.y * normal.z;
+				q.a22 = weight * normal.z * normal.z;
+				q.b0 = weight * normal.x * d;
+				q.b1 = weight * normal.y * d;
+				q.b2 = weight * normal.z * d;
+				q.c = weight * d * d;
+				q.weight = weight;
+				return q;
+			}
+
+			Quadric& operator+=(const Quadric& other) {
+				a00 += other.a00; a01 += other.a01; a02 += other.a02;
+				a11 += other.a11; a12 += other.a12; a22 += other.a22;
+				b0 += other.b0; b1 += other.b1; b2 += other.b2;
+				c += other.c;
+				weight += other.weight;
+				return *this;
+			}
+
+			// mean squared distance of p to the planes
+			double error(const glm::vec3& p) const {
+				double x = p.x, y = p.y, z = p.z;
+				double e = a00 * x * x + a11 * y * y + a22 * z * z
+					+ 2.0 * (a01 * x * y + a02 * x * z + a12 * y * z)
+					+ 2.0 * (b0 * x + b1 * y + b2 * z)
+					+ c;
+				return weight > 0.0 ? std::abs(e) / weight : 0.0;
+			}
+		};
+
+		struct Collapse {
+			uint32_t from;
+			uint32_t to;
+			double error;
+		};
+
+		glm::vec3 triangleNormal(const glm::vec3& p0, const glm::vec3& p1, const glm::vec3& p2) {
+			return glm::cross(p1 - p0, p2 - p0);
+		}
+
+		// Vertices sharing their position get the same id, border and seam detection work on these ids
+		std::vector<uint32_t> buildPositionIds(const std::vector<Vk3dModel::Vertex>& vertices, std::vector<uint32_t>& positionUses) {
+			std::vector<uint32_t> order(vertices.size());
+			std::iota(order.begin(), order.end(), 0);
+			auto less = [&vertices](uint32_t a, uint32_t b) {
+				const glm::vec3& pa = vertices[a].position;
+				const glm::vec3& pb = vertices[b].position;
+				if (pa.x != pb.x) return pa.x < pb.x;
+				if (pa.y != pb.y) return pa.y < pb.y;
+				return pa.z < pb.z;
+			};
+			std::sort(order.begin(), order.end(), less);
+
+			std::vector<uint32_t> positionIds(vertices.size());
+			positionUses.clear();
+			for (size_t i = 0; i < order.size(); i++) {
+				if (i == 0 || less(order[i - 1], order[i])) {
+					positionUses.push_back(0);
+				}
+				positionIds[order[i]] = static_cast<uint32_t>(positionUses.size() - 1);
+				positionUses.back()++;
+			}
+			return positionIds;
+		}
+	}
+
+	std::vector<uint32_t> Vk3dMeshSimplifier::simplify(const std::vector<Vk3dModel::Vertex>& vertices, const std::vector<uint32_t>& indices,
+		size_t targetIndexCount, float targetError, float& error) {
+		VK3D_PROFILE_ZONE("Vk3dMeshSimplifier::simplify");
+		assert(indices.size() % 3 == 0 && "Index count must be a multiple of 3");
+		error = 0.f;
+
+		std::vector<uint32_t> result = indices;
+		size_t vertexCount = vertices.size();
+		if (result.size() <= targetIndexCount || vertexCount == 0) {
+			return result;
+		}
+
+		glm::vec3 boundsMin = vertices[0].position;
+		glm::vec3 boundsMax = vertices[0].position;
+		for (const auto& vertex : vertices) {
+			boundsMin = glm::min(boundsMin, vertex.position);
+			boundsMax = glm::max(boundsMax, vertex.position);
+		}
+		glm::vec3 size = boundsMax - boundsMin;
+		double extent = std::max(size.x, std::max(size.y, size.z));
+		if (extent <= 0.0) {
+			return result;
+		}
+		double errorLimit = (targetError * extent) * (targetError * extent);
+
+		// seams and open borders are locked
+		std::vector<uint32_t> positionUses;
+		std::vector<uint32_t> positionIds = buildPositionIds(vertices, positionUses);
+		std::vector<bool> locked(vertexCount, false);
+		for (size_t v = 0; v < vertexCount; v++) {
+			locked[v] = positionUses[positionIds[v]] > 1;
+		}
+
+		std::unordered_set<uint64_t> positionEdges;
+		auto edgeKey = [&positionIds](uint32_t a, uint32_t b) {
+			return (static_cast<uint64_t>(positionIds[a]) << 32) | positionIds[b];
+		};
+		for (size_t i = 0; i < result.size(); i += 3) {
+			for (int k = 0; k < 3; k++) {
+				positionEdges.insert(edgeKey(result[i + k], result[i + (k + 1) % 3]));
+			}
+		}
+		for (size_t i = 0; i < result.size(); i += 3) {
+			for (int k = 0; k < 3; k++) {
+				uint32_t a = result[i + k];
+				uint32_t b = result[i + (k + 1) % 3];
+				if (positionEdges.count(edgeKey(b, a)) == 0) {
+					locked[a] = true;
+					locked[b] = true;
+				}
+			}
+		}
+
+		std::vector<Quadric> quadrics(vertexCount);
+		for (size_t i = 0; i < result.size(); i += 3) {
+			const glm::vec3& p0 = vertices[result[i + 0]].position;
+			glm::vec3 normal = triangleNormal(p0, vertices[result[i + 1]].position, vertices[result[i + 2]].position);
+			float area = glm::length(normal);
+			if (area == 0.f) {
+				continue;
+			}
+			normal /= area;
+			Quadric quadric = Quadric::fromPlane(normal, -glm::dot(normal, p0), area * .5);
+			for (int k = 0; k < 3; k++) {
+				quadrics[result[i + k]] += quadric;
+			}
+		}
+
+		std::vector<uint32_t> adjacencyOffsets(vertexCount + 1);
+		std::vector<uint32_t> adjacency;
+		std::vector<Collapse> collapses;
+		std::vector<bool> touched(vertexCount);
+		std::vector<uint32_t> remap(vertexCount);
+		double maxError = 0.0;
+
+		while (result.size() > targetIndexCount) {
+			size_t triangleCount = result.size() / 3;
+
+			// triangles around every vertex, rebuilt every pass since collapses change them
+			std::fill(adjacencyOffsets.begin(), adjacencyOffsets.end(), 0);
+			for (uint32_t index : result) {
+				adjacencyOffsets[index + 1]++;
+			}
+			std::partial_sum(adjacencyOffsets.begin(), adjacencyOffsets.end(), adjacencyOffsets.begin());
+			adjacency.resize(result.size());
+			std::vector<uint32_t> cursor(adjacencyOffsets.begin(), adjacencyOffsets.end() - 1);
+			for (size_t i = 0; i < result.size(); i++) {
+				adjacency[cursor[result[i]]++] = static_cast<uint32_t>(i / 3);
+			}
+
+			collapses.clear();
+			for (size_t i = 0; i < result.size(); i += 3) {
+				for (int k = 0; k < 3; k++) {
+					uint32_t a = result[i + k];
+					uint32_t b = result[i + (k + 1) % 3];
+					for (int direction = 0; direction < 2; direction++) {
+						uint32_t from = direction == 0 ? a : b;
+						uint32_t to = direction == 0 ? b : a;
+						if (locked[from]) {
+							continue;
+						}
+						Quadric quadric = quadrics[from];
+						quadric += quadrics[to];
+						collapses.push_back({ from, to, quadric.error(vertices[to].position) });
+					}
+				}
+			}
+			std::sort(collapses.begin(), collapses.end(), [](const Collapse& a, const Collapse& b) {
+				return a.error < b.error;
+			});
+
+			// every collapse removes about two triangles, the budget keeps the pass from overshooting the target
+			size_t targetTriangles = targetIndexCount / 3;
+			size_t collapseBudget = std::max<size_t>(1, (triangleCount - targetTriangles) / 2);
+			size_t collapsed = 0;
+
+			std::fill(touched.begin(), touched.end(), false);
+			std::iota(remap.begin(), remap.end(), 0);
+
+			for (const Collapse& collapse : collapses) {
+				if (collapsed >= collapseBudget || collapse.error > errorLimit) {
+					break;
+				}
+				if (touched[collapse.from] || touched[collapse.to]) {
+					continue;
+				}
+
+				// moving the vertex must not flip any of the triangles that survive the collapse
+				const glm::vec3& target = vertices[collapse.to].position;
+				bool flips = false;
+				for (uint32_t a = adjacencyOffsets[collapse.from]; a < adjacencyOffsets[collapse.from + 1] && !flips; a++) {
+					const uint32_t* triangle = &result[adjacency[a] * 3];
+					if (triangle[0] == collapse.to || triangle[1] == collapse.to || triangle[2] == collapse.to) {
+						continue;
+					}
+					glm::vec3 before[3];
+					glm::vec3 after[3];
+					for (int k = 0; k < 3; k++) {
+						before[k] = vertices[triangle[k]].position;
+						after[k] = triangle[k] == collapse.from ? target : before[k];
+					}
+					flips = glm::dot(triangleNormal(before[0], before[1], before[2]), triangleNormal(after[0], after[1], after[2])) <= 0.f;
+				}
+				if (flips) {
+					continue;
+				}
+
+				// the neighborhood of the collapsed vertex is frozen for the rest of the pass so the flip test stays valid
+				for (uint32_t a = adjacencyOffsets[collapse.from]; a < adjacencyOffsets[collapse.from + 1]; a++) {
+					for (int k = 0; k < 3; k++) {
+						touched[result[adjacency[a] * 3 + k]] = true;
+					}
+				}
+				remap[collapse.from] = collapse.to;
+				quadrics[collapse.to] += quadrics[collapse.from];
+				maxError = std::max(maxError, collapse.error);
+				collapsed++;
+			}
+
+			if (collapsed == 0) {
+				break;
+			}
+
+			size_t write = 0;
+			for (size_t i = 0; i < result.size(); i += 3) {
+				uint32_t a = remap[result[i + 0]];
+				uint32_t b = remap[result[i + 1]];
+				uint32_t c = remap[result[i + 2]];
+				if (a == b || b == c || a == c) {
+					continue;
+				}
+				result[write++] = a;
+				result[write++] = b;
+				result[write++] = c;
+			}
+			result.resize(write);
+		}
+
+		error = static_cast<float>(std::sqrt(maxError) / extent);
+		return result;
+	}
+
+}
@@ -0,0 +1,22 @@
+#pragma once
+
+#include "vk3d_model.hpp"
+
+// std
+#include <cstdint>
+#include <vector>
+
+namespace vk3d {
+	// Quadric error metric edge collapse (Garland and Heckbert 1997). Vertices are only collapsed onto other
+	// existing vertices, so the simplified indices still address the original vertex buffer and a LOD is just
+	// another index range. Vertices on open borders or on attribute seams (several vertices sharing a position)
+	// are never moved, which keeps the silhouette of open meshes and avoids cracks along uv and normal seams.
+	class Vk3dMeshSimplifier {
+	public:
+		// Collapses edges in increasing error order until at most targetIndexCount indices are left or the next
+		// collapse would move the surface further than targetError, relative to the mesh extent. error receives
+		// the largest relative error of the collapses that were applied.
+		static std::vector<uint32_t> simplify(const std::vector<Vk3dModel::Vertex>& vertices, const std::vector<uint32_t>& indices,
+			size_t targetIndexCount, float targetError, float& error);
+	};
+}
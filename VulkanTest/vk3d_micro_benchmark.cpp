@@ -0,0 +1,400 @@
+#include "vk3d_micro_benchmark.hpp"
+
+#include "vk3d_allocator.hpp"
+#include "vk3d_buffer.hpp"
+#include "vk3d_device.hpp"
+#include "vk3d_game_object.hpp"
+#include "vk3d_geometry_pool.hpp"
+#include "vk3d_model.hpp"
+#include "vk3d_transform_kernel.hpp"
+#include "vk3d_upload_batcher.hpp"
+#include "vk3d_utils.hpp"
+#include "vk3d_vertex_table.hpp"
+#include "vk3d_window.hpp"
+
+// libs
+#include <tiny_obj_loader.h>
+#define GLM_ENABLE_EXPERIMENTAL
+#include <glm/gtx/hash.hpp>
+#include <glm/gtc/constants.hpp>
+
+// std
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <functional>
+#include <iomanip>
+#include <iostream>
+#include <random>
+#include <stdexcept>
+#include <thread>
+#include <unordered_map>
+
+namespace vk3d {
+
+	namespace {
+		constexpr int BENCHMARK_REPETITIONS = 3;
+
+		// best of BENCHMARK_REPETITIONS runs, in milliseconds
+		double measure(const std::function<void()>& fn) {
+			double best = 0.0;
+			for (int i = 0; i < BENCHMARK_REPETITIONS; i++) {
+				auto start = std::chrono::high_resolution_clock::now();
+				fn();
+				double time = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+				best = i == 0 ? time : std::min(best, time);
+			}
+			return best;
+		}
+
+		// The hash the model loader used before Vk3dVertexTable, kept as the weld benchmark baseline
+		struct LegacyVertexHash {
+			size_t operator()(const Vk3dModel::Vertex& vertex) const {
+				size_t seed = 0;
+				hashCombine(seed, vertex.position, vertex.color, vertex.normal, vertex.uv);
+				return seed;
+			}
+		};
+
+		// Tracks the bytes held by a container, including its peak
+		struct AllocationCounter {
+			size_t current = 0;
+			size_t peak = 0;
+		};
+
+		template <typename T>
+		struct CountingAllocator {
+			using value_type = T;
+
+			explicit CountingAllocator(AllocationCounter& counter) : counter{ &counter } {}
+			template <typename U>
+			CountingAllocator(const CountingAllocator<U>& other) : counter{ other.counter } {}
+
+			T* allocate(size_t n) {
+				counter->current += n * sizeof(T);
+				counter->peak = std::max(counter->peak, counter->current);
+				return std::allocator<T>{}.allocate(n);
+			}
+			void deallocate(T* p, size_t n) {
+				counter->current -= n * sizeof(T);
+				std::allocator<T>{}.deallocate(p, n);
+			}
+
+			template <typename U>
+			bool operator==(const CountingAllocator<U>& other) const { return counter == other.counter; }
+			template <typename U>
+			bool operator!=(const CountingAllocator<U>& other) const { return counter != other.counter; }
+
+			AllocationCounter* counter;
+		};
+
+		// Grid of quads in the XZ plane, every grid vertex has its own position, color, normal and uv
+		void writeGridObj(const std::string& filepath, uint32_t triangleCount) {
+			uint32_t side = std::max(1u, static_cast<uint32_t>(std::ceil(std::sqrt(triangleCount / 2.0))));
+			uint32_t columns = side + 1;
+
+			std::ofstream file{ filepath };
+			if (!file.is_open()) {
+				throw std::runtime_error("failed to open file: " + filepath);
+			}
+
+			file << std::fixed << std::setprecision(5);
+			for (uint32_t z = 0; z < columns; z++) {
+				for (uint32_t x = 0; x < columns; x++) {
+					float u = static_cast<float>(x) / side;
+					float v = static_cast<float>(z) / side;
+					file << "v " << u << ' ' << std::sin(u * 20.f) * std::cos(v * 20.f) * .1f << ' ' << v << ' ' << u << ' ' << v << " 0.5\n";
+				}
+			}
+			for (uint32_t z = 0; z < columns; z++) {
+				for (uint32_t x = 0; x < columns; x++) {
+					file << "vt " << static_cast<float>(x) / side << ' ' << static_cast<float>(z) / side << '\n';
+				}
+			}
+			file << "vn 0 1 0\n";
+
+			for (uint32_t z = 0; z < side; z++) {
+				for (uint32_t x = 0; x < side; x++) {
+					// obj indices are 1-based
+					uint32_t a = z * columns + x + 1;
+					uint32_t b = a + 1;
+					uint32_t c = a + columns;
+					uint32_t d = c + 1;
+					file << "f " << a << '/' << a << "/1 " << c << '/' << c << "/1 " << b << '/' << b << "/1\n";
+					file << "f " << b << '/' << b << "/1 " << c << '/' << c << "/1 " << d << '/' << d << "/1\n";
+				}
+			}
+		}
+
+		// side x side grid of vertices, offset so every mesh has different data
+		Vk3dModel::Builder makeGridMesh(uint32_t side, float offset) {
+			Vk3dModel::Builder builder{};
+			for (uint32_t z = 0; z < side; z++) {
+				for (uint32_t x = 0; x < side; x++) {
+					Vk3dModel::Vertex vertex{};
+					vertex.position = { static_cast<float>(x) + offset, 0.f, static_cast<float>(z) };
+					vertex.color = { 1.f, 1.f, 1.f, 1.f };
+					vertex.normal = { 0.f, 1.f, 0.f };
+					vertex.uv = { static_cast<float>(x) / side, static_cast<float>(z) / side };
+					builder.vertices.push_back(vertex);
+				}
+			}
+			for (uint32_t z = 0; z + 1 < side; z++) {
+				for (uint32_t x = 0; x + 1 < side; x++) {
+					uint32_t a = z * side + x;
+					uint32_t c = a + side;
+					builder.indices.insert(builder.indices.end(), { a, c, a + 1, a + 1, c, c + 1 });
+				}
+			}
+			return builder;
+		}
+
+		// What Vk3dModel did before the upload batcher: a staging buffer, a device local buffer and a queue wait per array
+		std::unique_ptr<Vk3dBuffer> uploadWithQueueWait(Vk3dDevice& device, Vk3dAllocator& allocator, const void* data, uint32_t instanceSize, uint32_t instanceCount, VkBufferUsageFlags usage) {
+			Vk3dBuffer stagingBuffer{
+				device,
+				instanceSize,
+				instanceCount,
+				VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+				VMA_MEMORY_USAGE_CPU_ONLY,
+				VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+				allocator,
+			};
+			stagingBuffer.map();
+			stagingBuffer.writeToBuffer(const_cast<void*>(data));
+
+			auto buffer = std::make_unique<Vk3dBuffer>(
+				device,
+				instanceSize,
+				instanceCount,
+				usage | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+				VMA_MEMORY_USAGE_GPU_ONLY,
+				VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+				allocator);
+			device.copyBuffer(stagingBuffer.getBuffer(), buffer->getBuffer(), static_cast<VkDeviceSize>(instanceSize) * instanceCount);
+			return buffer;
+		}
+	}
+
+	void runModelImportBenchmark(uint32_t triangleCount) {
+		std::string filepath = (std::filesystem::temp_directory_path() / "vk3d_import_benchmark.obj").string();
+		std::cout << "Generating " << filepath << " with about " << triangleCount << " triangles" << std::endl;
+		writeGridObj(filepath, triangleCount);
+
+		unsigned int threadCount = std::max(1u, std::thread::hardware_concurrency());
+
+		double parseTime = measure([&filepath] {
+			tinyobj::attrib_t attrib;
+			std::vector<tinyobj::shape_t> shapes;
+			std::vector<tinyobj::material_t> materials;
+			std::string warn, err;
+			if (!tinyobj::LoadObj(&attrib, &shapes, &materials, &warn, &err, filepath.c_str())) {
+				throw std::runtime_error(warn + err);
+			}
+		});
+
+		Vk3dModel::Builder serial{};
+		Vk3dModel::Builder parallel{};
+		double serialTime = measure([&] { serial.loadModel(filepath, 1); });
+		double parallelTime = measure([&] { parallel.loadModel(filepath, threadCount); });
+
+		std::remove(filepath.c_str());
+
+		bool identical = serial.vertices.size() == parallel.vertices.size()
+			&& serial.indices == parallel.indices
+			&& std::memcmp(serial.vertices.data(), parallel.vertices.data(), serial.vertices.size() * sizeof(Vk3dModel::Vertex)) == 0;
+
+		// welding time is what is left once the parse is subtracted
+		double serialWeld = serialTime - parseTime;
+		double parallelWeld = parallelTime - parseTime;
+
+		std::cout << std::fixed << std::setprecision(2)
+			<< "Indices: " << serial.indices.size() << ", unique vertices: " << serial.vertices.size() << std::endl
+			<< "OBJ parse:              " << parseTime << " ms" << std::endl
+			<< "Serial import:          " << serialTime << " ms (weld " << serialWeld << " ms)" << std::endl
+			<< "Parallel import (" << threadCount << " threads): " << parallelTime << " ms (weld " << parallelWeld << " ms)" << std::endl
+			<< "Weld speedup: " << (parallelWeld > 0.0 ? serialWeld / parallelWeld : 0.0) << "x" << std::endl
+			<< "Output " << (identical ? "is byte-identical" : "DIFFERS") << " between serial and parallel import" << std::endl;
+
+		if (!identical) {
+			throw std::runtime_error("parallel import does not match the serial import!");
+		}
+	}
+
+	void runVertexWeldBenchmark(uint32_t vertexCount) {
+		// every unique vertex is referenced by about six triangle corners, in a shuffled order
+		constexpr uint32_t REFERENCES_PER_VERTEX = 6;
+
+		std::mt19937 random{ 42 };
+		std::uniform_real_distribution<float> distribution{ -1.f, 1.f };
+		std::vector<Vk3dModel::Vertex> unique(vertexCount);
+		for (auto& vertex : unique) {
+			vertex.position = { distribution(random), distribution(random), distribution(random) };
+			vertex.color = { distribution(random), distribution(random), distribution(random), 1.f };
+			vertex.normal = { distribution(random), distribution(random), distribution(random) };
+			vertex.uv = { distribution(random), distribution(random) };
+		}
+		std::vector<Vk3dModel::Vertex> stream;
+		stream.reserve(static_cast<size_t>(vertexCount) * REFERENCES_PER_VERTEX);
+		for (uint32_t i = 0; i < REFERENCES_PER_VERTEX; i++) {
+			stream.insert(stream.end(), unique.begin(), unique.end());
+		}
+		std::shuffle(stream.begin(), stream.end(), random);
+		std::cout << "Welding " << stream.size() << " vertices into " << vertexCount << " unique ones" << std::endl;
+
+		std::vector<Vk3dModel::Vertex> mapVertices;
+		std::vector<uint32_t> mapIndices(stream.size());
+		size_t mapPeakMemory = 0;
+		double mapTime = measure([&] {
+			AllocationCounter counter{};
+			std::unordered_map<Vk3dModel::Vertex, uint32_t, LegacyVertexHash, std::equal_to<Vk3dModel::Vertex>,
+				CountingAllocator<std::pair<const Vk3dModel::Vertex, uint32_t>>> uniqueVertices{
+				0, LegacyVertexHash{}, std::equal_to<Vk3dModel::Vertex>{}, CountingAllocator<std::pair<const Vk3dModel::Vertex, uint32_t>>{ counter } };
+			mapVertices.clear();
+			for (size_t i = 0; i < stream.size(); i++) {
+				const Vk3dModel::Vertex& vertex = stream[i];
+				if (uniqueVertices.count(vertex) == 0) {
+					uniqueVertices[vertex] = static_cast<uint32_t>(mapVertices.size());
+					mapVertices.push_back(vertex);
+				}
+				mapIndices[i] = uniqueVertices[vertex];
+			}
+			mapPeakMemory = counter.peak;
+		});
+
+		std::vector<Vk3dModel::Vertex> tableVertices;
+		std::vector<uint32_t> tableIndices(stream.size());
+		size_t tablePeakMemory = 0;
+		double tableTime = measure([&] {
+			tableVertices.clear();
+			// sized like the model loader does, from the index count
+			Vk3dVertexTable uniqueVertices{ tableVertices, stream.size() / REFERENCES_PER_VERTEX };
+			for (size_t i = 0; i < stream.size(); i++) {
+				tableIndices[i] = uniqueVertices.findOrInsert(stream[i]);
+			}
+			tablePeakMemory = uniqueVertices.getMemorySize();
+		});
+
+		bool identical = mapIndices == tableIndices && mapVertices.size() == tableVertices.size()
+			&& std::memcmp(mapVertices.data(), tableVertices.data(), mapVertices.size() * sizeof(Vk3dModel::Vertex)) == 0;
+
+		// the output vertex array is the same for both, only the lookup structure is compared
+		std::cout << std::fixed << std::setprecision(2)
+			<< "std::unordered_map: " << mapTime << " ms, peak " << mapPeakMemory / (1024.0 * 1024.0) << " MiB" << std::endl
+			<< "Vk3dVertexTable:    " << tableTime << " ms, peak " << tablePeakMemory / (1024.0 * 1024.0) << " MiB" << std::endl
+			<< "Speedup: " << (tableTime > 0.0 ? mapTime / tableTime : 0.0) << "x, peak memory "
+			<< (mapPeakMemory > 0 ? 100.0 * tablePeakMemory / mapPeakMemory : 0.0) << "% of the map" << std::endl
+			<< "Output " << (identical ? "is identical" : "DIFFERS") << " between both tables" << std::endl;
+
+		if (!identical) {
+			throw std::runtime_error("vertex table does not match std::unordered_map!");
+		}
+	}
+
+	void runModelUploadBenchmark(uint32_t meshCount) {
+		constexpr uint32_t GRID_SIDE = 32;
+
+		std::vector<Vk3dModel::Builder> meshes;
+		for (uint32_t i = 0; i < meshCount; i++) {
+			meshes.push_back(makeGridMesh(GRID_SIDE, static_cast<float>(i)));
+		}
+		VkDeviceSize meshSize = meshes[0].vertices.size() * sizeof(Vk3dModel::Vertex) + meshes[0].indices.size() * sizeof(uint32_t);
+		std::cout << "Uploading " << meshCount << " meshes of " << meshes[0].vertices.size() << " vertices, "
+			<< meshCount * meshSize / (1024.0 * 1024.0) << " MiB in total" << std::endl;
+
+		Vk3dWindow window{ 1, 1, "Vulkan3d upload benchmark", true };
+		Vk3dDevice device{ window };
+		Vk3dAllocator allocator{ device };
+
+		double queueWaitTime = measure([&] {
+			std::vector<std::unique_ptr<Vk3dBuffer>> buffers;
+			for (const auto& mesh : meshes) {
+				buffers.push_back(uploadWithQueueWait(device, allocator, mesh.vertices.data(), sizeof(Vk3dModel::Vertex),
+					static_cast<uint32_t>(mesh.vertices.size()), VK_BUFFER_USAGE_VERTEX_BUFFER_BIT));
+				buffers.push_back(uploadWithQueueWait(device, allocator, mesh.indices.data(), sizeof(uint32_t),
+					static_cast<uint32_t>(mesh.indices.size()), VK_BUFFER_USAGE_INDEX_BUFFER_BIT));
+			}
+		});
+
+		Vk3dUploadBatcher uploadBatcher{ device, allocator };
+		Vk3dGeometryPool geometryPool{ device, allocator, uploadBatcher, Vk3dModel::VertexFormat::Standard, false };
+		uint32_t submitCount = 0;
+		double batchedTime = measure([&] {
+			uint32_t firstSubmit = uploadBatcher.getSubmitCount();
+			std::vector<std::unique_ptr<Vk3dModel>> models;
+			for (const auto& mesh : meshes) {
+				models.push_back(std::make_unique<Vk3dModel>(device, mesh, geometryPool));
+			}
+			uploadBatcher.finish();
+			submitCount = uploadBatcher.getSubmitCount() - firstSubmit;
+		});
+
+		std::cout << std::fixed << std::setprecision(2)
+			<< "Queue wait per buffer: " << queueWaitTime << " ms, " << 2 * meshCount << " submissions" << std::endl
+			<< "Upload batcher:        " << batchedTime << " ms, " << submitCount << " submissions through a "
+			<< uploadBatcher.getRingSize() / (1024 * 1024) << " MiB staging ring" << std::endl
+			<< "Speedup: " << (batchedTime > 0.0 ? queueWaitTime / batchedTime : 0.0) << "x" << std::endl;
+	}
+
+	void runTransformBenchmark(uint32_t objectCount) {
+		constexpr float MAX_ERROR = 1e-5f;
+
+		std::mt19937 random{ 42 };
+		std::uniform_real_distribution<float> position{ -100.f, 100.f };
+		std::uniform_real_distribution<float> angle{ -glm::two_pi<float>(), glm::two_pi<float>() };
+		// scales stay away from zero, the normal matrix divides by them
+		std::uniform_real_distribution<float> scale{ .25f, 4.f };
+		std::vector<glm::vec3> translations(objectCount);
+		std::vector<glm::vec3> rotations(objectCount);
+		std::vector<glm::vec3> scales(objectCount);
+		for (uint32_t i = 0; i < objectCount; i++) {
+			translations[i] = { position(random), position(random), position(random) };
+			rotations[i] = { angle(random), angle(random), angle(random) };
+			scales[i] = { scale(random), scale(random), scale(random) };
+		}
+
+		std::vector<glm::mat4> scalarWorld(objectCount);
+		std::vector<glm::mat3> scalarNormal(objectCount);
+		double scalarTime = measure([&] {
+			for (uint32_t i = 0; i < objectCount; i++) {
+				TransformComponent transform{ translations[i], scales[i], rotations[i] };
+				scalarWorld[i] = transform.mat4();
+				scalarNormal[i] = transform.normalMatrix();
+			}
+		});
+
+		std::vector<glm::mat4> kernelWorld(objectCount);
+		std::vector<glm::mat3> kernelNormal(objectCount);
+		double kernelTime = measure([&] {
+			Vk3dTransformKernel::computeMatrices(translations.data(), rotations.data(), scales.data(), nullptr, objectCount, kernelWorld.data(), kernelNormal.data());
+		});
+
+		// relative to the scale of the column, the rotation part is at most 1
+		float maxError = 0.f;
+		for (uint32_t i = 0; i < objectCount; i++) {
+			for (int column = 0; column < 3; column++) {
+				for (int row = 0; row < 3; row++) {
+					maxError = std::max(maxError, std::abs(kernelWorld[i][column][row] - scalarWorld[i][column][row]) / scales[i][column]);
+					maxError = std::max(maxError, std::abs(kernelNormal[i][column][row] - scalarNormal[i][column][row]) * scales[i][column]);
+				}
+			}
+			maxError = std::max(maxError, glm::length(glm::vec4{ kernelWorld[i][3] - scalarWorld[i][3] }));
+		}
+
+		std::cout << std::fixed << std::setprecision(2)
+			<< "Objects: " << objectCount << std::endl
+			<< "TransformComponent:  " << scalarTime << " ms" << std::endl
+			<< "Transform kernel (" << Vk3dTransformKernel::getInstructionSet() << "): " << kernelTime << " ms" << std::endl
+			<< "Speedup: " << (kernelTime > 0.0 ? scalarTime / kernelTime : 0.0) << "x" << std::endl
+			<< std::scientific << "Largest difference: " << maxError << std::defaultfloat << std::endl;
+
+		if (maxError > MAX_ERROR) {
+			throw std::runtime_error("transform kernel does not match TransformComponent!");
+		}
+	}
+
+}
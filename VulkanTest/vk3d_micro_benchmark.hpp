@@ -0,0 +1,23 @@
+#pragma once
+
+// std
+#include <cstdint>
+
+namespace vk3d {
+	// Benchmarks of single code paths run from the command line with --bench-*, without creating the app
+
+	// Writes a grid OBJ with about triangleCount triangles and compares the serial and the parallel import
+	void runModelImportBenchmark(uint32_t triangleCount);
+
+	// Welds vertexCount random vertices, each repeated six times in a shuffled stream, with the former
+	// std::unordered_map and with Vk3dVertexTable, reporting the time and the peak memory of both
+	void runVertexWeldBenchmark(uint32_t vertexCount);
+
+	// Uploads meshCount small meshes with a queue wait per buffer, as models used to, and through the geometry pool
+	// and the upload batcher. Creates a headless device.
+	void runModelUploadBenchmark(uint32_t meshCount);
+
+	// Builds the world and normal matrices of objectCount random transforms with TransformComponent and with
+	// Vk3dTransformKernel, checking that both agree
+	void runTransformBenchmark(uint32_t objectCount);
+}
@@ -1,131 +1,272 @@
 #include "vk_mem_alloc.h"
 
 #include "vk3d_model.hpp"
-
-#include "vk3d_utils.hpp"
+#include "vk3d_geometry_pool.hpp"
+#include "vk3d_mesh_cache.hpp"
+#include "vk3d_mesh_optimizer.hpp"
+#include "vk3d_mesh_simplifier.hpp"
+#include "vk3d_profiler.hpp"
+#include "vk3d_vertex_table.hpp"
 
 //libs
 #define TINYOBJLOADER_IMPLEMENTATION
 #include <tiny_obj_loader.h>
-#define GLM_ENABLE_EXPERIMENTAL
-#include <glm/gtx/hash.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+#include <glm/gtc/packing.hpp>
 
 // std
+#include <algorithm>
 #include <cassert>
+#include <cmath>
 #include <cstring>
+#include <iomanip>
 #include <iostream>
-#include <unordered_map>
+#include <limits>
+#include <thread>
+
+namespace vk3d {
+	static_assert(sizeof(Vk3dModel::CompactVertex) == 24, "CompactVertex must stay tightly packed");
+	static_assert(sizeof(Vk3dModel::QuantizedVertex) == 20, "QuantizedVertex must stay tightly packed");
+	static_assert(offsetof(Vk3dModel::Vertex, position) == 0 && offsetof(Vk3dModel::CompactVertex, position) == 0
+		&& offsetof(Vk3dModel::QuantizedVertex, position) == 0, "The position stream is copied from the start of every vertex");
 
-namespace std {
-	template <>
-	struct hash<vk3d::Vk3dModel::Vertex> {
-		size_t operator()(vk3d::Vk3dModel::Vertex const &vertex) const {
-			size_t seed = 0;
-			vk3d::hashCombine(seed, vertex.position, vertex.color, vertex.normal, vertex.uv);
-			return seed;
+	namespace {
+		// Keeps flat models (a quad has no extent along its normal) from dividing by zero when quantizing
+		constexpr float MIN_QUANTIZATION_EXTENT = 1e-6f;
+
+		float signNotZero(float v) {
+			return v >= 0.f ? 1.f : -1.f;
 		}
-	};
-}
 
-namespace vk3d {
-	Vk3dModel::Vk3dModel(Vk3dDevice& device, const Vk3dModel::Builder& builder, Vk3dAllocator& allocator) : vk3dDevice (device), vk3dAllocator (allocator){
-		createVertexBuffers(builder.vertices);
-		createIndexBuffers(builder.indices);
+		// Projects the normal onto the octahedron |x| + |y| + |z| = 1 and unfolds it into [-1, 1]^2
+		uint32_t packOctahedralNormal(glm::vec3 normal) {
+			float length = std::abs(normal.x) + std::abs(normal.y) + std::abs(normal.z);
+			if (length == 0.f) {
+				return glm::packSnorm2x16(glm::vec2{ 0.f });
+			}
+			normal /= length;
+
+			glm::vec2 encoded{ normal.x, normal.y };
+			if (normal.z < 0.f) {
+				encoded = {
+					(1.f - std::abs(normal.y)) * signNotZero(normal.x),
+					(1.f - std::abs(normal.x)) * signNotZero(normal.y) };
+			}
+			return glm::packSnorm2x16(encoded);
+		}
+
+		template <typename CompactVertexT>
+		void packAttributes(const Vk3dModel::Vertex& vertex, CompactVertexT& compact) {
+			compact.color = glm::packUnorm4x8(vertex.color);
+			compact.normal = packOctahedralNormal(vertex.normal);
+			compact.uv = glm::packHalf2x16(vertex.uv);
+		}
+	}
+
+	Vk3dModel::Vk3dModel(Vk3dDevice& device, const Vk3dModel::Builder& builder, Vk3dGeometryPool& geometryPool) : vk3dDevice (device), vk3dGeometryPool (geometryPool) {
+		createVertexBuffers(builder.vertices.data(), static_cast<uint32_t>(builder.vertices.size()), geometryPool.getVertexFormat());
+		createIndexBuffers(builder.indices.data(), static_cast<uint32_t>(builder.indices.size()));
+		createLods(builder.lods.data(), static_cast<uint32_t>(builder.lods.size()));
+	}
+
+	Vk3dModel::Vk3dModel(Vk3dDevice& device, const Vk3dMeshCache& meshCache, Vk3dGeometryPool& geometryPool) : vk3dDevice(device), vk3dGeometryPool(geometryPool) {
+		// vertices and indices are read from the mapped cache file, no intermediate copy is made for the standard format
+		createVertexBuffers(meshCache.getVertices(), meshCache.getHeader().vertexCount, geometryPool.getVertexFormat());
+		createIndexBuffers(meshCache.getIndices(), meshCache.getHeader().indexCount);
+		createLods(meshCache.getLods(), meshCache.getHeader().lodCount);
 	}
 	Vk3dModel::~Vk3dModel() {
+		if (vertexCount > 0) {
+			vk3dGeometryPool.freeVertices(firstVertex, vertexCount);
+		}
+		if (hasIndexBuffer) {
+			vk3dGeometryPool.freeIndices(firstIndex, indexCount);
+		}
 	}
 
-	std::unique_ptr<Vk3dModel> Vk3dModel::createModelFromFile(Vk3dDevice& device, const std::string& filepath, Vk3dAllocator& allocator) {
-		Builder builder{};
-		builder.loadModel(filepath);
-		return std::make_unique<Vk3dModel>(device, builder, allocator);
+	Vk3dModel::Source::Source() = default;
+	Vk3dModel::Source::Source(Source&&) = default;
+	Vk3dModel::Source& Vk3dModel::Source::operator=(Source&&) = default;
+	Vk3dModel::Source::~Source() = default;
+
+	std::unique_ptr<Vk3dModel> Vk3dModel::createModelFromFile(Vk3dDevice& device, const std::string& filepath, Vk3dGeometryPool& geometryPool) {
+		VK3D_PROFILE_ZONE("Vk3dModel::createModelFromFile");
+		Source source = importFile(filepath);
+		printImportStatistics(filepath, source);
+		return createModel(device, source, geometryPool);
 	}
 
+	Vk3dModel::Source Vk3dModel::importFile(const std::string& filepath) {
+		VK3D_PROFILE_ZONE("Vk3dModel::importFile");
+		uint64_t sourceHash = Vk3dMeshCache::hashFile(filepath);
+		std::string cachePath = Vk3dMeshCache::getCachePath(filepath);
 
-	void Vk3dModel::createVertexBuffers(const std::vector<Vertex>& vertices) {
-		vertexCount = static_cast<uint32_t>(vertices.size());
-		assert(vertexCount >= 3 && "Vertex count must be at least 3");
-		VkDeviceSize bufferSize = sizeof(vertices[0]) * vertexCount;
-		uint32_t vertexSize = sizeof(vertices[0]);
-
-		Vk3dBuffer stagingBuffer{
-			vk3dDevice,
-			vertexSize,
-			vertexCount,
-			VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
-			VMA_MEMORY_USAGE_CPU_ONLY,
-			VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
-			vk3dAllocator,
-		};
+		Source source{};
+		source.sourceHash = sourceHash;
+		source.meshCache = std::make_unique<Vk3dMeshCache>(cachePath, sourceHash);
+		if (source.meshCache->isValid()) {
+			return source;
+		}
+		source.meshCache.reset();
 
-		stagingBuffer.map();
-		stagingBuffer.writeToBuffer((void *)vertices.data());
+		Builder& builder = source.builder;
+		builder.loadModel(filepath);
 
-		vertexBuffer = std::make_unique<Vk3dBuffer>(
-			vk3dDevice,
-			vertexSize,
-			vertexCount,
-			VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
-			VMA_MEMORY_USAGE_GPU_ONLY,
-			VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
-			vk3dAllocator);
+		// optimized once here, the cache keeps the optimized order
+		auto before = Vk3dMeshOptimizer::analyzeVertexCache(builder.indices, builder.vertices.size());
+		Vk3dMeshOptimizer::optimize(builder.vertices, builder.indices);
+		auto after = Vk3dMeshOptimizer::analyzeVertexCache(builder.indices, builder.vertices.size());
+		source.acmrBefore = before.acmr;
+		source.acmrAfter = after.acmr;
+		source.atvrBefore = before.atvr;
+		source.atvrAfter = after.atvr;
 
-		vk3dDevice.copyBuffer(stagingBuffer.getBuffer(), vertexBuffer->getBuffer(), bufferSize);
-	}
+		builder.generateLods();
 
-	void Vk3dModel::createIndexBuffers(const std::vector<uint32_t>& indices) {
-		indexCount = static_cast<uint32_t>(indices.size());
-		hasIndexBuffer = indexCount > 0;
+		Vk3dMeshCache::write(cachePath, builder, sourceHash);
+		return source;
+	}
 
-		if (!hasIndexBuffer) {
+	void Vk3dModel::printImportStatistics(const std::string& filepath, const Source& source) {
+		if (source.meshCache) {
 			return;
 		}
+		std::cout << std::fixed << std::setprecision(3) << filepath << ": ACMR " << source.acmrBefore << " -> " << source.acmrAfter
+			<< ", ATVR " << source.atvrBefore << " -> " << source.atvrAfter << std::defaultfloat << std::endl;
 
-		VkDeviceSize bufferSize = sizeof(indices[0]) * indexCount;
-		uint32_t indexSize = sizeof(indices[0]);
+		const auto& lods = source.builder.lods;
+		for (size_t lod = 1; lod < lods.size(); lod++) {
+			std::cout << filepath << ": LOD " << lod << " " << lods[lod].indexCount / 3 << " triangles, error " << lods[lod].error << std::endl;
+		}
+	}
 
-		Vk3dBuffer stagingBuffer{
-			vk3dDevice,
-			indexSize,
-			indexCount,
-			VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
-			VMA_MEMORY_USAGE_CPU_ONLY,
-			VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
-			vk3dAllocator,
-		};
+	std::unique_ptr<Vk3dModel> Vk3dModel::createModel(Vk3dDevice& device, const Source& source, Vk3dGeometryPool& geometryPool) {
+		std::unique_ptr<Vk3dModel> model = source.meshCache
+			? std::make_unique<Vk3dModel>(device, *source.meshCache, geometryPool)
+			: std::make_unique<Vk3dModel>(device, source.builder, geometryPool);
+		model->sourceHash = source.sourceHash;
+		return model;
+	}
 
-		stagingBuffer.map();
-		stagingBuffer.writeToBuffer((void *)indices.data());
+	void Vk3dModel::createVertexBuffers(const Vertex* vertices, uint32_t vertexCount, VertexFormat vertexFormat) {
+		glm::vec3 boundsMin{ std::numeric_limits<float>::max() };
+		glm::vec3 boundsMax{ std::numeric_limits<float>::lowest() };
+		for (uint32_t i = 0; i < vertexCount; i++) {
+			boundsMin = glm::min(boundsMin, vertices[i].position);
+			boundsMax = glm::max(boundsMax, vertices[i].position);
+		}
 
-		indexBuffer = std::make_unique<Vk3dBuffer>(
-			vk3dDevice,
-			indexSize,
-			indexCount,
-			VK_BUFFER_USAGE_INDEX_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
-			VMA_MEMORY_USAGE_GPU_ONLY,
-			VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
-			vk3dAllocator);
+		bounds = { boundsMin, boundsMax };
+		boundingCenter = (boundsMin + boundsMax) * .5f;
+		boundingRadius = 0.f;
+		for (uint32_t i = 0; i < vertexCount; i++) {
+			boundingRadius = std::max(boundingRadius, glm::length(vertices[i].position - boundingCenter));
+		}
 
-		vk3dDevice.copyBuffer(stagingBuffer.getBuffer(), indexBuffer->getBuffer(), bufferSize);
+		switch (vertexFormat) {
+		case VertexFormat::Compact: {
+			std::vector<CompactVertex> compactVertices(vertexCount);
+			for (uint32_t i = 0; i < vertexCount; i++) {
+				compactVertices[i].position = vertices[i].position;
+				packAttributes(vertices[i], compactVertices[i]);
+			}
+			uploadVertexBuffer(compactVertices.data(), sizeof(CompactVertex), vertexCount);
+			break;
+		}
+		case VertexFormat::Quantized: {
+			// positions are stored in [-1, 1] relative to the bounds, the GPU dequantizes them through positionTransform
+			glm::vec3 center = (boundsMin + boundsMax) * .5f;
+			glm::vec3 halfExtent = glm::max((boundsMax - boundsMin) * .5f, glm::vec3{ MIN_QUANTIZATION_EXTENT });
+			positionTransform = glm::scale(glm::translate(glm::mat4{ 1.f }, center), halfExtent);
+
+			std::vector<QuantizedVertex> quantizedVertices(vertexCount);
+			for (uint32_t i = 0; i < vertexCount; i++) {
+				uint64_t position = glm::packSnorm4x16(glm::vec4{ (vertices[i].position - center) / halfExtent, 0.f });
+				std::memcpy(quantizedVertices[i].position, &position, sizeof(position));
+				packAttributes(vertices[i], quantizedVertices[i]);
+			}
+			uploadVertexBuffer(quantizedVertices.data(), sizeof(QuantizedVertex), vertexCount);
+			break;
+		}
+		default:
+			uploadVertexBuffer(vertices, sizeof(Vertex), vertexCount);
+			break;
+		}
 	}
 
-	void Vk3dModel::bind(VkCommandBuffer commandBuffer) {
-		VkBuffer buffers[] = {vertexBuffer->getBuffer()};
-		VkDeviceSize offsets[] = {0};
-		vkCmdBindVertexBuffers(commandBuffer, 0, 1, buffers, offsets);
+	void Vk3dModel::uploadVertexBuffer(const void* vertices, uint32_t vertexSize, uint32_t vertexCount) {
+		assert(vertexCount >= 3 && "Vertex count must be at least 3");
+		assert(vertexSize == vk3dGeometryPool.getVertexSize() && "Vertex size must match the geometry pool format");
+		firstVertex = vk3dGeometryPool.allocateVertices(vertexCount);
+		this->vertexCount = vertexCount;
+		vertexBufferSize = static_cast<VkDeviceSize>(vertexSize) * vertexCount;
+
+		vk3dGeometryPool.uploadVertices(firstVertex, vertices, vertexCount);
+		if (vk3dGeometryPool.hasPositionStream()) {
+			uploadPositionStream(vertices, vertexSize, vertexCount);
+		}
+	}
 
-		if (hasIndexBuffer) {
-			vkCmdBindIndexBuffer(commandBuffer, indexBuffer->getBuffer(), 0, VK_INDEX_TYPE_UINT32);
+	void Vk3dModel::uploadPositionStream(const void* vertices, uint32_t vertexSize, uint32_t vertexCount) {
+		uint32_t positionSize = vk3dGeometryPool.getPositionSize();
+		positionBufferSize = static_cast<VkDeviceSize>(positionSize) * vertexCount;
+
+		std::vector<uint8_t> positions(positionBufferSize);
+		const uint8_t* vertex = static_cast<const uint8_t*>(vertices);
+		for (uint32_t i = 0; i < vertexCount; i++) {
+			std::memcpy(&positions[static_cast<size_t>(i) * positionSize], vertex + static_cast<size_t>(i) * vertexSize, positionSize);
+		}
+		vk3dGeometryPool.uploadPositions(firstVertex, positions.data(), vertexCount);
+	}
+
+	void Vk3dModel::createIndexBuffers(const uint32_t* indices, uint32_t indexCount) {
+		if (indexCount == 0) {
+			return;
 		}
+
+		firstIndex = vk3dGeometryPool.allocateIndices(indexCount);
+		this->indexCount = indexCount;
+		hasIndexBuffer = true;
+
+		vk3dGeometryPool.uploadIndices(firstIndex, indices, indexCount);
 	}
 
-	void Vk3dModel::draw(VkCommandBuffer commandBuffer) {
+	void Vk3dModel::createLods(const Lod* lods, uint32_t lodCount) {
+		if (lodCount == 0) {
+			this->lods = { Lod{ 0, indexCount, 0.f } };
+			return;
+		}
+		assert(lodCount <= MAX_LODS && "Too many LODs");
+		this->lods.assign(lods, lods + lodCount);
+	}
+
+	void Vk3dModel::draw(VkCommandBuffer commandBuffer, uint32_t lod, uint32_t instanceCount, uint32_t firstInstance) const {
 		if (hasIndexBuffer) {
-			vkCmdDrawIndexed(commandBuffer, indexCount, 1, 0, 0, 0);
+			VkDrawIndexedIndirectCommand command = getDrawCommand(lod, firstInstance);
+			vkCmdDrawIndexed(commandBuffer, command.indexCount, instanceCount, command.firstIndex, command.vertexOffset, command.firstInstance);
 		}
 		else {
-			vkCmdDraw(commandBuffer, vertexCount, 1, 0, 0);
+			vkCmdDraw(commandBuffer, vertexCount, instanceCount, firstVertex, firstInstance);
+		}
+	}
+
+	VkDrawIndexedIndirectCommand Vk3dModel::getDrawCommand(uint32_t lod, uint32_t firstInstance) const {
+		assert(hasIndexBuffer && "Only indexed models have an indexed draw command");
+		const Lod& range = lods[std::min(lod, getLodCount() - 1)];
+		VkDrawIndexedIndirectCommand command{};
+		command.indexCount = range.indexCount;
+		command.instanceCount = 1;
+		command.firstIndex = firstIndex + range.firstIndex;
+		command.vertexOffset = static_cast<int32_t>(firstVertex);
+		command.firstInstance = firstInstance;
+		return command;
+	}
+
+	uint32_t Vk3dModel::getTriangleCount(uint32_t lod) const {
+		if (hasIndexBuffer) {
+			return lods[std::min(lod, getLodCount() - 1)].indexCount / 3;
 		}
+		return vertexCount / 3;
 	}
 
 	std::vector<VkVertexInputBindingDescription> Vk3dModel::Vertex::getBindingDescriptions() {
@@ -147,62 +288,267 @@ namespace vk3d {
 		return attributeDescriptions;
 	}
 
-	void Vk3dModel::Builder::loadModel(const std::string &filepath) {
+	std::vector<VkVertexInputBindingDescription> Vk3dModel::CompactVertex::getBindingDescriptions() {
+		std::vector<VkVertexInputBindingDescription> bindingDescriptions(1);
+		bindingDescriptions[0].binding = 0;
+		bindingDescriptions[0].stride = sizeof(CompactVertex);
+		bindingDescriptions[0].inputRate = VK_VERTEX_INPUT_RATE_VERTEX;
+		return bindingDescriptions;
+	}
+
+	std::vector<VkVertexInputAttributeDescription> Vk3dModel::CompactVertex::getAttributeDescriptions() {
+		std::vector<VkVertexInputAttributeDescription> attributeDescriptions{};
+
+		attributeDescriptions.push_back({0, 0, VK_FORMAT_R32G32B32_SFLOAT, offsetof(CompactVertex, position) });
+		attributeDescriptions.push_back({1, 0, VK_FORMAT_R8G8B8A8_UNORM, offsetof(CompactVertex, color) });
+		attributeDescriptions.push_back({2, 0, VK_FORMAT_R16G16_SNORM, offsetof(CompactVertex, normal) });
+		attributeDescriptions.push_back({3, 0, VK_FORMAT_R16G16_SFLOAT, offsetof(CompactVertex, uv) });
+
+		return attributeDescriptions;
+	}
+
+	std::vector<VkVertexInputBindingDescription> Vk3dModel::QuantizedVertex::getBindingDescriptions() {
+		std::vector<VkVertexInputBindingDescription> bindingDescriptions(1);
+		bindingDescriptions[0].binding = 0;
+		bindingDescriptions[0].stride = sizeof(QuantizedVertex);
+		bindingDescriptions[0].inputRate = VK_VERTEX_INPUT_RATE_VERTEX;
+		return bindingDescriptions;
+	}
+
+	std::vector<VkVertexInputAttributeDescription> Vk3dModel::QuantizedVertex::getAttributeDescriptions() {
+		std::vector<VkVertexInputAttributeDescription> attributeDescriptions{};
+
+		// 3 component 16 bit formats are not guaranteed as vertex input, the fourth one is padding
+		attributeDescriptions.push_back({0, 0, VK_FORMAT_R16G16B16A16_SNORM, offsetof(QuantizedVertex, position) });
+		attributeDescriptions.push_back({1, 0, VK_FORMAT_R8G8B8A8_UNORM, offsetof(QuantizedVertex, color) });
+		attributeDescriptions.push_back({2, 0, VK_FORMAT_R16G16_SNORM, offsetof(QuantizedVertex, normal) });
+		attributeDescriptions.push_back({3, 0, VK_FORMAT_R16G16_SFLOAT, offsetof(QuantizedVertex, uv) });
+
+		return attributeDescriptions;
+	}
+
+	std::vector<VkVertexInputBindingDescription> Vk3dModel::getBindingDescriptions(VertexFormat vertexFormat) {
+		switch (vertexFormat) {
+		case VertexFormat::Compact:
+			return CompactVertex::getBindingDescriptions();
+		case VertexFormat::Quantized:
+			return QuantizedVertex::getBindingDescriptions();
+		default:
+			return Vertex::getBindingDescriptions();
+		}
+	}
+
+	std::vector<VkVertexInputAttributeDescription> Vk3dModel::getAttributeDescriptions(VertexFormat vertexFormat) {
+		switch (vertexFormat) {
+		case VertexFormat::Compact:
+			return CompactVertex::getAttributeDescriptions();
+		case VertexFormat::Quantized:
+			return QuantizedVertex::getAttributeDescriptions();
+		default:
+			return Vertex::getAttributeDescriptions();
+		}
+	}
+
+	uint32_t Vk3dModel::getPositionSize(VertexFormat vertexFormat) {
+		return vertexFormat == VertexFormat::Quantized ? sizeof(QuantizedVertex::position) : sizeof(glm::vec3);
+	}
+
+	std::vector<VkVertexInputBindingDescription> Vk3dModel::getPositionBindingDescriptions(VertexFormat vertexFormat) {
+		std::vector<VkVertexInputBindingDescription> bindingDescriptions(1);
+		bindingDescriptions[0].binding = 0;
+		bindingDescriptions[0].stride = getPositionSize(vertexFormat);
+		bindingDescriptions[0].inputRate = VK_VERTEX_INPUT_RATE_VERTEX;
+		return bindingDescriptions;
+	}
+
+	std::vector<VkVertexInputAttributeDescription> Vk3dModel::getPositionAttributeDescriptions(VertexFormat vertexFormat) {
+		// the same format as location 0 of the full vertex, the shaders read it the same way
+		return { getAttributeDescriptions(vertexFormat)[0] };
+	}
+
+	namespace {
+		// Closed smooth meshes share every vertex between about six triangle corners, used to size the weld tables
+		constexpr size_t EXPECTED_INDICES_PER_VERTEX = 6;
+
+		Vk3dModel::Vertex makeVertex(const tinyobj::attrib_t& attrib, const tinyobj::index_t& index) {
+			Vk3dModel::Vertex vertex{};
+			if (index.vertex_index >= 0) {
+				vertex.position = {
+					attrib.vertices[3 * index.vertex_index + 0],
+					attrib.vertices[3 * index.vertex_index + 1],
+					attrib.vertices[3 * index.vertex_index + 2],
+				};
+
+				vertex.color = {
+					attrib.colors[3 * index.vertex_index + 0],
+					attrib.colors[3 * index.vertex_index + 1],
+					attrib.colors[3 * index.vertex_index + 2],
+					1.0f
+				};
+			}
+
+			if (index.normal_index >= 0) {
+				vertex.normal = {
+					attrib.normals[3 * index.normal_index + 0],
+					attrib.normals[3 * index.normal_index + 1],
+					attrib.normals[3 * index.normal_index + 2],
+				};
+			}
+
+			if (index.texcoord_index >= 0) {
+				vertex.uv = {
+					attrib.texcoords[2 * index.texcoord_index + 0],
+					attrib.texcoords[2 * index.texcoord_index + 1],
+				};
+			}
+
+			Vk3dVertexTable::canonicalize(vertex);
+			return vertex;
+		}
+
+		// Calls fn for the indices [begin, end) of all shapes as if they were a single array
+		template <typename Fn>
+		void forEachIndex(const std::vector<tinyobj::shape_t>& shapes, const std::vector<size_t>& shapeOffsets, size_t begin, size_t end, Fn&& fn) {
+			size_t shape = std::upper_bound(shapeOffsets.begin(), shapeOffsets.end(), begin) - shapeOffsets.begin() - 1;
+			for (size_t i = begin; i < end; shape++) {
+				const auto& shapeIndices = shapes[shape].mesh.indices;
+				size_t shapeEnd = std::min(end, shapeOffsets[shape] + shapeIndices.size());
+				for (; i < shapeEnd; i++) {
+					fn(i, shapeIndices[i - shapeOffsets[shape]]);
+				}
+			}
+		}
+
+		struct WeldPartition {
+			size_t begin, end;
+			std::vector<Vk3dModel::Vertex> vertices;
+			// partition local vertex per index, remapped to the global vertex afterwards
+			std::vector<uint32_t> indices;
+			std::vector<uint32_t> remap;
+		};
+	}
+
+	void Vk3dModel::Builder::loadModel(const std::string &filepath, unsigned int threadCount) {
 		tinyobj::attrib_t attrib;
 		std::vector<tinyobj::shape_t> shapes;
 		std::vector<tinyobj::material_t> materials;
 		std::string warn, err;
 
-		if (!tinyobj::LoadObj(&attrib, &shapes, &materials, &warn, &err, filepath.c_str())) {
-			throw std::runtime_error(warn + err);
+		{
+			VK3D_PROFILE_ZONE("tinyobj::LoadObj");
+			if (!tinyobj::LoadObj(&attrib, &shapes, &materials, &warn, &err, filepath.c_str())) {
+				throw std::runtime_error(warn + err);
+			}
 		}
 
+		VK3D_PROFILE_ZONE("Vk3dModel::Builder weld vertices");
+
 		vertices.clear();
 		indices.clear();
+		lods.clear();
 
-		std::unordered_map<Vertex, uint32_t> uniqueVertices{};
-
-		for (const auto& shape : shapes) {
-			for (const auto& index : shape.mesh.indices) {
-				Vertex vertex{};
-				if (index.vertex_index >= 0) {
-					vertex.position = {
-						attrib.vertices[3 * index.vertex_index + 0],
-						attrib.vertices[3 * index.vertex_index + 1],
-						attrib.vertices[3 * index.vertex_index + 2],
-					};
-
-					vertex.color = {
-						attrib.colors[3 * index.vertex_index + 0],
-						attrib.colors[3 * index.vertex_index + 1],
-						attrib.colors[3 * index.vertex_index + 2],
-						1.0f
-					};
-				}
+		std::vector<size_t> shapeOffsets(shapes.size());
+		size_t totalIndices = 0;
+		for (size_t i = 0; i < shapes.size(); i++) {
+			shapeOffsets[i] = totalIndices;
+			totalIndices += shapes[i].mesh.indices.size();
+		}
 
-				if (index.normal_index >= 0) {
-					vertex.normal = {
-						attrib.normals[3 * index.normal_index + 0],
-						attrib.normals[3 * index.normal_index + 1],
-						attrib.normals[3 * index.normal_index + 2],
-					};
-				}
+		if (threadCount == 0) {
+			threadCount = totalIndices >= PARALLEL_WELD_MIN_INDICES ? std::max(1u, std::thread::hardware_concurrency()) : 1;
+		}
 
-				if (index.texcoord_index >= 0) {
-					vertex.uv = {
-						attrib.texcoords[2 * index.texcoord_index + 0],
-						attrib.texcoords[2 * index.texcoord_index + 1],
-					};
-				}
+		indices.resize(totalIndices);
+
+		if (threadCount == 1 || totalIndices == 0) {
+			Vk3dVertexTable uniqueVertices{ vertices, totalIndices / EXPECTED_INDICES_PER_VERTEX };
+
+			forEachIndex(shapes, shapeOffsets, 0, totalIndices, [&](size_t i, const tinyobj::index_t& index) {
+				indices[i] = uniqueVertices.findOrInsert(makeVertex(attrib, index));
+			});
+			return;
+		}
+
+		// Every partition welds a contiguous index range on its own. Merging the partitions in order keeps
+		// the first occurrence order of the serial path, so vertices and indices are byte-identical to it.
+		std::vector<WeldPartition> partitions(threadCount);
+		for (unsigned int p = 0; p < threadCount; p++) {
+			partitions[p].begin = totalIndices * p / threadCount;
+			partitions[p].end = totalIndices * (p + 1) / threadCount;
+		}
 
-				if (uniqueVertices.count(vertex) == 0) {
-					uniqueVertices[vertex] = static_cast<uint32_t>(vertices.size());
-					vertices.push_back(vertex);
+		auto runPartitions = [&partitions](auto&& fn) {
+			std::vector<std::thread> workers;
+			workers.reserve(partitions.size() - 1);
+			for (size_t p = 1; p < partitions.size(); p++) {
+				workers.emplace_back([&fn, &partitions, p] { fn(partitions[p]); });
+			}
+			fn(partitions[0]);
+			for (auto& worker : workers) {
+				worker.join();
+			}
+		};
+
+		runPartitions([&](WeldPartition& partition) {
+			VK3D_PROFILE_ZONE("weld partition");
+			Vk3dVertexTable uniqueVertices{ partition.vertices, (partition.end - partition.begin) / EXPECTED_INDICES_PER_VERTEX };
+			partition.indices.resize(partition.end - partition.begin);
+
+			forEachIndex(shapes, shapeOffsets, partition.begin, partition.end, [&](size_t i, const tinyobj::index_t& index) {
+				partition.indices[i - partition.begin] = uniqueVertices.findOrInsert(makeVertex(attrib, index));
+			});
+		});
+
+		{
+			VK3D_PROFILE_ZONE("merge partitions");
+			size_t partitionVertices = 0;
+			for (auto& partition : partitions) {
+				partitionVertices += partition.vertices.size();
+			}
+
+			Vk3dVertexTable uniqueVertices{ vertices, partitionVertices };
+			for (auto& partition : partitions) {
+				partition.remap.resize(partition.vertices.size());
+				for (size_t v = 0; v < partition.vertices.size(); v++) {
+					partition.remap[v] = uniqueVertices.findOrInsert(partition.vertices[v]);
 				}
-				indices.push_back(uniqueVertices[vertex]);
 			}
 		}
 
+		runPartitions([&](WeldPartition& partition) {
+			for (size_t i = 0; i < partition.indices.size(); i++) {
+				indices[partition.begin + i] = partition.remap[partition.indices[i]];
+			}
+		});
+	}
+
+	void Vk3dModel::Builder::generateLods() {
+		VK3D_PROFILE_ZONE("Vk3dModel::Builder::generateLods");
+		lods = { Lod{ 0, static_cast<uint32_t>(indices.size()), 0.f } };
+
+		// every level simplifies the previous one, which is cheaper than starting from the full mesh each time
+		std::vector<uint32_t> previous = indices;
+		while (lods.size() < MAX_LODS && previous.size() >= LOD_MIN_INDICES) {
+			size_t targetIndexCount = previous.size() / 6 * 3;
+			float error = 0.f;
+			std::vector<uint32_t> simplified = Vk3dMeshSimplifier::simplify(vertices, previous, targetIndexCount, LOD_TARGET_ERROR, error);
+
+			// locked seams and borders or the error limit stopped it early, a level this close to the previous one isn't worth drawing
+			if (simplified.size() * 4 > previous.size() * 3) {
+				break;
+			}
+
+			std::vector<uint32_t> clusters;
+			simplified = Vk3dMeshOptimizer::optimizeVertexCache(simplified, vertices.size(), Vk3dMeshOptimizer::CACHE_SIZE, clusters);
+
+			lods.push_back(Lod{ static_cast<uint32_t>(indices.size()), static_cast<uint32_t>(simplified.size()), error });
+			indices.insert(indices.end(), simplified.begin(), simplified.end());
+			previous.swap(simplified);
+		}
+
+		if (lods.size() == 1) {
+			lods.clear();
+		}
 	}
 
-}
\ No newline at end of file
+}
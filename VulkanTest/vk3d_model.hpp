@@ -4,6 +4,7 @@
 #include "vk3d_buffer.hpp"
 #include "vk3d_swap_chain.hpp"
 #include "vk3d_allocator.hpp"
+#include "vk3d_frustum.hpp"
 
 
 // libs
@@ -16,9 +17,18 @@
 #include <vector>
 
 namespace vk3d {
+	class Vk3dMeshCache;
+	class Vk3dGeometryPool;
+
 	class Vk3dModel {
 		public:
-			
+			// Layout of the vertex buffers. It is chosen once for every model, the pipelines are built for a single layout.
+			enum class VertexFormat {
+				Standard,	// Vertex, 48 bytes
+				Compact,	// CompactVertex, 24 bytes
+				Quantized,	// QuantizedVertex, 20 bytes
+			};
+
 			struct Vertex {
 				glm::vec3 position{};
 				glm::vec4 color{};
@@ -32,36 +42,149 @@ namespace vk3d {
 				}
 			};
 
+			// RGBA8 unorm color, octahedral normal in 2x16 bit snorm and half float uv, the shaders need COMPACT_VERTEX
+			struct CompactVertex {
+				glm::vec3 position{};
+				uint32_t color = 0;
+				uint32_t normal = 0;
+				uint32_t uv = 0;
+				static std::vector<VkVertexInputBindingDescription> getBindingDescriptions();
+				static std::vector<VkVertexInputAttributeDescription> getAttributeDescriptions();
+			};
+
+			// CompactVertex with a 16 bit snorm position inside the model bounds, see getPositionTransform
+			struct QuantizedVertex {
+				int16_t position[4]{};
+				uint32_t color = 0;
+				uint32_t normal = 0;
+				uint32_t uv = 0;
+				static std::vector<VkVertexInputBindingDescription> getBindingDescriptions();
+				static std::vector<VkVertexInputAttributeDescription> getAttributeDescriptions();
+			};
+
+			// Range of the index buffer drawn for a level of detail, all levels share the vertex buffer
+			struct Lod {
+				uint32_t firstIndex;
+				uint32_t indexCount;
+				// largest distance the simplification moved the surface, relative to the model extent
+				float error;
+			};
+
+			static constexpr uint32_t MAX_LODS = 4;
+
 			struct Builder {
+				// Smaller meshes are welded on the calling thread, spawning workers costs more than it saves
+				static constexpr size_t PARALLEL_WELD_MIN_INDICES = 1 << 18;
+				// Every LOD aims at half the triangles of the previous one, within this error relative to the model extent
+				static constexpr float LOD_TARGET_ERROR = 0.02f;
+				// Meshes this small are drawn as they are
+				static constexpr size_t LOD_MIN_INDICES = 3 * 64;
+
 				std::vector<Vertex> vertices{};
 				std::vector<uint32_t> indices{};
+				// empty when the whole index buffer is the only level
+				std::vector<Lod> lods{};
 
-				void loadModel(const std::string &filepath);
+				// threadCount 0 picks the hardware concurrency for large meshes. The output does not depend on the thread count.
+				void loadModel(const std::string &filepath, unsigned int threadCount = 0);
+				// Appends simplified copies of the indices after the current ones, stopping when a level can't halve the previous one
+				void generateLods();
 			};
 
-			Vk3dModel(Vk3dDevice &device, const Vk3dModel::Builder &builder, Vk3dAllocator &allocator);
+			// Geometry of a model file, either the mapped mesh cache or a freshly imported builder.
+			// Loading it creates no Vulkan objects, so it can happen on any thread.
+			struct Source {
+				std::unique_ptr<Vk3dMeshCache> meshCache;
+				Builder builder{};
+				// Vk3dMeshCache::hashFile of the model file, identical files share it whatever their path
+				uint64_t sourceHash = 0;
+				// vertex cache efficiency before and after the optimization, only set when the OBJ was imported
+				float acmrBefore = 0.f;
+				float acmrAfter = 0.f;
+				float atvrBefore = 0.f;
+				float atvrAfter = 0.f;
+
+				Source();
+				Source(Source&&);
+				Source& operator=(Source&&);
+				~Source();
+			};
+
+			// Vertices and indices are sub-allocated from the pool and uploaded in its vertex format
+			Vk3dModel(Vk3dDevice &device, const Vk3dModel::Builder &builder, Vk3dGeometryPool &geometryPool);
+			Vk3dModel(Vk3dDevice &device, const Vk3dMeshCache &meshCache, Vk3dGeometryPool &geometryPool);
 			~Vk3dModel();
 
 			Vk3dModel(const Vk3dModel&) = delete;
 			Vk3dModel& operator=(const Vk3dModel&) = delete;
 
-			static std::unique_ptr<Vk3dModel> createModelFromFile(Vk3dDevice &device, const std::string &filepath, Vk3dAllocator& allocator);
+			// Loads the binary mesh cache next to the OBJ file, parsing the OBJ and rebuilding the cache when it is stale
+			static std::unique_ptr<Vk3dModel> createModelFromFile(Vk3dDevice &device, const std::string &filepath, Vk3dGeometryPool& geometryPool);
+			// The two halves of createModelFromFile: importFile reads, optimizes and caches the mesh, createModel uploads it
+			static Source importFile(const std::string &filepath);
+			static std::unique_ptr<Vk3dModel> createModel(Vk3dDevice &device, const Source &source, Vk3dGeometryPool& geometryPool);
+			// Prints the vertex cache and LOD statistics of an imported OBJ, nothing when the source is the mesh cache.
+			// importFile may run on a worker thread, so it leaves the printing to the thread that uploads the model.
+			static void printImportStatistics(const std::string &filepath, const Source &source);
+
+			static std::vector<VkVertexInputBindingDescription> getBindingDescriptions(VertexFormat vertexFormat);
+			static std::vector<VkVertexInputAttributeDescription> getAttributeDescriptions(VertexFormat vertexFormat);
+			// The position stream holds the position attribute of the vertex format alone: a vec3, or the 16 bit snorm
+			// position of QuantizedVertex. Every vertex format starts with its position.
+			static uint32_t getPositionSize(VertexFormat vertexFormat);
+			static std::vector<VkVertexInputBindingDescription> getPositionBindingDescriptions(VertexFormat vertexFormat);
+			static std::vector<VkVertexInputAttributeDescription> getPositionAttributeDescriptions(VertexFormat vertexFormat);
+
+			// The geometry pool must be bound, see Vk3dGeometryPool::bind. The shaders read the slot of every instance
+			// in the Vk3dGpuScene instance buffer, from firstInstance on.
+			void draw(VkCommandBuffer commandBuffer, uint32_t lod = 0, uint32_t instanceCount = 1, uint32_t firstInstance = 0) const;
+			// Arguments of the indexed draw done by draw, for vkCmdDrawIndexedIndirect. Only for indexed models.
+			VkDrawIndexedIndirectCommand getDrawCommand(uint32_t lod = 0, uint32_t firstInstance = 0) const;
+			bool isIndexed() const { return hasIndexBuffer; }
 
-			void bind(VkCommandBuffer commandBuffer);
-			void draw(VkCommandBuffer commandBuffer);
+			// Maps the vertex positions to model space, it has to be applied before the model matrix.
+			// Identity unless the positions are quantized.
+			const glm::mat4& getPositionTransform() const { return positionTransform; }
+			VkDeviceSize getVertexBufferSize() const { return vertexBufferSize; }
+			// 0 when the geometry pool has no position stream
+			VkDeviceSize getPositionBufferSize() const { return positionBufferSize; }
+			// Start of the vertices in the geometry pool, no two resident models share it
+			uint32_t getFirstVertex() const { return firstVertex; }
+			// bytes of the geometry pool held by the model, vertices, positions and indices
+			VkDeviceSize getGpuSize() const { return vertexBufferSize + positionBufferSize + static_cast<VkDeviceSize>(indexCount) * sizeof(uint32_t); }
+			// 0 unless the model was created from a Source
+			uint64_t getSourceHash() const { return sourceHash; }
+			uint32_t getLodCount() const { return static_cast<uint32_t>(lods.size()); }
+			// triangles drawn by draw with this LOD
+			uint32_t getTriangleCount(uint32_t lod = 0) const;
+			// bounding sphere of the vertices in model space
+			const glm::vec3& getBoundingCenter() const { return boundingCenter; }
+			float getBoundingRadius() const { return boundingRadius; }
+			// bounding box of the vertices in model space
+			const Vk3dAabb& getBounds() const { return bounds; }
 
 		private:
-			void createVertexBuffers(const std::vector<Vertex>& vertices);
-			void createIndexBuffers(const std::vector<uint32_t>& indices);
-			void destroyVertexBuffers();
+			void createVertexBuffers(const Vertex* vertices, uint32_t vertexCount, VertexFormat vertexFormat);
+			void uploadVertexBuffer(const void* vertices, uint32_t vertexSize, uint32_t vertexCount);
+			void uploadPositionStream(const void* vertices, uint32_t vertexSize, uint32_t vertexCount);
+			void createIndexBuffers(const uint32_t* indices, uint32_t indexCount);
+			void createLods(const Lod* lods, uint32_t lodCount);
 
 			Vk3dDevice& vk3dDevice;
-			Vk3dAllocator& vk3dAllocator;
-			std::unique_ptr<Vk3dBuffer> vertexBuffer;
-			uint32_t vertexCount;
+			Vk3dGeometryPool& vk3dGeometryPool;
+			uint32_t firstVertex = 0;
+			uint32_t vertexCount = 0;
+			VkDeviceSize vertexBufferSize = 0;
+			VkDeviceSize positionBufferSize = 0;
+			glm::mat4 positionTransform{ 1.f };
+			glm::vec3 boundingCenter{ 0.f };
+			float boundingRadius = 0.f;
+			Vk3dAabb bounds;
 
 			bool hasIndexBuffer = false;
-			std::unique_ptr<Vk3dBuffer> indexBuffer;
-			uint32_t indexCount;
+			uint32_t firstIndex = 0;
+			uint32_t indexCount = 0;
+			std::vector<Lod> lods;
+			uint64_t sourceHash = 0;
 	};
 }
\ No newline at end of file
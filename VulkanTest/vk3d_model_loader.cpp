@@ -0,0 +1,133 @@
+#include "vk3d_model_loader.hpp"
+
+#include "vk3d_profiler.hpp"
+
+namespace vk3d {
+
+	Vk3dModelLoader::Vk3dModelLoader(Vk3dDevice& device, Vk3dGeometryPool& geometryPool) : vk3dDevice{ device }, vk3dGeometryPool{ geometryPool } {
+		worker = std::thread(&Vk3dModelLoader::workerLoop, this);
+	}
+
+	Vk3dModelLoader::~Vk3dModelLoader() {
+		{
+			std::lock_guard<std::mutex> lock{ mutex };
+			stopping = true;
+		}
+		queuedCondition.notify_all();
+		worker.join();
+	}
+
+	Vk3dModelLoader::ModelFuture Vk3dModelLoader::load(const std::string& filepath, Callback onLoaded) {
+		auto request = std::make_unique<Request>();
+		request->filepath = filepath;
+		request->onLoaded = std::move(onLoaded);
+		ModelFuture future = request->promise.get_future().share();
+
+		{
+			std::lock_guard<std::mutex> lock{ mutex };
+			queued.push_back(std::move(request));
+		}
+		queuedCondition.notify_one();
+		pendingCount++;
+		return future;
+	}
+
+	uint32_t Vk3dModelLoader::update() {
+		VK3D_PROFILE_ZONE("Vk3dModelLoader::update");
+		return uploadImported(false);
+	}
+
+	void Vk3dModelLoader::finish() {
+		VK3D_PROFILE_ZONE("Vk3dModelLoader::finish");
+		uploadImported(true);
+	}
+
+	void Vk3dModelLoader::workerLoop() {
+		VK3D_PROFILE_THREAD_NAME("model loader");
+		while (true) {
+			std::unique_ptr<Request> request;
+			{
+				std::unique_lock<std::mutex> lock{ mutex };
+				queuedCondition.wait(lock, [this] { return stopping || !queued.empty(); });
+				if (stopping) {
+					return;
+				}
+				request = std::move(queued.front());
+				queued.pop_front();
+			}
+
+			try {
+				request->source = Vk3dModel::importFile(request->filepath);
+			}
+			catch (...) {
+				request->error = std::current_exception();
+			}
+
+			{
+				std::lock_guard<std::mutex> lock{ mutex };
+				imported.push_back(std::move(request));
+			}
+			importedCondition.notify_one();
+		}
+	}
+
+	uint32_t Vk3dModelLoader::uploadImported(bool wait) {
+		uint32_t resident = 0;
+		VkDeviceSize uploadedBytes = 0;
+
+		while (pendingCount > 0 && (wait || uploadedBytes < UPLOAD_BYTES_PER_UPDATE)) {
+			std::unique_ptr<Request> request;
+			{
+				std::unique_lock<std::mutex> lock{ mutex };
+				if (wait) {
+					importedCondition.wait(lock, [this] { return !imported.empty(); });
+				}
+				if (imported.empty()) {
+					break;
+				}
+				request = std::move(imported.front());
+				imported.pop_front();
+			}
+			pendingCount--;
+
+			std::shared_ptr<Vk3dModel> model;
+			bool uploaded = false;
+			if (!request->error) {
+				if (contentLookup) {
+					model = contentLookup(request->source.sourceHash);
+				}
+				try {
+					if (!model) {
+						model = Vk3dModel::createModel(vk3dDevice, request->source, vk3dGeometryPool);
+						uploaded = true;
+					}
+				}
+				catch (...) {
+					request->error = std::current_exception();
+				}
+			}
+
+			if (request->error) {
+				request->promise.set_exception(request->error);
+				// the objects waiting in the callback would silently never show up
+				if (request->onLoaded) {
+					std::rethrow_exception(request->error);
+				}
+				continue;
+			}
+
+			Vk3dModel::printImportStatistics(request->filepath, request->source);
+			if (uploaded) {
+				uploadedBytes += model->getVertexBufferSize();
+			}
+			// the future is fulfilled first, a throwing callback must not leave it with a broken promise
+			request->promise.set_value(model);
+			if (request->onLoaded) {
+				request->onLoaded(model);
+			}
+			resident++;
+		}
+		return resident;
+	}
+
+}
@@ -0,0 +1,76 @@
+#pragma once
+
+#include "vk3d_device.hpp"
+#include "vk3d_model.hpp"
+#include "vk3d_geometry_pool.hpp"
+
+// std
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+
+namespace vk3d {
+	// Streams models in without blocking the frame loop. A worker thread imports the files (OBJ parsing, optimization,
+	// LODs and the mesh cache), the thread that owns the device uploads the finished ones to the geometry pool in update.
+	class Vk3dModelLoader {
+	public:
+		using ModelFuture = std::shared_future<std::shared_ptr<Vk3dModel>>;
+		using Callback = std::function<void(const std::shared_ptr<Vk3dModel>&)>;
+		// Returns the resident model imported from a file with this content hash, or nullptr
+		using ContentLookup = std::function<std::shared_ptr<Vk3dModel>(uint64_t sourceHash)>;
+
+		// update stops once a frame has uploaded this many vertex bytes, a single larger model still goes through
+		static constexpr VkDeviceSize UPLOAD_BYTES_PER_UPDATE = 16 * 1024 * 1024;
+
+		Vk3dModelLoader(Vk3dDevice& device, Vk3dGeometryPool& geometryPool);
+		~Vk3dModelLoader();
+
+		Vk3dModelLoader(const Vk3dModelLoader&) = delete;
+		Vk3dModelLoader& operator=(const Vk3dModelLoader&) = delete;
+
+		// Queues the file, onLoaded runs inside update once the model is resident.
+		// Import errors reach the future, update also rethrows them when the load has a callback.
+		ModelFuture load(const std::string& filepath, Callback onLoaded = {});
+
+		// Uploads imported models and runs their callbacks, call it once per frame. Returns the number of models made resident.
+		uint32_t update();
+		// Blocks until every queued model is resident
+		void finish();
+
+		uint32_t getPendingCount() const { return pendingCount; }
+		// Imports whose content is already resident resolve to that model instead of being uploaded again
+		void setContentLookup(ContentLookup lookup) { contentLookup = std::move(lookup); }
+
+	private:
+		struct Request {
+			std::string filepath;
+			Callback onLoaded;
+			std::promise<std::shared_ptr<Vk3dModel>> promise;
+			Vk3dModel::Source source;
+			std::exception_ptr error;
+		};
+
+		void workerLoop();
+		uint32_t uploadImported(bool wait);
+
+		Vk3dDevice& vk3dDevice;
+		Vk3dGeometryPool& vk3dGeometryPool;
+
+		std::mutex mutex;
+		std::condition_variable queuedCondition;
+		std::condition_variable importedCondition;
+		std::deque<std::unique_ptr<Request>> queued;
+		std::deque<std::unique_ptr<Request>> imported;
+		bool stopping = false;
+		// only touched by the owning thread
+		uint32_t pendingCount = 0;
+		ContentLookup contentLookup;
+
+		std::thread worker;
+	};
+}
@@ -0,0 +1,124 @@
+#include "vk3d_model_registry.hpp"
+
+#include "vk3d_profiler.hpp"
+
+// std
+#include <algorithm>
+#include <iterator>
+
+namespace vk3d {
+
+	Vk3dModelRegistry::Vk3dModelRegistry(Vk3dModelLoader& loader, Vk3dGeometryPool& geometryPool, VkDeviceSize budget)
+		: vk3dModelLoader{ loader }, vk3dGeometryPool{ geometryPool } {
+		setBudget(budget);
+		vk3dModelLoader.setContentLookup([this](uint64_t sourceHash) {
+			auto it = entries.find(sourceHash);
+			return it != entries.end() ? it->second.model : Handle{};
+		});
+		// a model that doesn't fit evicts the oldest unreferenced model and the pool tries again, even under the budget
+		vk3dGeometryPool.setReclaimCallback([this] {
+			return residentSize > 0 && evict(residentSize - 1) > 0;
+		});
+	}
+
+	Vk3dModelRegistry::~Vk3dModelRegistry() {
+		vk3dGeometryPool.setReclaimCallback({});
+		vk3dModelLoader.setContentLookup({});
+	}
+
+	void Vk3dModelRegistry::setBudget(VkDeviceSize budget) {
+		// the pool runs out before a larger budget is reached, so the budget would never evict anything
+		this->budget = std::min(budget, vk3dGeometryPool.getMemorySize());
+	}
+
+	void Vk3dModelRegistry::load(const std::string& filepath, Vk3dModelLoader::Callback onLoaded) {
+		auto path = pathHashes.find(filepath);
+		if (path != pathHashes.end()) {
+			Entry& entry = entries.at(path->second);
+			entry.lastUsedFrame = frameIndex;
+			onLoaded(entry.model);
+			return;
+		}
+
+		auto pending = pendingPaths.find(filepath);
+		if (pending != pendingPaths.end()) {
+			pending->second.push_back(std::move(onLoaded));
+			return;
+		}
+
+		pendingPaths[filepath].push_back(std::move(onLoaded));
+		vk3dModelLoader.load(filepath, [this, filepath](const Handle& model) {
+			onImported(filepath, model);
+		});
+	}
+
+	void Vk3dModelRegistry::onImported(const std::string& filepath, const Handle& model) {
+		uint64_t sourceHash = model->getSourceHash();
+		auto inserted = entries.emplace(sourceHash, Entry{ model, model->getGpuSize(), frameIndex });
+		if (inserted.second) {
+			residentSize += model->getGpuSize();
+		}
+		else {
+			// another path with the same content, the loader resolved it to the resident model
+			inserted.first->second.lastUsedFrame = frameIndex;
+		}
+		pathHashes[filepath] = sourceHash;
+
+		auto callbacks = std::move(pendingPaths.at(filepath));
+		pendingPaths.erase(filepath);
+		for (auto& callback : callbacks) {
+			callback(model);
+		}
+	}
+
+	void Vk3dModelRegistry::update() {
+		VK3D_PROFILE_ZONE("Vk3dModelRegistry::update");
+		frameIndex++;
+		for (auto& kv : entries) {
+			if (kv.second.model.use_count() > 1) {
+				kv.second.lastUsedFrame = frameIndex;
+			}
+		}
+
+		if (residentSize > budget) {
+			evict(budget);
+		}
+	}
+
+	uint32_t Vk3dModelRegistry::evict(VkDeviceSize targetSize) {
+		// candidates are collected once, the oldest first, a model referenced again in between isn't one anymore
+		std::vector<std::pair<uint64_t, uint64_t>> candidates;
+		for (const auto& kv : entries) {
+			if (kv.second.model.use_count() == 1 && kv.second.lastUsedFrame + EVICTION_DELAY_FRAMES <= frameIndex) {
+				candidates.emplace_back(kv.second.lastUsedFrame, kv.first);
+			}
+		}
+		std::sort(candidates.begin(), candidates.end());
+
+		uint32_t evicted = 0;
+		for (const auto& candidate : candidates) {
+			if (residentSize <= targetSize) {
+				break;
+			}
+			auto entry = entries.find(candidate.second);
+			residentSize -= entry->second.gpuSize;
+			entries.erase(entry);
+			evictionCount++;
+			evicted++;
+
+			for (auto path = pathHashes.begin(); path != pathHashes.end();) {
+				path = path->second == candidate.second ? pathHashes.erase(path) : std::next(path);
+			}
+		}
+		return evicted;
+	}
+
+	VkDeviceSize Vk3dModelRegistry::getVertexBufferSize() const {
+		VkDeviceSize vertexBufferSize = 0;
+		for (const auto& kv : entries) {
+			vertexBufferSize += kv.second.model->getVertexBufferSize();
+		}
+		return vertexBufferSize;
+	}
+
+}
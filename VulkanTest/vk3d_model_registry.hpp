@@ -0,0 +1,75 @@
+#pragma once
+
+#include "vk3d_model.hpp"
+#include "vk3d_model_loader.hpp"
+#include "vk3d_geometry_pool.hpp"
+#include "vk3d_swap_chain.hpp"
+
+// std
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace vk3d {
+	// Shares every model between the objects that use it. Models are keyed by path, and by the content hash of the file
+	// once imported, so the same file under two paths is uploaded once. The registry keeps a reference to each model;
+	// when nothing else holds one and the resident models exceed the budget, or a new model doesn't fit in the
+	// geometry pool, the least recently used ones are evicted.
+	class Vk3dModelRegistry {
+	public:
+		using Handle = std::shared_ptr<Vk3dModel>;
+
+		// clamped to the memory of the geometry pool
+		static constexpr VkDeviceSize DEFAULT_BUDGET = 256 * 1024 * 1024;
+		// frames an unreferenced model stays resident, the frames in flight may still draw it
+		static constexpr uint64_t EVICTION_DELAY_FRAMES = Vk3dSwapChain::MAX_FRAMES_IN_FLIGHT;
+
+		Vk3dModelRegistry(Vk3dModelLoader& loader, Vk3dGeometryPool& geometryPool, VkDeviceSize budget = DEFAULT_BUDGET);
+		~Vk3dModelRegistry();
+
+		Vk3dModelRegistry(const Vk3dModelRegistry&) = delete;
+		Vk3dModelRegistry& operator=(const Vk3dModelRegistry&) = delete;
+
+		// onLoaded gets the shared model of filepath, right away when it is resident, otherwise from the loader update
+		void load(const std::string& filepath, Vk3dModelLoader::Callback onLoaded);
+
+		// Call once per frame: stamps the models still referenced outside the registry and evicts unreferenced ones,
+		// least recently used first, while the resident models exceed the budget
+		void update();
+
+		void setBudget(VkDeviceSize budget);
+		VkDeviceSize getBudget() const { return budget; }
+		// geometry pool bytes of every resident model
+		VkDeviceSize getResidentSize() const { return residentSize; }
+		VkDeviceSize getVertexBufferSize() const;
+		uint32_t getModelCount() const { return static_cast<uint32_t>(entries.size()); }
+		uint32_t getEvictionCount() const { return evictionCount; }
+
+	private:
+		struct Entry {
+			Handle model;
+			VkDeviceSize gpuSize;
+			uint64_t lastUsedFrame;
+		};
+
+		void onImported(const std::string& filepath, const Handle& model);
+		// Evicts unreferenced models, least recently used first, while the resident models exceed targetSize.
+		// Returns the number of models evicted.
+		uint32_t evict(VkDeviceSize targetSize);
+
+		Vk3dModelLoader& vk3dModelLoader;
+		Vk3dGeometryPool& vk3dGeometryPool;
+		VkDeviceSize budget;
+		VkDeviceSize residentSize = 0;
+		uint64_t frameIndex = 0;
+		uint32_t evictionCount = 0;
+
+		// by content hash
+		std::unordered_map<uint64_t, Entry> entries;
+		std::unordered_map<std::string, uint64_t> pathHashes;
+		// callbacks of the paths being imported, a path is only queued on the loader once
+		std::unordered_map<std::string, std::vector<Vk3dModelLoader::Callback>> pendingPaths;
+	};
+}
@@ -12,10 +12,15 @@ namespace vk3d {
 		createGraphicsPipeline(vertFilepath, fragFilepath, configInfo);
 	}
 
+	Vk3dPipeline::Vk3dPipeline(Vk3dDevice& device, const std::string& compFilepath, VkPipelineLayout pipelineLayout) : vk3dDevice(device), bindPoint{ VK_PIPELINE_BIND_POINT_COMPUTE } {
+		createComputePipeline(compFilepath, pipelineLayout);
+	}
+
 	Vk3dPipeline::~Vk3dPipeline() {
 		vkDestroyShaderModule(vk3dDevice.device(), vertShaderModule, nullptr);
 		vkDestroyShaderModule(vk3dDevice.device(), fragShaderModule, nullptr);
-		vkDestroyPipeline(vk3dDevice.device(), graphicsPipeline, nullptr);
+		vkDestroyShaderModule(vk3dDevice.device(), compShaderModule, nullptr);
+		vkDestroyPipeline(vk3dDevice.device(), pipeline, nullptr);
 	}
 
 	std::vector<char> Vk3dPipeline::readFile(const std::string& filepath) {
@@ -91,11 +96,32 @@ namespace vk3d {
 		pipelineInfo.basePipelineIndex = -1;
 		pipelineInfo.basePipelineHandle = VK_NULL_HANDLE;
 
-		if (vkCreateGraphicsPipelines(vk3dDevice.device(), VK_NULL_HANDLE, 1, &pipelineInfo, nullptr, &graphicsPipeline) != VK_SUCCESS) {
+		if (vkCreateGraphicsPipelines(vk3dDevice.device(), VK_NULL_HANDLE, 1, &pipelineInfo, nullptr, &pipeline) != VK_SUCCESS) {
 			throw std::runtime_error("failed to create graphics pipeline");
 		}
 	}
 
+	void Vk3dPipeline::createComputePipeline(const std::string& compFilepath, VkPipelineLayout pipelineLayout) {
+		assert(pipelineLayout != VK_NULL_HANDLE && "Cannot create compute pipeline: no pipelineLayout provided");
+		auto compCode = readFile(compFilepath);
+
+		createShaderModule(compCode, &compShaderModule);
+
+		VkComputePipelineCreateInfo pipelineInfo{};
+		pipelineInfo.sType = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO;
+		pipelineInfo.stage.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+		pipelineInfo.stage.stage = VK_SHADER_STAGE_COMPUTE_BIT;
+		pipelineInfo.stage.module = compShaderModule;
+		pipelineInfo.stage.pName = "main";
+		pipelineInfo.layout = pipelineLayout;
+		pipelineInfo.basePipelineIndex = -1;
+		pipelineInfo.basePipelineHandle = VK_NULL_HANDLE;
+
+		if (vkCreateComputePipelines(vk3dDevice.device(), VK_NULL_HANDLE, 1, &pipelineInfo, nullptr, &pipeline) != VK_SUCCESS) {
+			throw std::runtime_error("failed to create compute pipeline");
+		}
+	}
+
 	void Vk3dPipeline::createShaderModule(const std::vector<char>& code, VkShaderModule* shaderModule) {
 		VkShaderModuleCreateInfo createInfo{};
 		createInfo.sType = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO;
@@ -109,7 +135,7 @@ namespace vk3d {
 	}
 
 	void Vk3dPipeline::bind(VkCommandBuffer commandBuffer) {
-		vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, graphicsPipeline);
+		vkCmdBindPipeline(commandBuffer, bindPoint, pipeline);
 	}
 
 	void Vk3dPipeline::defaultPipelineConfigInfo(PipelineConfigInfo& configInfo) {
@@ -188,8 +214,8 @@ namespace vk3d {
 		configInfo.dynamicStateInfo.flags = 0;
 
 		if (configInfo.hasVertexBufferBound) {
-			configInfo.bindingDescriptions = Vk3dModel::Vertex::getBindingDescriptions();
-			configInfo.attributeDescriptions = Vk3dModel::Vertex::getAttributeDescriptions();
+			configInfo.bindingDescriptions = Vk3dModel::getBindingDescriptions(configInfo.vertexFormat);
+			configInfo.attributeDescriptions = Vk3dModel::getAttributeDescriptions(configInfo.vertexFormat);
 		}
 		
 	}
@@ -269,9 +295,13 @@ namespace vk3d {
 			static_cast<uint32_t>(configInfo.dynamicStateEnables.size());
 		configInfo.dynamicStateInfo.flags = 0;
 
-		if (configInfo.hasVertexBufferBound) {
-			configInfo.bindingDescriptions = Vk3dModel::Vertex::getBindingDescriptions();
-			configInfo.attributeDescriptions = Vk3dModel::Vertex::getAttributeDescriptions();
+		if (configInfo.hasVertexBufferBound && configInfo.positionOnly) {
+			configInfo.bindingDescriptions = Vk3dModel::getPositionBindingDescriptions(configInfo.vertexFormat);
+			configInfo.attributeDescriptions = Vk3dModel::getPositionAttributeDescriptions(configInfo.vertexFormat);
+		}
+		else if (configInfo.hasVertexBufferBound) {
+			configInfo.bindingDescriptions = Vk3dModel::getBindingDescriptions(configInfo.vertexFormat);
+			configInfo.attributeDescriptions = Vk3dModel::getAttributeDescriptions(configInfo.vertexFormat);
 		}
 
 	}
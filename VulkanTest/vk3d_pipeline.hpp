@@ -1,6 +1,7 @@
 #pragma once
 
 #include "vk3d_device.hpp"
+#include "vk3d_model.hpp"
 
 // std
 #include <string>
@@ -25,6 +26,9 @@ namespace vk3d {
 		VkPipelineLayout pipelineLayout = nullptr;
 		VkRenderPass renderPass = nullptr;
 		bool hasVertexBufferBound = true;
+		Vk3dModel::VertexFormat vertexFormat = Vk3dModel::VertexFormat::Standard;
+		// Only the position stream is bound, see Vk3dGeometryPool::bindPositions
+		bool positionOnly = false;
 		int attachmentCount = 1;
 		uint32_t subpass = 0;
 	};
@@ -32,6 +36,8 @@ namespace vk3d {
 	class Vk3dPipeline {
 		public:
 			Vk3dPipeline(Vk3dDevice &device, const std::string& vertFilepath, const std::string& fragFilepath, const PipelineConfigInfo &configInfo);
+			// Compute pipeline, bind binds it to the compute bind point
+			Vk3dPipeline(Vk3dDevice &device, const std::string& compFilepath, VkPipelineLayout pipelineLayout);
 			~Vk3dPipeline();
 
 			Vk3dPipeline(const Vk3dPipeline&) = delete;
@@ -44,12 +50,15 @@ namespace vk3d {
 	private:
 		static std::vector<char> readFile(const std::string& filepath);
 		void createGraphicsPipeline(const std::string& vertFilepath, const std::string& fragFilepath, const PipelineConfigInfo& configInfo);
+		void createComputePipeline(const std::string& compFilepath, VkPipelineLayout pipelineLayout);
 
 		void createShaderModule(const std::vector<char>& code, VkShaderModule* shaderModule);
 
 		Vk3dDevice& vk3dDevice;
-		VkPipeline graphicsPipeline;
-		VkShaderModule vertShaderModule;
-		VkShaderModule fragShaderModule;
+		VkPipeline pipeline;
+		VkPipelineBindPoint bindPoint = VK_PIPELINE_BIND_POINT_GRAPHICS;
+		VkShaderModule vertShaderModule = VK_NULL_HANDLE;
+		VkShaderModule fragShaderModule = VK_NULL_HANDLE;
+		VkShaderModule compShaderModule = VK_NULL_HANDLE;
 	};
 }
\ No newline at end of file
@@ -0,0 +1,119 @@
+#include "vk3d_profiler.hpp"
+
+// std
+#include <fstream>
+#include <iomanip>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <vector>
+
+namespace vk3d {
+
+	namespace {
+		struct Zone {
+			const char* name;
+			Vk3dProfiler::Clock::time_point start;
+			Vk3dProfiler::Clock::time_point end;
+		};
+
+		struct ThreadBuffer {
+			uint32_t threadId;
+			std::string threadName;
+			std::vector<Zone> zones;
+			size_t next = 0;
+			bool wrapped = false;
+		};
+
+		// Trace timestamps are relative to the first use of the profiler
+		const Vk3dProfiler::Clock::time_point traceEpoch = Vk3dProfiler::Clock::now();
+
+		std::mutex registryMutex;
+		std::vector<std::shared_ptr<ThreadBuffer>> threadBuffers;
+
+		ThreadBuffer& getThreadBuffer() {
+			// the registry keeps buffers of finished threads alive until they are written
+			thread_local std::shared_ptr<ThreadBuffer> threadBuffer = [] {
+				auto buffer = std::make_shared<ThreadBuffer>();
+				buffer->zones.resize(Vk3dProfiler::ZONES_PER_THREAD);
+
+				std::lock_guard<std::mutex> lock{ registryMutex };
+				buffer->threadId = static_cast<uint32_t>(threadBuffers.size());
+				buffer->threadName = "thread " + std::to_string(buffer->threadId);
+				threadBuffers.push_back(buffer);
+				return buffer;
+			}();
+			return *threadBuffer;
+		}
+
+		double toMicroseconds(Vk3dProfiler::Clock::duration duration) {
+			return std::chrono::duration<double, std::micro>(duration).count();
+		}
+
+		void writeEscaped(std::ofstream& file, const std::string& text) {
+			for (char c : text) {
+				if (c == '"' || c == '\\') {
+					file << '\\';
+				}
+				file << c;
+			}
+		}
+	}
+
+	bool Vk3dProfiler::isCompiledIn() {
+#ifndef VK3D_DISABLE_PROFILING
+		return true;
+#else
+		return false;
+#endif
+	}
+
+	void Vk3dProfiler::recordZone(const char* name, Clock::time_point start, Clock::time_point end) {
+		ThreadBuffer& buffer = getThreadBuffer();
+		buffer.zones[buffer.next] = Zone{ name, start, end };
+		buffer.next++;
+		if (buffer.next == buffer.zones.size()) {
+			buffer.next = 0;
+			buffer.wrapped = true;
+		}
+	}
+
+	void Vk3dProfiler::setThreadName(const char* name) {
+		ThreadBuffer& buffer = getThreadBuffer();
+		std::lock_guard<std::mutex> lock{ registryMutex };
+		buffer.threadName = name;
+	}
+
+	void Vk3dProfiler::writeChromeTrace(const std::string& filepath) {
+		std::ofstream file{ filepath };
+		if (!file.is_open()) {
+			throw std::runtime_error("failed to open file: " + filepath);
+		}
+
+		std::lock_guard<std::mutex> lock{ registryMutex };
+
+		file << std::fixed << std::setprecision(3);
+		file << "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[";
+		bool first = true;
+		for (auto& buffer : threadBuffers) {
+			file << (first ? "\n" : ",\n") << "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":" << buffer->threadId << ",\"args\":{\"name\":\"";
+			writeEscaped(file, buffer->threadName);
+			file << "\"}}";
+			first = false;
+
+			// oldest zone first once the ring has wrapped around
+			size_t count = buffer->wrapped ? buffer->zones.size() : buffer->next;
+			size_t begin = buffer->wrapped ? buffer->next : 0;
+			for (size_t i = 0; i < count; i++) {
+				const Zone& zone = buffer->zones[(begin + i) % buffer->zones.size()];
+				file << ",\n{\"name\":\"";
+				writeEscaped(file, zone.name);
+				file << "\",\"ph\":\"X\",\"pid\":1,\"tid\":" << buffer->threadId
+					<< ",\"ts\":" << toMicroseconds(zone.start - traceEpoch)
+					<< ",\"dur\":" << toMicroseconds(zone.end - zone.start) << "}";
+			}
+		}
+		file << "\n]}\n";
+	}
+
+}
@@ -0,0 +1,65 @@
+#pragma once
+
+// std
+#include <atomic>
+#include <chrono>
+#include <string>
+
+// CPU zones are compiled in unless VK3D_DISABLE_PROFILING is defined, and only recorded while the profiler is enabled
+#ifndef VK3D_DISABLE_PROFILING
+#define VK3D_PROFILE_CONCAT_IMPL(a, b) a##b
+#define VK3D_PROFILE_CONCAT(a, b) VK3D_PROFILE_CONCAT_IMPL(a, b)
+#define VK3D_PROFILE_ZONE(name) ::vk3d::Vk3dProfileZone VK3D_PROFILE_CONCAT(vk3dProfileZone, __COUNTER__){ name }
+#define VK3D_PROFILE_THREAD_NAME(name) ::vk3d::Vk3dProfiler::setThreadName(name)
+#else
+#define VK3D_PROFILE_ZONE(name)
+#define VK3D_PROFILE_THREAD_NAME(name)
+#endif
+
+namespace vk3d {
+	// Scoped CPU zone profiler. Every thread records into its own ring buffer, so recording takes no locks
+	// and the oldest zones are overwritten once a buffer is full. Zone names must be string literals.
+	class Vk3dProfiler {
+	public:
+		using Clock = std::chrono::steady_clock;
+
+		static constexpr size_t ZONES_PER_THREAD = 1 << 16;
+
+		static bool isCompiledIn();
+		static void setEnabled(bool enable) { enabled.store(enable, std::memory_order_relaxed); }
+		static bool isEnabled() { return enabled.load(std::memory_order_relaxed); }
+
+		static void recordZone(const char* name, Clock::time_point start, Clock::time_point end);
+		static void setThreadName(const char* name);
+
+		// Writes every recorded zone in Chrome trace event format (chrome://tracing, Perfetto).
+		// Threads must not record zones while the trace is being written.
+		static void writeChromeTrace(const std::string& filepath);
+
+	private:
+		inline static std::atomic<bool> enabled{ false };
+	};
+
+	class Vk3dProfileZone {
+	public:
+		explicit Vk3dProfileZone(const char* name) : name{ name }, active{ Vk3dProfiler::isEnabled() } {
+			if (active) {
+				start = Vk3dProfiler::Clock::now();
+			}
+		}
+
+		~Vk3dProfileZone() {
+			if (active) {
+				Vk3dProfiler::recordZone(name, start, Vk3dProfiler::Clock::now());
+			}
+		}
+
+		Vk3dProfileZone(const Vk3dProfileZone&) = delete;
+		Vk3dProfileZone& operator=(const Vk3dProfileZone&) = delete;
+
+	private:
+		const char* name;
+		bool active;
+		Vk3dProfiler::Clock::time_point start;
+	};
+}
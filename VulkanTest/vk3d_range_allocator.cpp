@@ -0,0 +1,69 @@
+#include "vk3d_range_allocator.hpp"
+
+// std
+#include <algorithm>
+#include <cassert>
+#include <iterator>
+
+namespace vk3d {
+
+	Vk3dRangeAllocator::Vk3dRangeAllocator(uint32_t capacity) : capacity{ capacity }, freeSize{ capacity } {
+		if (capacity > 0) {
+			freeRanges.emplace(0, capacity);
+		}
+	}
+
+	uint32_t Vk3dRangeAllocator::allocate(uint32_t size) {
+		assert(size > 0 && "Cannot allocate an empty range");
+		for (auto it = freeRanges.begin(); it != freeRanges.end(); ++it) {
+			if (it->second < size) {
+				continue;
+			}
+
+			uint32_t offset = it->first;
+			uint32_t remaining = it->second - size;
+			freeRanges.erase(it);
+			if (remaining > 0) {
+				freeRanges.emplace(offset + size, remaining);
+			}
+			freeSize -= size;
+			return offset;
+		}
+		return INVALID_OFFSET;
+	}
+
+	void Vk3dRangeAllocator::free(uint32_t offset, uint32_t size) {
+		assert(size > 0 && offset + size <= capacity && "Freed range is outside of the allocator");
+		freeSize += size;
+		auto next = freeRanges.lower_bound(offset);
+		assert((next == freeRanges.end() || offset + size <= next->first) && "Freed range overlaps a free range");
+
+		// merge with the free range that ends where this one starts
+		if (next != freeRanges.begin()) {
+			auto previous = std::prev(next);
+			assert(previous->first + previous->second <= offset && "Freed range overlaps a free range");
+			if (previous->first + previous->second == offset) {
+				offset = previous->first;
+				size += previous->second;
+				freeRanges.erase(previous);
+			}
+		}
+
+		// and with the one that starts where it ends
+		if (next != freeRanges.end() && offset + size == next->first) {
+			size += next->second;
+			freeRanges.erase(next);
+		}
+
+		freeRanges.emplace(offset, size);
+	}
+
+	uint32_t Vk3dRangeAllocator::getLargestFreeRange() const {
+		uint32_t largest = 0;
+		for (const auto& range : freeRanges) {
+			largest = std::max(largest, range.second);
+		}
+		return largest;
+	}
+
+}
@@ -0,0 +1,33 @@
+#pragma once
+
+// std
+#include <cstdint>
+#include <map>
+
+namespace vk3d {
+	// First fit free list over [0, capacity), in whatever unit the owner uses (vertices, indices, bytes).
+	// Freed ranges are merged with the free ranges next to them so the free list doesn't fragment over time.
+	class Vk3dRangeAllocator {
+	public:
+		static constexpr uint32_t INVALID_OFFSET = UINT32_MAX;
+
+		explicit Vk3dRangeAllocator(uint32_t capacity);
+
+		Vk3dRangeAllocator(const Vk3dRangeAllocator&) = delete;
+		Vk3dRangeAllocator& operator=(const Vk3dRangeAllocator&) = delete;
+
+		// Returns INVALID_OFFSET when no free range is large enough
+		uint32_t allocate(uint32_t size);
+		void free(uint32_t offset, uint32_t size);
+
+		uint32_t getCapacity() const { return capacity; }
+		uint32_t getFreeSize() const { return freeSize; }
+		uint32_t getLargestFreeRange() const;
+
+	private:
+		uint32_t capacity;
+		uint32_t freeSize;
+		// offset -> size of every free range, ordered by offset
+		std::map<uint32_t, uint32_t> freeRanges;
+	};
+}
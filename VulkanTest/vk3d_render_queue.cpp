@@ -0,0 +1,119 @@
+#include "vk3d_render_queue.hpp"
+
+#include "vk3d_geometry_pool.hpp"
+#include "vk3d_profiler.hpp"
+
+// std
+#include <algorithm>
+#include <array>
+#include <cassert>
+#include <cstring>
+
+namespace vk3d {
+
+	namespace {
+		constexpr uint32_t PASS_SHIFT = 60;
+		constexpr uint32_t PIPELINE_SHIFT = 56;
+		constexpr uint32_t MESH_SHIFT = 32;
+		constexpr uint32_t LOD_SHIFT = 30;
+		constexpr uint32_t PIPELINE_COUNT = 1 << (PASS_SHIFT - PIPELINE_SHIFT);
+		constexpr uint32_t MESH_COUNT = 1 << (PIPELINE_SHIFT - MESH_SHIFT);
+		constexpr uint32_t LOD_COUNT = 1 << (MESH_SHIFT - LOD_SHIFT);
+		static_assert(Vk3dGeometryPool::VERTEX_CAPACITY <= MESH_COUNT, "Mesh bits too narrow for the geometry pool");
+		static_assert(Vk3dModel::MAX_LODS <= LOD_COUNT, "LOD bits too narrow");
+
+		// 8 passes of 8 bits over the key
+		constexpr uint32_t RADIX_BITS = 8;
+		constexpr uint32_t RADIX_SIZE = 1 << RADIX_BITS;
+		constexpr uint32_t RADIX_PASSES = 64 / RADIX_BITS;
+	}
+
+	uint64_t Vk3dRenderQueue::makeKey(Pass pass, uint32_t pipeline, uint32_t mesh, uint32_t lod, float depth) {
+		assert(pipeline < PIPELINE_COUNT && "Pipeline out of the key");
+		assert(mesh < MESH_COUNT && "Mesh out of the key");
+		assert(lod < LOD_COUNT && "LOD out of the key");
+		// positive floats sort like their bits, the two lowest are dropped
+		depth = std::max(depth, 0.f);
+		uint32_t depthBits;
+		std::memcpy(&depthBits, &depth, sizeof(depthBits));
+		return static_cast<uint64_t>(pass) << PASS_SHIFT
+			| static_cast<uint64_t>(pipeline) << PIPELINE_SHIFT
+			| static_cast<uint64_t>(mesh) << MESH_SHIFT
+			| static_cast<uint64_t>(lod) << LOD_SHIFT
+			| depthBits >> 2;
+	}
+
+	void Vk3dRenderQueue::clear() {
+		packets.clear();
+		sorted = false;
+	}
+
+	void Vk3dRenderQueue::submit(Pass pass, uint32_t pipeline, const Vk3dModel* model, uint32_t lod, uint32_t slot, float depth) {
+		assert(!sorted && "Packet submitted after the queue was sorted");
+		packets.push_back({ makeKey(pass, pipeline, model->getFirstVertex(), lod, depth), model, lod, slot });
+	}
+
+	void Vk3dRenderQueue::sort(Vk3dGpuScene& gpuScene) {
+		VK3D_PROFILE_ZONE("Vk3dRenderQueue::sort");
+		sorted = true;
+		uint32_t count = static_cast<uint32_t>(packets.size());
+		if (count == 0) {
+			return;
+		}
+
+		// least significant digit first, the histograms of every digit in one read of the keys
+		std::array<std::array<uint32_t, RADIX_SIZE>, RADIX_PASSES> histograms{};
+		for (const Packet& packet : packets) {
+			for (uint32_t pass = 0; pass < RADIX_PASSES; pass++) {
+				histograms[pass][(packet.key >> (pass * RADIX_BITS)) & (RADIX_SIZE - 1)]++;
+			}
+		}
+		scratch.resize(count);
+		for (uint32_t pass = 0; pass < RADIX_PASSES; pass++) {
+			uint32_t shift = pass * RADIX_BITS;
+			auto& offsets = histograms[pass];
+			// every key has the same digit, the pass would not move anything. Most high digits are like that.
+			if (offsets[(packets[0].key >> shift) & (RADIX_SIZE - 1)] == count) {
+				continue;
+			}
+			uint32_t offset = 0;
+			for (uint32_t& digitOffset : offsets) {
+				uint32_t digitCount = digitOffset;
+				digitOffset = offset;
+				offset += digitCount;
+			}
+			for (const Packet& packet : packets) {
+				scratch[offsets[(packet.key >> shift) & (RADIX_SIZE - 1)]++] = packet;
+			}
+			packets.swap(scratch);
+		}
+
+		slots.resize(count);
+		for (uint32_t i = 0; i < count; i++) {
+			slots[i] = packets[i].slot;
+		}
+		firstInstance = gpuScene.writeInstances(slots.data(), count);
+	}
+
+	void Vk3dRenderQueue::record(VkCommandBuffer commandBuffer, Pass pass, uint32_t pipeline) const {
+		assert(sorted && "Render queue recorded before it was sorted");
+		// the packets of the pipeline are the keys starting with its bits
+		uint64_t firstKey = makeKey(pass, pipeline, 0, 0, 0.f);
+		uint64_t lastKey = firstKey + (uint64_t{ 1 } << PIPELINE_SHIFT);
+		auto keyLess = [](const Packet& packet, uint64_t key) { return packet.key < key; };
+		auto begin = std::lower_bound(packets.begin(), packets.end(), firstKey, keyLess);
+		auto end = std::lower_bound(begin, packets.end(), lastKey, keyLess);
+
+		// one draw for every run of the same model and LOD
+		for (auto first = begin; first != end;) {
+			auto last = first + 1;
+			while (last != end && last->model == first->model && last->lod == first->lod) {
+				++last;
+			}
+			uint32_t instance = firstInstance + static_cast<uint32_t>(first - packets.begin());
+			first->model->draw(commandBuffer, first->lod, static_cast<uint32_t>(last - first), instance);
+			first = last;
+		}
+	}
+
+}
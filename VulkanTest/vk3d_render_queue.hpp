@@ -0,0 +1,66 @@
+#pragma once
+
+#include "vk3d_model.hpp"
+#include "vk3d_gpu_scene.hpp"
+
+// libs
+#include <vulkan/vulkan.h>
+
+// std
+#include <cstdint>
+#include <vector>
+
+namespace vk3d {
+	// Draws of the passes drawn from the CPU. The render systems submit a packet per object and pass once the frame
+	// is culled, the queue sorts them all by a 64-bit key and every pass records its own range. From the most
+	// significant bits the key is:
+	//
+	//   pass (4) | pipeline (4) | mesh (24) | LOD (2) | depth (30)
+	//
+	// so the packets of a pipeline are together, the objects sharing a mesh and LOD are consecutive instances of one
+	// draw, and the instances go front to back, the nearest fill the depth buffer first.
+	class Vk3dRenderQueue {
+	public:
+		enum class Pass : uint32_t {
+			Shadow,	// the pipeline is the cube face
+			Mappings,
+			UVReflection,
+			GBuffer,
+		};
+
+		struct Packet {
+			uint64_t key;
+			const Vk3dModel* model;
+			uint32_t lod;
+			uint32_t slot;
+		};
+
+		Vk3dRenderQueue() = default;
+
+		Vk3dRenderQueue(const Vk3dRenderQueue&) = delete;
+		Vk3dRenderQueue& operator=(const Vk3dRenderQueue&) = delete;
+
+		// Empties the queue, before the systems submit the packets of a frame
+		void clear();
+		// depth is the distance of the object to the view of the pass, only its order matters
+		void submit(Pass pass, uint32_t pipeline, const Vk3dModel* model, uint32_t lod, uint32_t slot, float depth);
+		// Radix sorts the packets and writes their slots to the instances of the frame. After the last submit and
+		// Vk3dGpuScene::update, before the first record.
+		void sort(Vk3dGpuScene& gpuScene);
+		// Draws the packets of the pass and pipeline, one instanced draw per mesh and LOD. The pipeline, the geometry
+		// pool and the object set of the frame must be bound.
+		void record(VkCommandBuffer commandBuffer, Pass pass, uint32_t pipeline = 0) const;
+
+		static uint64_t makeKey(Pass pass, uint32_t pipeline, uint32_t mesh, uint32_t lod, float depth);
+		uint32_t getPacketCount() const { return static_cast<uint32_t>(packets.size()); }
+
+	private:
+		std::vector<Packet> packets;
+		// other half of every radix pass
+		std::vector<Packet> scratch;
+		std::vector<uint32_t> slots;
+		// instance of the first packet
+		uint32_t firstInstance = 0;
+		bool sorted = false;
+	};
+}
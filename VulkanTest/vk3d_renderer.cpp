@@ -1,4 +1,5 @@
 #include "vk3d_renderer.hpp"
+#include "vk3d_profiler.hpp"
 #include <math.h>
 
 #include <stdexcept>
@@ -12,6 +13,7 @@ namespace vk3d {
 	Vk3dRenderer::Vk3dRenderer(Vk3dWindow& window, Vk3dDevice& device, Vk3dAllocator& allocator) : vk3dWindow{ window }, vk3dDevice{ device }, vk3dAllocator{allocator} {
 		recreateSwapChain();
 		createCommandBuffers();
+		gpuProfiler = std::make_unique<Vk3dGpuProfiler>(vk3dDevice, Vk3dSwapChain::MAX_FRAMES_IN_FLIGHT);
 	}
 
 	Vk3dRenderer::~Vk3dRenderer() {
@@ -58,6 +60,7 @@ namespace vk3d {
 	}
 
 	VkCommandBuffer Vk3dRenderer::beginFrame() {
+		VK3D_PROFILE_ZONE("Vk3dRenderer::beginFrame");
 		assert(!isFrameStarted && "Can't call beginFrame while already in progress");
 
 		auto result = vk3dSwapChain->acquireNextImage(&currentImageIndex);
@@ -80,13 +83,18 @@ namespace vk3d {
 		if (vkBeginCommandBuffer(commandBuffer, &beginInfo) != VK_SUCCESS) {
 			throw std::runtime_error("failed to begin recording command buffer");
 		}
+
+		gpuProfiler->beginFrame(commandBuffer, currentFrameIndex);
 		return commandBuffer;
 	}
 
 	void Vk3dRenderer::endFrame() {
+		VK3D_PROFILE_ZONE("Vk3dRenderer::endFrame");
 		assert(isFrameStarted && "Can't call endFrame while frame is not in progress");
 		auto commandBuffer = getCurrentCommandBuffer();
 
+		gpuProfiler->endFrame(commandBuffer);
+
 		if (vkEndCommandBuffer(commandBuffer) != VK_SUCCESS) {
 			throw std::runtime_error("failed to record command buffer!");
 		}
@@ -122,6 +130,7 @@ namespace vk3d {
 		renderPassInfo.clearValueCount = static_cast<uint32_t>(clearValues.size());
 		renderPassInfo.pClearValues = clearValues.data();
 
+		gpuProfiler->beginScope(commandBuffer, "shadow");
 		vkCmdBeginRenderPass(commandBuffer, &renderPassInfo, VK_SUBPASS_CONTENTS_INLINE);
 
 		VkViewport viewport{};
@@ -154,6 +163,38 @@ namespace vk3d {
 		renderPassInfo.clearValueCount = static_cast<uint32_t>(clearValues.size());
 		renderPassInfo.pClearValues = clearValues.data();
 
+		gpuProfiler->beginScope(commandBuffer, "mappings");
+		vkCmdBeginRenderPass(commandBuffer, &renderPassInfo, VK_SUBPASS_CONTENTS_INLINE);
+
+		VkViewport viewport{};
+		viewport.x = 0.0f;
+		viewport.y = 0.0f;
+		viewport.width = static_cast<float>(vk3dSwapChain->getSwapChainExtent().width);
+		viewport.height = static_cast<float>(vk3dSwapChain->getSwapChainExtent().height);
+		viewport.minDepth = 0.0f;
+		viewport.maxDepth = 1.0f;
+		VkRect2D scissor{ {0, 0}, vk3dSwapChain->getSwapChainExtent() };
+		vkCmdSetViewport(commandBuffer, 0, 1, &viewport);
+		vkCmdSetScissor(commandBuffer, 0, 1, &scissor);
+	}
+
+	void Vk3dRenderer::beginMappingsLateRenderPass(VkCommandBuffer commandBuffer) {
+		assert(isFrameStarted && "Can't call beginSwapChainRenderPass if frame is not in progress");
+		assert(commandBuffer == getCurrentCommandBuffer() && "Can't begin render pass on command buffer from a different frame");
+
+		VkRenderPassBeginInfo renderPassInfo{};
+		renderPassInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
+		renderPassInfo.renderPass = vk3dSwapChain->getMappingsLateRenderPass();
+		renderPassInfo.framebuffer = vk3dSwapChain->getMappingsFrameBuffer(currentImageIndex);
+
+		renderPassInfo.renderArea.offset = { 0, 0 };
+		renderPassInfo.renderArea.extent = vk3dSwapChain->getSwapChainExtent();
+
+		// both attachments are loaded
+		renderPassInfo.clearValueCount = 0;
+		renderPassInfo.pClearValues = nullptr;
+
+		gpuProfiler->beginScope(commandBuffer, "mappings_late");
 		vkCmdBeginRenderPass(commandBuffer, &renderPassInfo, VK_SUBPASS_CONTENTS_INLINE);
 
 		VkViewport viewport{};
@@ -186,6 +227,7 @@ namespace vk3d {
 		renderPassInfo.clearValueCount = static_cast<uint32_t>(clearValues.size());
 		renderPassInfo.pClearValues = clearValues.data();
 
+		gpuProfiler->beginScope(commandBuffer, "uv_reflection");
 		vkCmdBeginRenderPass(commandBuffer, &renderPassInfo, VK_SUBPASS_CONTENTS_INLINE);
 
 		VkViewport viewport{};
@@ -220,6 +262,7 @@ namespace vk3d {
 		renderPassInfo.clearValueCount = static_cast<uint32_t>(clearValues.size());
 		renderPassInfo.pClearValues = clearValues.data();
 
+		gpuProfiler->beginScope(commandBuffer, "gbuffer");
 		vkCmdBeginRenderPass(commandBuffer, &renderPassInfo, VK_SUBPASS_CONTENTS_INLINE);
 
 		VkViewport viewport{};
@@ -251,6 +294,7 @@ namespace vk3d {
 		renderPassInfo.clearValueCount = static_cast<uint32_t>(clearValues.size());
 		renderPassInfo.pClearValues = clearValues.data();
 
+		gpuProfiler->beginScope(commandBuffer, "post_processing");
 		vkCmdBeginRenderPass(commandBuffer, &renderPassInfo, VK_SUBPASS_CONTENTS_INLINE);
 
 		VkViewport viewport{};
@@ -265,10 +309,26 @@ namespace vk3d {
 		vkCmdSetScissor(commandBuffer, 0, 1, &scissor);
 	}
 
+	void Vk3dRenderer::nextShadowSubpass(VkCommandBuffer commandBuffer) {
+		assert(isFrameStarted && "Can't call nextShadowSubpass if frame is not in progress");
+		assert(commandBuffer == getCurrentCommandBuffer() && "Can't change subpass on command buffer from a different frame");
+		// the faces are multiview subpasses, the whole pass is timed as a single scope
+		vkCmdNextSubpass(commandBuffer, VK_SUBPASS_CONTENTS_INLINE);
+	}
+
+	void Vk3dRenderer::nextLightingSubpass(VkCommandBuffer commandBuffer) {
+		assert(isFrameStarted && "Can't call nextLightingSubpass if frame is not in progress");
+		assert(commandBuffer == getCurrentCommandBuffer() && "Can't change subpass on command buffer from a different frame");
+		gpuProfiler->endScope(commandBuffer);
+		vkCmdNextSubpass(commandBuffer, VK_SUBPASS_CONTENTS_INLINE);
+		gpuProfiler->beginScope(commandBuffer, "composition");
+	}
+
 	void Vk3dRenderer::endRenderPass(VkCommandBuffer commandBuffer) {
 		assert(isFrameStarted && "Can't call endRenderPass if frame is not in progress");
 		assert(commandBuffer == getCurrentCommandBuffer() && "Can't end render pass on command buffer from a different frame");
 		vkCmdEndRenderPass(commandBuffer);
+		gpuProfiler->endScope(commandBuffer);
 	}
 
 }
\ No newline at end of file
@@ -5,8 +5,10 @@
 #include "vk3d_device.hpp"
 #include "vk3d_swap_chain.hpp"
 #include "vk3d_buffer.hpp"
+#include "vk3d_gpu_profiler.hpp"
 
 #include <cassert>
+#include <memory>
 #include <vector>
 
 
@@ -28,6 +30,7 @@ namespace vk3d {
 		float getShadowAspectRatio() const { return vk3dSwapChain->shadowExtentAspectRatio(); };
 		VkExtent2D getExtent() const { return vk3dSwapChain->getSwapChainExtent(); };
 		std::vector<Vk3dSwapChain::Attachments> getSwapChainAttachments() { return vk3dSwapChain->getAttachments(); };
+		const Vk3dSwapChain::FrameBufferAttachment& getCurrentMappingsDepthAttachment() { return vk3dSwapChain->getMappingsDepthAttachment(currentImageIndex); };
 		bool isFrameInProgress() const { return isFrameStarted; }
 
 		VkCommandBuffer getCurrentCommandBuffer() const {
@@ -43,12 +46,21 @@ namespace vk3d {
 		size_t getCurrentFrame() { return vk3dSwapChain->getCurrentFrame(); }
 		size_t getCurrentImageIndex() { return currentImageIndex; }
 
+		// GPU time in milliseconds of the last frame whose timestamps are available, negative if there is none yet
+		double getLastGpuFrameTime() const { return gpuProfiler->getLastFrameTime(); }
+		Vk3dGpuProfiler& getGpuProfiler() { return *gpuProfiler; }
+
 		VkCommandBuffer beginFrame();
 		void endFrame();
 		void beginShadowRenderPass(VkCommandBuffer commandBuffer);
+		// The shadow pass has a subpass per cube face, in Vk3dSwapChain::NUM_CUBE_FACES order
+		void nextShadowSubpass(VkCommandBuffer commandBuffer);
 		void beginMappingsRenderPass(VkCommandBuffer commandBuffer);
+		// Draws on top of what the mappings pass left, for the objects the occlusion culler found in its late phase
+		void beginMappingsLateRenderPass(VkCommandBuffer commandBuffer);
 		void beginUVReflectionRenderPass(VkCommandBuffer commandBuffer);
 		void beginLightingRenderPass(VkCommandBuffer commandBuffer);
+		void nextLightingSubpass(VkCommandBuffer commandBuffer);
 		void beginPostProcessingRenderPass(VkCommandBuffer commandBuffer);
 		void endRenderPass(VkCommandBuffer commandBuffer);
 
@@ -81,6 +93,7 @@ namespace vk3d {
 		Vk3dAllocator& vk3dAllocator;
 		std::unique_ptr<Vk3dSwapChain> vk3dSwapChain;
 		std::vector<VkCommandBuffer> commandBuffers;
+		std::unique_ptr<Vk3dGpuProfiler> gpuProfiler;
 
 		uint32_t currentImageIndex;
 		int currentFrameIndex{ 0 };
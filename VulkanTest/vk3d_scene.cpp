@@ -0,0 +1,315 @@
+#include "vk3d_scene.hpp"
+
+#include "vk3d_transform_kernel.hpp"
+#include "vk3d_profiler.hpp"
+
+// std
+#include <algorithm>
+#include <cassert>
+
+namespace vk3d {
+
+	Vk3dScene::Handle Vk3dScene::createObject(const TransformComponent& transform, Handle parent) {
+		uint32_t slot;
+		if (freeSlots.empty()) {
+			slot = static_cast<uint32_t>(slots.size());
+			slots.push_back({ INVALID_INDEX, 0 });
+			slotChanged.push_back(0);
+		}
+		else {
+			slot = freeSlots.back();
+			freeSlots.pop_back();
+		}
+
+		uint32_t parentIndex = parent != Handle{} ? getIndex(parent) : INVALID_INDEX;
+		uint32_t index = parentIndex != INVALID_INDEX ? parentIndex + subtreeSizes[parentIndex] : getObjectCount();
+		forEachArray([index](auto& array) {
+			array.emplace(array.begin() + index);
+		});
+
+		// everything behind the new object moved up by one
+		for (uint32_t i = index + 1; i < getObjectCount(); i++) {
+			if (indexSlots[i] != INVALID_INDEX) {
+				slots[indexSlots[i]].index = i;
+			}
+			if (parents[i] != INVALID_INDEX && parents[i] >= index) {
+				parents[i]++;
+			}
+		}
+		for (uint32_t& dirtyIndex : dirtyIndices) {
+			if (dirtyIndex >= index) {
+				dirtyIndex++;
+			}
+		}
+		for (uint32_t ancestor = parentIndex; ancestor != INVALID_INDEX; ancestor = parents[ancestor]) {
+			subtreeSizes[ancestor]++;
+		}
+
+		slots[slot].index = index;
+		translations[index] = transform.translation;
+		rotations[index] = transform.rotation;
+		scales[index] = transform.scale;
+		parents[index] = parentIndex;
+		subtreeSizes[index] = 1;
+		reflections[index] = 0.f;
+		indexSlots[index] = slot;
+		proxies[index] = Vk3dAabbTree::NULL_NODE;
+		markDirty(index);
+
+		return { slot, slots[slot].generation };
+	}
+
+	void Vk3dScene::destroyObject(Handle handle) {
+		uint32_t index = getIndex(handle);
+		for (uint32_t i = index; i < index + subtreeSizes[index]; i++) {
+			// destroyed on its own before
+			if (indexSlots[i] == INVALID_INDEX) {
+				continue;
+			}
+			models[i].reset();
+			markChanged(indexSlots[i]);
+			if (proxies[i] != Vk3dAabbTree::NULL_NODE) {
+				boundsTree.destroyProxy(proxies[i]);
+				proxies[i] = Vk3dAabbTree::NULL_NODE;
+			}
+
+			Slot& slot = slots[indexSlots[i]];
+			slot.index = INVALID_INDEX;
+			slot.generation++;
+			freeSlots.push_back(indexSlots[i]);
+			indexSlots[i] = INVALID_INDEX;
+			destroyedCount++;
+		}
+	}
+
+	void Vk3dScene::compact() {
+		if (destroyedCount == 0) {
+			return;
+		}
+
+		// new index of every object, the remaining ones keep their order so subtrees stay contiguous
+		std::vector<uint32_t> remap(getObjectCount());
+		uint32_t count = 0;
+		for (uint32_t i = 0; i < getObjectCount(); i++) {
+			remap[i] = indexSlots[i] != INVALID_INDEX ? count++ : INVALID_INDEX;
+		}
+		for (uint32_t i = 0; i < getObjectCount(); i++) {
+			if (remap[i] != INVALID_INDEX && remap[i] != i) {
+				uint32_t to = remap[i];
+				forEachArray([i, to](auto& array) {
+					array[to] = std::move(array[i]);
+				});
+			}
+		}
+		forEachArray([count](auto& array) {
+			array.resize(count);
+		});
+
+		// a destroyed object takes its subtree along, so the parent of every remaining object remains too
+		dirtyIndices.clear();
+		for (uint32_t i = 0; i < count; i++) {
+			slots[indexSlots[i]].index = i;
+			parents[i] = parents[i] != INVALID_INDEX ? remap[parents[i]] : INVALID_INDEX;
+			subtreeSizes[i] = 1;
+			if (dirty[i]) {
+				dirtyIndices.push_back(i);
+			}
+		}
+		for (uint32_t i = count; i-- > 0;) {
+			if (parents[i] != INVALID_INDEX) {
+				subtreeSizes[parents[i]] += subtreeSizes[i];
+			}
+		}
+		destroyedCount = 0;
+	}
+
+	bool Vk3dScene::isValid(Handle handle) const {
+		return handle.slot < slots.size() && slots[handle.slot].generation == handle.generation && slots[handle.slot].index != INVALID_INDEX;
+	}
+
+	uint32_t Vk3dScene::getIndex(Handle handle) const {
+		assert(isValid(handle) && "Stale or invalid scene handle");
+		return slots[handle.slot].index;
+	}
+
+	void Vk3dScene::markDirty(uint32_t index) {
+		if (!dirty[index]) {
+			dirty[index] = 1;
+			dirtyIndices.push_back(index);
+		}
+	}
+
+	void Vk3dScene::markChanged(uint32_t slot) {
+		if (!slotChanged[slot]) {
+			slotChanged[slot] = 1;
+			changedSlots.push_back(slot);
+		}
+	}
+
+	void Vk3dScene::clearChangedSlots() {
+		for (uint32_t slot : changedSlots) {
+			slotChanged[slot] = 0;
+		}
+		changedSlots.clear();
+	}
+
+	void Vk3dScene::setTransform(uint32_t index, const TransformComponent& transform) {
+		translations[index] = transform.translation;
+		rotations[index] = transform.rotation;
+		scales[index] = transform.scale;
+		markDirty(index);
+	}
+
+	void Vk3dScene::setTranslation(uint32_t index, const glm::vec3& translation) {
+		translations[index] = translation;
+		markDirty(index);
+	}
+
+	void Vk3dScene::setRotation(uint32_t index, const glm::vec3& rotation) {
+		rotations[index] = rotation;
+		markDirty(index);
+	}
+
+	void Vk3dScene::setScale(uint32_t index, const glm::vec3& scale) {
+		scales[index] = scale;
+		markDirty(index);
+	}
+
+	void Vk3dScene::setModel(uint32_t index, std::shared_ptr<Vk3dModel> model) {
+		models[index] = std::move(model);
+		markDirty(index);
+	}
+
+	void Vk3dScene::setReflection(uint32_t index, float reflection) {
+		reflections[index] = reflection;
+		markChanged(indexSlots[index]);
+	}
+
+	uint32_t Vk3dScene::updateMatrices() {
+		if (dirtyIndices.empty()) {
+			return 0;
+		}
+
+		// in order, so an ancestor is visited before the dirty objects of its subtree
+		std::sort(dirtyIndices.begin(), dirtyIndices.end());
+		Vk3dTransformKernel::computeMatrices(translations.data(), rotations.data(), scales.data(), dirtyIndices.data(),
+			static_cast<uint32_t>(dirtyIndices.size()), localMatrices.data(), localNormalMatrices.data());
+
+		// the normal matrix of a product is the product of the normal matrices, so both propagate the same way
+		uint32_t updated = 0;
+		uint32_t subtreeEnd = 0;
+		for (uint32_t index : dirtyIndices) {
+			dirty[index] = 0;
+			// already updated with the subtree of a dirty ancestor
+			if (index < subtreeEnd) {
+				continue;
+			}
+
+			subtreeEnd = index + subtreeSizes[index];
+			for (uint32_t i = index; i < subtreeEnd; i++) {
+				uint32_t parent = parents[i];
+				if (parent == INVALID_INDEX) {
+					worldMatrices[i] = localMatrices[i];
+					normalMatrices[i] = localNormalMatrices[i];
+				}
+				else {
+					worldMatrices[i] = worldMatrices[parent] * localMatrices[i];
+					normalMatrices[i] = normalMatrices[parent] * localNormalMatrices[i];
+				}
+				updateBounds(i);
+			}
+			updated += subtreeEnd - index;
+		}
+		dirtyIndices.clear();
+		return updated;
+	}
+
+	void Vk3dScene::updateBounds(uint32_t index) {
+		if (indexSlots[index] != INVALID_INDEX) {
+			markChanged(indexSlots[index]);
+		}
+		// destroyed objects keep no proxy, their model is null
+		if (!models[index]) {
+			if (proxies[index] != Vk3dAabbTree::NULL_NODE) {
+				boundsTree.destroyProxy(proxies[index]);
+				proxies[index] = Vk3dAabbTree::NULL_NODE;
+			}
+			return;
+		}
+
+		worldBounds[index] = models[index]->getBounds().transform(worldMatrices[index]);
+		if (proxies[index] == Vk3dAabbTree::NULL_NODE) {
+			proxies[index] = boundsTree.createProxy(worldBounds[index], indexSlots[index]);
+		}
+		else {
+			boundsTree.moveProxy(proxies[index], worldBounds[index]);
+		}
+	}
+
+	const glm::mat4& Vk3dScene::getWorldMatrix(uint32_t index) const {
+		assert(dirtyIndices.empty() && "World matrix read before updateMatrices");
+		return worldMatrices[index];
+	}
+
+	const glm::mat3& Vk3dScene::getNormalMatrix(uint32_t index) const {
+		assert(dirtyIndices.empty() && "Normal matrix read before updateMatrices");
+		return normalMatrices[index];
+	}
+
+	Vk3dSphere Vk3dScene::getWorldBoundingSphere(uint32_t index) const {
+		const auto& model = models[index];
+		assert(model && "Bounding sphere of an object without a model");
+		const glm::mat4& worldMatrix = getWorldMatrix(index);
+		glm::vec3 center{ worldMatrix * glm::vec4(model->getBoundingCenter(), 1.f) };
+		// largest world scale, the parents included
+		float scale = glm::max(glm::length(glm::vec3{ worldMatrix[0] }), glm::max(glm::length(glm::vec3{ worldMatrix[1] }), glm::length(glm::vec3{ worldMatrix[2] })));
+		return { center, model->getBoundingRadius() * scale };
+	}
+
+	uint32_t Vk3dScene::selectLod(uint32_t index, const glm::vec3& viewPosition, float projectionScale) const {
+		const auto& model = models[index];
+		if (!model || model->getLodCount() <= 1) {
+			return 0;
+		}
+
+		Vk3dSphere sphere = getWorldBoundingSphere(index);
+		float distance = glm::length(sphere.center - viewPosition);
+		if (distance <= sphere.radius) {
+			return 0;
+		}
+
+		float screenSize = sphere.radius * projectionScale / distance;
+		float threshold = LOD_SCREEN_SIZE;
+		uint32_t lod = 0;
+		while (lod + 1 < model->getLodCount() && screenSize < threshold) {
+			lod++;
+			threshold *= .5f;
+		}
+		return lod;
+	}
+
+	void Vk3dScene::cullFrustum(const Vk3dFrustum& frustum, std::vector<uint32_t>& visible) const {
+		VK3D_PROFILE_ZONE("Vk3dScene::cullFrustum");
+		assert(dirtyIndices.empty() && "Scene culled before updateMatrices");
+		visible.clear();
+		boundsTree.queryFrustum(frustum, visible);
+		toSortedIndices(visible);
+	}
+
+	void Vk3dScene::cullSphere(const Vk3dSphere& sphere, std::vector<uint32_t>& visible) const {
+		VK3D_PROFILE_ZONE("Vk3dScene::cullSphere");
+		assert(dirtyIndices.empty() && "Scene culled before updateMatrices");
+		visible.clear();
+		boundsTree.querySphere(sphere, visible);
+		toSortedIndices(visible);
+	}
+
+	void Vk3dScene::toSortedIndices(std::vector<uint32_t>& visible) const {
+		for (uint32_t& object : visible) {
+			object = slots[object].index;
+		}
+		// the passes walk the arrays in order
+		std::sort(visible.begin(), visible.end());
+	}
+
+}
@@ -0,0 +1,179 @@
+#pragma once
+
+#include "vk3d_model.hpp"
+#include "vk3d_game_object.hpp"
+#include "vk3d_aabb_tree.hpp"
+
+// libs
+#include <glm/glm.hpp>
+
+// std
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+namespace vk3d {
+	// Components of every drawable object in dense arrays, one element per object, so the render systems walk
+	// them linearly. Objects are addressed through generational handles: a handle survives other objects being
+	// destroyed and moved around, and a stale one is detected instead of reaching whatever reused its slot.
+	//
+	// Objects form a hierarchy, their transform is relative to their parent. The arrays are kept in depth first order,
+	// every object is followed by its whole subtree, so a parent always comes before its children and a subtree is a
+	// contiguous range. World and normal matrices are cached per object; updateMatrices only walks the subtrees of
+	// the objects whose transform changed.
+	//
+	// The world bounding box of every object with a model is kept in an AABB tree, refreshed along with its matrices,
+	// so culling a view visits the tree instead of every object.
+	//
+	// Slots never move either, Vk3dGpuScene keeps the data the GPU draws every object with in a buffer indexed by slot.
+	// The scene records which slots changed, so only those are uploaded.
+	class Vk3dScene {
+	public:
+		// LOD 0 is drawn while the bounding sphere radius covers this fraction of half the viewport height,
+		// every further LOD is used below half the size of the previous one
+		static constexpr float LOD_SCREEN_SIZE = 0.25f;
+		static constexpr uint32_t INVALID_INDEX = UINT32_MAX;
+
+		struct Handle {
+			uint32_t slot = INVALID_INDEX;
+			uint32_t generation = 0;
+
+			bool operator==(const Handle& other) const { return slot == other.slot && generation == other.generation; }
+			bool operator!=(const Handle& other) const { return !(*this == other); }
+		};
+
+		Vk3dScene() = default;
+
+		Vk3dScene(const Vk3dScene&) = delete;
+		Vk3dScene& operator=(const Vk3dScene&) = delete;
+
+		// transform is relative to parent, a default handle creates a root object. Children are inserted
+		// after the subtree of their parent, which moves the objects behind it.
+		Handle createObject(const TransformComponent& transform = {}, Handle parent = Handle{ INVALID_INDEX, 0 });
+		// Destroys the object and its whole subtree. Their handles are invalid and they aren't drawn anymore
+		// right away, their components are removed by compact.
+		void destroyObject(Handle handle);
+		// Removes the destroyed objects, keeping the order of the others. Call it once per frame outside of any loop over the objects.
+		void compact();
+
+		bool isValid(Handle handle) const;
+		// Dense index of a valid handle, only stable until the next createObject or compact
+		uint32_t getIndex(Handle handle) const;
+		// Includes the objects destroyed since the last compact, their model is null
+		uint32_t getObjectCount() const { return static_cast<uint32_t>(translations.size()); }
+
+		// Dense components, indexed from 0 to getObjectCount(). Transforms change through the setters so the matrices follow.
+		const glm::vec3* getTranslations() const { return translations.data(); }
+		const glm::vec3* getRotations() const { return rotations.data(); }
+		const glm::vec3* getScales() const { return scales.data(); }
+		// Dense index of the parent, INVALID_INDEX for roots
+		const uint32_t* getParents() const { return parents.data(); }
+		// Null while the model is still streaming in, and for objects only used to group others
+		const std::shared_ptr<Vk3dModel>* getModels() const { return models.data(); }
+		const float* getReflections() const { return reflections.data(); }
+		// Slot of every dense index, INVALID_INDEX once destroyed
+		const uint32_t* getIndexSlots() const { return indexSlots.data(); }
+
+		void setTransform(uint32_t index, const TransformComponent& transform);
+		void setTranslation(uint32_t index, const glm::vec3& translation);
+		void setRotation(uint32_t index, const glm::vec3& rotation);
+		void setScale(uint32_t index, const glm::vec3& scale);
+		// The bounds of the object follow on the next updateMatrices
+		void setModel(uint32_t index, std::shared_ptr<Vk3dModel> model);
+		void setReflection(uint32_t index, float reflection);
+
+		// Slots ever used, free ones included
+		uint32_t getSlotCount() const { return static_cast<uint32_t>(slots.size()); }
+		// Dense index of the object in the slot, INVALID_INDEX while it is free
+		uint32_t getSlotIndex(uint32_t slot) const { return slots[slot].index; }
+		// Slots whose object was created, destroyed, moved, or got another model or reflection since clearChangedSlots,
+		// each listed once. Moves are recorded by updateMatrices.
+		const std::vector<uint32_t>& getChangedSlots() const { return changedSlots; }
+		void clearChangedSlots();
+
+		// Rebuilds the matrices of the objects whose transform changed since the last call and of everything below them,
+		// call it once per frame before the passes. Returns the number of world matrices updated.
+		uint32_t updateMatrices();
+		const glm::mat4& getWorldMatrix(uint32_t index) const;
+		const glm::mat3& getNormalMatrix(uint32_t index) const;
+		// Bounding sphere of the model with the world matrix applied, scaled by its largest axis
+		Vk3dSphere getWorldBoundingSphere(uint32_t index) const;
+		// projectionScale is the [1][1] entry of the projection matrix (1 / tan(fovy / 2)), passes can scale it down to get coarser LODs
+		uint32_t selectLod(uint32_t index, const glm::vec3& viewPosition, float projectionScale) const;
+
+		// Replaces visible with the dense indices of the objects with a model whose bounds intersect the frustum, in
+		// increasing order. Only valid until the next createObject or compact, like every dense index.
+		void cullFrustum(const Vk3dFrustum& frustum, std::vector<uint32_t>& visible) const;
+		// Same as cullFrustum, for the objects whose bounds intersect the sphere
+		void cullSphere(const Vk3dSphere& sphere, std::vector<uint32_t>& visible) const;
+		// World bounding box of every object with a model, as of the last updateMatrices
+		const Vk3dAabb* getWorldBounds() const { return worldBounds.data(); }
+		// Objects with a model, the ones culling can return
+		uint32_t getDrawableCount() const { return boundsTree.getProxyCount(); }
+
+	private:
+		struct Slot {
+			// INVALID_INDEX while the slot is free
+			uint32_t index;
+			uint32_t generation;
+		};
+
+		// Calls fn with every per object array, to insert, move or remove an object in all of them at once
+		template <typename Fn>
+		void forEachArray(Fn&& fn) {
+			fn(translations);
+			fn(rotations);
+			fn(scales);
+			fn(parents);
+			fn(subtreeSizes);
+			fn(models);
+			fn(reflections);
+			fn(localMatrices);
+			fn(localNormalMatrices);
+			fn(worldMatrices);
+			fn(normalMatrices);
+			fn(dirty);
+			fn(indexSlots);
+			fn(proxies);
+			fn(worldBounds);
+		}
+
+		void markDirty(uint32_t index);
+		void markChanged(uint32_t slot);
+		void updateBounds(uint32_t index);
+		// Turns the slots returned by a tree query into sorted dense indices
+		void toSortedIndices(std::vector<uint32_t>& visible) const;
+
+		std::vector<glm::vec3> translations;
+		std::vector<glm::vec3> rotations;
+		std::vector<glm::vec3> scales;
+		std::vector<uint32_t> parents;
+		// the object and its descendants, which follow it in the arrays
+		std::vector<uint32_t> subtreeSizes;
+		std::vector<std::shared_ptr<Vk3dModel>> models;
+		std::vector<float> reflections;
+		// relative to the parent
+		std::vector<glm::mat4> localMatrices;
+		std::vector<glm::mat3> localNormalMatrices;
+		std::vector<glm::mat4> worldMatrices;
+		std::vector<glm::mat3> normalMatrices;
+		// the transform changed since updateMatrices, vector<bool> isn't used to keep it a plain byte array
+		std::vector<uint8_t> dirty;
+		// slot of every dense index, INVALID_INDEX once destroyed
+		std::vector<uint32_t> indexSlots;
+		// leaf of the object in boundsTree, NULL_NODE without a model
+		std::vector<uint32_t> proxies;
+		std::vector<Vk3dAabb> worldBounds;
+
+		// objects with dirty set, in no particular order
+		std::vector<uint32_t> dirtyIndices;
+		std::vector<Slot> slots;
+		std::vector<uint32_t> freeSlots;
+		std::vector<uint32_t> changedSlots;
+		// per slot, set while it is in changedSlots
+		std::vector<uint8_t> slotChanged;
+		uint32_t destroyedCount = 0;
+		// proxies hold the slot of their object, which doesn't change when objects move in the arrays
+		Vk3dAabbTree boundsTree;
+	};
+}
@@ -1,4 +1,5 @@
 #include "vk3d_swap_chain.hpp"
+#include "vk3d_profiler.hpp"
 
 // std
 #include <array>
@@ -46,8 +47,16 @@ void Vk3dSwapChain::init() {
 }
 
 Vk3dSwapChain::~Vk3dSwapChain() {
-  for (auto imageView : swapChainImageViews) {
-    vkDestroyImageView(device.device(), imageView, nullptr);
+  if (device.isHeadless()) {
+    // image views are owned by the offscreen attachments
+    for (auto& offscreenImage : offscreenImages) {
+      destroyAttachment(&offscreenImage);
+    }
+    offscreenImages.clear();
+  } else {
+    for (auto imageView : swapChainImageViews) {
+      vkDestroyImageView(device.device(), imageView, nullptr);
+    }
   }
   swapChainImageViews.clear();
 
@@ -98,6 +107,7 @@ Vk3dSwapChain::~Vk3dSwapChain() {
   vkDestroyRenderPass(device.device(), lightingRenderPass, nullptr);
   vkDestroyRenderPass(device.device(), uvReflectionRenderPass, nullptr);
   vkDestroyRenderPass(device.device(), mappingsRenderPass, nullptr);
+  vkDestroyRenderPass(device.device(), mappingsLateRenderPass, nullptr);
   vkDestroyRenderPass(device.device(), shadowRenderPass, nullptr);
 
   // cleanup synchronization objects
@@ -109,12 +119,22 @@ Vk3dSwapChain::~Vk3dSwapChain() {
 }
 
 VkResult Vk3dSwapChain::acquireNextImage(uint32_t *imageIndex) {
-  vkWaitForFences(
-      device.device(),
-      1,
-      &inFlightFences[currentFrame],
-      VK_TRUE,
-      std::numeric_limits<uint64_t>::max());
+  VK3D_PROFILE_ZONE("Vk3dSwapChain::acquireNextImage");
+  {
+    VK3D_PROFILE_ZONE("wait in flight fence");
+    vkWaitForFences(
+        device.device(),
+        1,
+        &inFlightFences[currentFrame],
+        VK_TRUE,
+        std::numeric_limits<uint64_t>::max());
+  }
+
+  if (device.isHeadless()) {
+    // offscreen images are bound to their frame in flight
+    *imageIndex = static_cast<uint32_t>(currentFrame);
+    return VK_SUCCESS;
+  }
 
   VkResult result = vkAcquireNextImageKHR(
       device.device(),
@@ -129,7 +149,9 @@ VkResult Vk3dSwapChain::acquireNextImage(uint32_t *imageIndex) {
 
 VkResult Vk3dSwapChain::submitCommandBuffers(
     const VkCommandBuffer *buffers, uint32_t *imageIndex) {
+  VK3D_PROFILE_ZONE("Vk3dSwapChain::submitCommandBuffers");
   if (imagesInFlight[*imageIndex] != VK_NULL_HANDLE) {
+    VK3D_PROFILE_ZONE("wait image fence");
     vkWaitForFences(device.device(), 1, &imagesInFlight[*imageIndex], VK_TRUE, UINT64_MAX);
   }
   imagesInFlight[*imageIndex] = inFlightFences[currentFrame];
@@ -137,6 +159,22 @@ VkResult Vk3dSwapChain::submitCommandBuffers(
   VkSubmitInfo submitInfo = {};
   submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
 
+  if (device.isHeadless()) {
+    submitInfo.commandBufferCount = 1;
+    submitInfo.pCommandBuffers = buffers;
+
+    vkResetFences(device.device(), 1, &inFlightFences[currentFrame]);
+
+    if (vkQueueSubmit(device.graphicsQueue(), 1, &submitInfo, inFlightFences[currentFrame]) !=
+        VK_SUCCESS) {
+      throw std::runtime_error("failed to submit draw command buffer!");
+    }
+
+    currentFrame = (currentFrame + 1) % MAX_FRAMES_IN_FLIGHT;
+
+    return VK_SUCCESS;
+  }
+
   VkSemaphore waitSemaphores[] = {imageAvailableSemaphores[currentFrame]};
   VkPipelineStageFlags waitStages[] = {VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT};
   submitInfo.waitSemaphoreCount = 1;
@@ -169,7 +207,11 @@ VkResult Vk3dSwapChain::submitCommandBuffers(
 
   presentInfo.pImageIndices = imageIndex;
 
-  auto result = vkQueuePresentKHR(device.presentQueue(), &presentInfo);
+  VkResult result;
+  {
+    VK3D_PROFILE_ZONE("vkQueuePresentKHR");
+    result = vkQueuePresentKHR(device.presentQueue(), &presentInfo);
+  }
 
   currentFrame = (currentFrame + 1) % MAX_FRAMES_IN_FLIGHT;
 
@@ -177,6 +219,11 @@ VkResult Vk3dSwapChain::submitCommandBuffers(
 }
 
 void Vk3dSwapChain::createSwapChain() {
+  if (device.isHeadless()) {
+    createOffscreenImages();
+    return;
+  }
+
   SwapChainSupportDetails swapChainSupport = device.getSwapChainSupport();
 
   VkSurfaceFormatKHR surfaceFormat = chooseSwapSurfaceFormat(swapChainSupport.formats);
@@ -240,7 +287,29 @@ void Vk3dSwapChain::createSwapChain() {
   attachmentsVector.resize(imageCount);
 }
 
+void Vk3dSwapChain::createOffscreenImages() {
+  // Without a surface the post processing pass renders into one offscreen image per frame in flight
+  swapChainImageFormat = HEADLESS_IMAGE_FORMAT;
+  swapChainExtent = windowExtent;
+
+  offscreenImages.resize(MAX_FRAMES_IN_FLIGHT);
+  for (auto& offscreenImage : offscreenImages) {
+    createAttachment(swapChainImageFormat, VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT, &offscreenImage, swapChainExtent);
+    swapChainImages.push_back(offscreenImage.image);
+  }
+
+  samplersVector.resize(offscreenImages.size());
+  attachmentsVector.resize(offscreenImages.size());
+}
+
 void Vk3dSwapChain::createSwapChainImageViews() {
+  if (device.isHeadless()) {
+    for (auto& offscreenImage : offscreenImages) {
+      swapChainImageViews.push_back(offscreenImage.view);
+    }
+    return;
+  }
+
   swapChainImageViews.resize(swapChainImages.size());
   for (size_t i = 0; i < swapChainImages.size(); i++) {
     VkImageViewCreateInfo viewInfo{};
@@ -298,36 +367,43 @@ void Vk3dSwapChain::createShadowRenderPass() {
     attachments[1].finalLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
     attachments[1].flags = 0;
 
-    // One subpass
-    std::array<VkSubpassDescription, 1> subpassDescriptions{};
+    // One subpass per cube face, each renders a single view so the casters can be drawn only into the faces they touch.
+    // The faces are different layers of the attachments, the subpasses don't depend on each other.
+    std::array<VkSubpassDescription, NUM_CUBE_FACES> subpassDescriptions{};
 
     VkAttachmentReference colorReferences[1];
     colorReferences[0] = { 0, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL };
     VkAttachmentReference depthReference = { 1, VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL };
 
-    subpassDescriptions[0].pipelineBindPoint = VK_PIPELINE_BIND_POINT_GRAPHICS;
-    subpassDescriptions[0].colorAttachmentCount = 1;
-    subpassDescriptions[0].pColorAttachments = colorReferences;
-    subpassDescriptions[0].pDepthStencilAttachment = &depthReference;
-
-    // Subpass dependencies for layout transitions
-    std::array<VkSubpassDependency, 2> dependencies;
-
-    dependencies[0].srcSubpass = VK_SUBPASS_EXTERNAL;
-    dependencies[0].dstSubpass = 0;
-    dependencies[0].srcStageMask = VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT;
-    dependencies[0].dstStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT | VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT;
-    dependencies[0].srcAccessMask = 0;
-    dependencies[0].dstAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
-    dependencies[0].dependencyFlags = VK_DEPENDENCY_BY_REGION_BIT;
+    for (auto& subpassDescription : subpassDescriptions) {
+        subpassDescription.pipelineBindPoint = VK_PIPELINE_BIND_POINT_GRAPHICS;
+        subpassDescription.colorAttachmentCount = 1;
+        subpassDescription.pColorAttachments = colorReferences;
+        subpassDescription.pDepthStencilAttachment = &depthReference;
+    }
 
-    dependencies[1].srcSubpass = 0;
-    dependencies[1].dstSubpass = VK_SUBPASS_EXTERNAL;
-    dependencies[1].srcStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT | VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT;
-    dependencies[1].dstStageMask = VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT;
-    dependencies[1].srcAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
-    dependencies[1].dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
-    dependencies[1].dependencyFlags = VK_DEPENDENCY_BY_REGION_BIT;
+    // Subpass dependencies for layout transitions, into and out of every face
+    std::array<VkSubpassDependency, 2 * NUM_CUBE_FACES> dependencies;
+
+    for (int face = 0; face < NUM_CUBE_FACES; face++) {
+        VkSubpassDependency& in = dependencies[2 * face];
+        in.srcSubpass = VK_SUBPASS_EXTERNAL;
+        in.dstSubpass = face;
+        in.srcStageMask = VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT;
+        in.dstStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT | VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT;
+        in.srcAccessMask = 0;
+        in.dstAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
+        in.dependencyFlags = VK_DEPENDENCY_BY_REGION_BIT;
+
+        VkSubpassDependency& out = dependencies[2 * face + 1];
+        out.srcSubpass = face;
+        out.dstSubpass = VK_SUBPASS_EXTERNAL;
+        out.srcStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT | VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT;
+        out.dstStageMask = VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT;
+        out.srcAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
+        out.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+        out.dependencyFlags = VK_DEPENDENCY_BY_REGION_BIT;
+    }
 
     VkRenderPassCreateInfo renderPassInfo = {};
     renderPassInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_CREATE_INFO;
@@ -338,14 +414,19 @@ void Vk3dSwapChain::createShadowRenderPass() {
     renderPassInfo.dependencyCount = dependencies.size();
     renderPassInfo.pDependencies = dependencies.data();
 
-    uint32_t viewAndCorrelationMask = 0b00111111; //6 faces
+    // subpass i renders view i, the cube face of layer i
+    std::array<uint32_t, NUM_CUBE_FACES> viewMasks;
+    for (int face = 0; face < NUM_CUBE_FACES; face++) {
+        viewMasks[face] = 1u << face;
+    }
+    uint32_t correlationMask = 0b00111111; //6 faces
 
     VkRenderPassMultiviewCreateInfo renderPassMultiviewInfo{};
     renderPassMultiviewInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_MULTIVIEW_CREATE_INFO;
-    renderPassMultiviewInfo.subpassCount = 1;
-    renderPassMultiviewInfo.pViewMasks = &viewAndCorrelationMask;
+    renderPassMultiviewInfo.subpassCount = static_cast<uint32_t>(viewMasks.size());
+    renderPassMultiviewInfo.pViewMasks = viewMasks.data();
     renderPassMultiviewInfo.correlationMaskCount = 1;
-    renderPassMultiviewInfo.pCorrelationMasks = &viewAndCorrelationMask;
+    renderPassMultiviewInfo.pCorrelationMasks = &correlationMask;
 
     renderPassInfo.pNext = &renderPassMultiviewInfo;
 
@@ -385,7 +466,8 @@ void Vk3dSwapChain::createMappingsSampler() {
     }
 
     for (auto& attachments : attachmentsVector) {
-        createAttachment(findDepthFormat(), VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT, &attachments.mappingsMapDepth, swapChainExtent, VK_IMAGE_VIEW_TYPE_2D_ARRAY, MAPPINGS_ARRAY_LENGTH);
+        // sampled by Vk3dGpuCuller to build its depth pyramid
+        createAttachment(findDepthFormat(), VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT | VK_IMAGE_USAGE_SAMPLED_BIT, &attachments.mappingsMapDepth, swapChainExtent, VK_IMAGE_VIEW_TYPE_2D_ARRAY, MAPPINGS_ARRAY_LENGTH);
     }
 }
 
@@ -468,6 +550,21 @@ void Vk3dSwapChain::createMappingsRenderPass() {
     if (vkCreateRenderPass(device.device(), &renderPassInfo, nullptr, &mappingsRenderPass) != VK_SUCCESS) {
         throw std::runtime_error("failed to create render pass!");
     }
+
+    // Late pass: draws the objects the occlusion culler found visible in its second phase on top of the first pass,
+    // compatible with the mappings framebuffers. The depth comes back from the pyramid build as an attachment.
+    attachments[0].loadOp = VK_ATTACHMENT_LOAD_OP_LOAD;
+    attachments[0].initialLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+    attachments[1].loadOp = VK_ATTACHMENT_LOAD_OP_LOAD;
+    attachments[1].initialLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
+
+    dependencies[0].srcStageMask = VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT | VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT;
+    dependencies[0].dstAccessMask = VK_ACCESS_COLOR_ATTACHMENT_READ_BIT | VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT |
+        VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_READ_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
+
+    if (vkCreateRenderPass(device.device(), &renderPassInfo, nullptr, &mappingsLateRenderPass) != VK_SUCCESS) {
+        throw std::runtime_error("failed to create render pass!");
+    }
 }
 
 void Vk3dSwapChain::createMappingsFramebuffers() {
@@ -768,7 +865,7 @@ void Vk3dSwapChain::createPostProcessingRenderPass() {
     attachments[0].stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
     attachments[0].stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
     attachments[0].initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
-    attachments[0].finalLayout = VK_IMAGE_LAYOUT_PRESENT_SRC_KHR;
+    attachments[0].finalLayout = device.isHeadless() ? VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL : VK_IMAGE_LAYOUT_PRESENT_SRC_KHR;
    
     std::array<VkSubpassDescription, 1> subpassDescriptions{};
 
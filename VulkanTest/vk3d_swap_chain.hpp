@@ -99,6 +99,8 @@ class Vk3dSwapChain {
 
   static constexpr VkFilter DEFAULT_SHADOWMAP_FILTER = VK_FILTER_LINEAR;
 
+  static constexpr VkFormat HEADLESS_IMAGE_FORMAT = VK_FORMAT_B8G8R8A8_UNORM;
+
   Vk3dSwapChain(Vk3dDevice &deviceRef, Vk3dAllocator& allocatorRef, VkExtent2D windowExtent);
   Vk3dSwapChain(Vk3dDevice& deviceRef, Vk3dAllocator& allocatorRef, VkExtent2D windowExtent, std::shared_ptr<Vk3dSwapChain> previous);
   ~Vk3dSwapChain();
@@ -113,6 +115,8 @@ class Vk3dSwapChain {
   VkFramebuffer getPostProcessingFrameBuffer(int index) { return postProcessingFramebuffers[index]; }
   VkRenderPass getShadowRenderPass() { return shadowRenderPass; }
   VkRenderPass getMappingsRenderPass() { return mappingsRenderPass; }
+  // Loads the attachments of the mappings pass instead of clearing them, uses the same framebuffers
+  VkRenderPass getMappingsLateRenderPass() { return mappingsLateRenderPass; }
   VkRenderPass getUVReflectionRenderPass() { return uvReflectionRenderPass; }
   VkRenderPass getLightingRenderPass() { return lightingRenderPass; }
   VkRenderPass getPostProcessingRenderPass() { return postProcessingRenderPass; }
@@ -123,6 +127,7 @@ class Vk3dSwapChain {
   uint32_t width() { return swapChainExtent.width; }
   uint32_t height() { return swapChainExtent.height; }
   std::vector<Attachments> getAttachments() { return attachmentsVector; }
+  const FrameBufferAttachment& getMappingsDepthAttachment(int index) { return attachmentsVector[index].mappingsMapDepth; }
   VkExtent2D getShadowMapExtent() { return VkExtent2D{SHADOW_MAP_WIDTH, SHADOW_MAP_HEIGHT}; }
 
   float extentAspectRatio() {
@@ -165,6 +170,7 @@ class Vk3dSwapChain {
  private:
   void init();
   void createSwapChain();
+  void createOffscreenImages();
   void createSwapChainImageViews();
   void createSampler(VkFormat format, VkImageUsageFlags usage, Sampler* attachment, VkExtent2D extent, VkImageViewType imageViewType = VK_IMAGE_VIEW_TYPE_2D, uint32_t arrayLayers = 1);
   void createAttachment(VkFormat format, VkImageUsageFlags usage, FrameBufferAttachment* attachment, VkExtent2D extent, VkImageViewType imageViewType = VK_IMAGE_VIEW_TYPE_2D, uint32_t arrayLayers = 1);
@@ -205,6 +211,7 @@ class Vk3dSwapChain {
 
   std::vector<VkFramebuffer> mappingsFramebuffers;
   VkRenderPass mappingsRenderPass;
+  VkRenderPass mappingsLateRenderPass;
 
   std::vector<VkFramebuffer> uvReflectionFramebuffers;
   VkRenderPass uvReflectionRenderPass;
@@ -219,12 +226,13 @@ class Vk3dSwapChain {
   std::vector<Attachments> attachmentsVector;
   std::vector<VkImage> swapChainImages;
   std::vector<VkImageView> swapChainImageViews;
+  std::vector<FrameBufferAttachment> offscreenImages;
 
   Vk3dDevice &device;
   Vk3dAllocator &allocator;
   VkExtent2D windowExtent;
 
-  VkSwapchainKHR swapChain;
+  VkSwapchainKHR swapChain = VK_NULL_HANDLE;
   std::shared_ptr<Vk3dSwapChain> oldSwapChain;
 
   std::vector<VkSemaphore> imageAvailableSemaphores;
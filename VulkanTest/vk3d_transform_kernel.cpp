@@ -0,0 +1,318 @@
+#include "vk3d_transform_kernel.hpp"
+
+// std
+#include <cmath>
+
+// MSVC compiles AVX2 intrinsics without /arch:AVX2, so the lanes are picked at runtime from cpuid and the rest of the
+// program keeps running on CPUs without it. GCC and Clang only inline them in AVX2 code, they need -mavx2.
+#if defined(_MSC_VER) && (defined(_M_X64) || defined(_M_IX86))
+#define VK3D_TRANSFORM_AVX2
+#define VK3D_TRANSFORM_AVX2_CPUID
+#include <intrin.h>
+#include <immintrin.h>
+#elif defined(__AVX2__)
+#define VK3D_TRANSFORM_AVX2
+#include <immintrin.h>
+#endif
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define VK3D_TRANSFORM_SSE2
+#include <emmintrin.h>
+#endif
+
+namespace vk3d {
+
+	namespace {
+		// Rotation and scale columns of one object, shared by the scalar path and the lane scatter
+		void writeMatrices(
+			const float rotation[3][3],
+			const glm::vec3& translation,
+			const glm::vec3& scale,
+			glm::mat4& worldMatrix,
+			glm::mat3& normalMatrix) {
+			for (int column = 0; column < 3; column++) {
+				float invScale = 1.f / scale[column];
+				for (int row = 0; row < 3; row++) {
+					worldMatrix[column][row] = scale[column] * rotation[column][row];
+					normalMatrix[column][row] = invScale * rotation[column][row];
+				}
+				worldMatrix[column][3] = 0.f;
+			}
+			worldMatrix[3] = glm::vec4{ translation, 1.f };
+		}
+
+		void computeScalar(const glm::vec3& translation, const glm::vec3& rotation, const glm::vec3& scale, glm::mat4& worldMatrix, glm::mat3& normalMatrix) {
+			const float c3 = std::cos(rotation.z);
+			const float s3 = std::sin(rotation.z);
+			const float c2 = std::cos(rotation.x);
+			const float s2 = std::sin(rotation.x);
+			const float c1 = std::cos(rotation.y);
+			const float s1 = std::sin(rotation.y);
+			const float columns[3][3] = {
+				{ c1 * c3 + s1 * s2 * s3, c2 * s3, c1 * s2 * s3 - c3 * s1 },
+				{ c3 * s1 * s2 - c1 * s3, c2 * c3, c1 * c3 * s2 + s1 * s3 },
+				{ c2 * s1, -s2, c1 * c2 },
+			};
+			writeMatrices(columns, translation, scale, worldMatrix, normalMatrix);
+		}
+
+#if defined(VK3D_TRANSFORM_AVX2) || defined(VK3D_TRANSFORM_SSE2)
+		// Cephes sinf/cosf: the argument is reduced to [-pi/4, pi/4] around the closest multiple of pi/4 in three parts
+		// for extra precision, then either the sine or the cosine polynomial is evaluated depending on the octant
+		constexpr float FOUR_OVER_PI = 1.27323954473516f;
+		constexpr float MINUS_DP1 = -0.78515625f;
+		constexpr float MINUS_DP2 = -2.4187564849853515625e-4f;
+		constexpr float MINUS_DP3 = -3.77489497744594108e-8f;
+		constexpr float SIN_P0 = -1.9515295891e-4f;
+		constexpr float SIN_P1 = 8.3321608736e-3f;
+		constexpr float SIN_P2 = -1.6666654611e-1f;
+		constexpr float COS_P0 = 2.443315711809948e-5f;
+		constexpr float COS_P1 = -1.388731625493765e-3f;
+		constexpr float COS_P2 = 4.166664568298827e-2f;
+
+		template <typename Simd>
+		void sincos(typename Simd::F x, typename Simd::F& s, typename Simd::F& c) {
+			using F = typename Simd::F;
+			using I = typename Simd::I;
+			const F signMask = Simd::castToFloat(Simd::set1i(static_cast<int>(0x80000000u)));
+
+			F signSin = Simd::bitAnd(x, signMask);
+			x = Simd::bitAndNot(signMask, x);
+
+			// octant, rounded up to even so the reduced argument is centered on zero
+			I j = Simd::toInt(Simd::mul(x, Simd::set1(FOUR_OVER_PI)));
+			j = Simd::andi(Simd::addi(j, Simd::set1i(1)), Simd::set1i(~1));
+			F y = Simd::toFloat(j);
+
+			F swapSignSin = Simd::castToFloat(Simd::shiftLeft29(Simd::andi(j, Simd::set1i(4))));
+			F useCosPolynomialForSin = Simd::castToFloat(Simd::cmpeqi(Simd::andi(j, Simd::set1i(2)), Simd::set1i(0)));
+			F signCos = Simd::castToFloat(Simd::shiftLeft29(Simd::andNoti(Simd::subi(j, Simd::set1i(2)), Simd::set1i(4))));
+			signSin = Simd::bitXor(signSin, swapSignSin);
+
+			x = Simd::add(x, Simd::mul(y, Simd::set1(MINUS_DP1)));
+			x = Simd::add(x, Simd::mul(y, Simd::set1(MINUS_DP2)));
+			x = Simd::add(x, Simd::mul(y, Simd::set1(MINUS_DP3)));
+			F z = Simd::mul(x, x);
+
+			F cosPolynomial = Simd::set1(COS_P0);
+			cosPolynomial = Simd::add(Simd::mul(cosPolynomial, z), Simd::set1(COS_P1));
+			cosPolynomial = Simd::add(Simd::mul(cosPolynomial, z), Simd::set1(COS_P2));
+			cosPolynomial = Simd::mul(Simd::mul(cosPolynomial, z), z);
+			cosPolynomial = Simd::sub(cosPolynomial, Simd::mul(z, Simd::set1(.5f)));
+			cosPolynomial = Simd::add(cosPolynomial, Simd::set1(1.f));
+
+			F sinPolynomial = Simd::set1(SIN_P0);
+			sinPolynomial = Simd::add(Simd::mul(sinPolynomial, z), Simd::set1(SIN_P1));
+			sinPolynomial = Simd::add(Simd::mul(sinPolynomial, z), Simd::set1(SIN_P2));
+			sinPolynomial = Simd::mul(Simd::mul(sinPolynomial, z), x);
+			sinPolynomial = Simd::add(sinPolynomial, x);
+
+			F sinResult = Simd::bitOr(Simd::bitAnd(useCosPolynomialForSin, sinPolynomial), Simd::bitAndNot(useCosPolynomialForSin, cosPolynomial));
+			F cosResult = Simd::bitOr(Simd::bitAnd(useCosPolynomialForSin, cosPolynomial), Simd::bitAndNot(useCosPolynomialForSin, sinPolynomial));
+			s = Simd::bitXor(sinResult, signSin);
+			c = Simd::bitXor(cosResult, signCos);
+		}
+
+		// Computes Simd::WIDTH objects, gathered from the AoS vec3s into one register per component
+		template <typename Simd>
+		void computeLanes(
+			const glm::vec3* translations,
+			const glm::vec3* rotations,
+			const glm::vec3* scales,
+			const uint32_t* objects,
+			glm::mat4* worldMatrices,
+			glm::mat3* normalMatrices) {
+			using F = typename Simd::F;
+			constexpr uint32_t WIDTH = Simd::WIDTH;
+
+			alignas(32) float angles[3][WIDTH];
+			for (uint32_t lane = 0; lane < WIDTH; lane++) {
+				const glm::vec3& rotation = rotations[objects[lane]];
+				angles[0][lane] = rotation.x;
+				angles[1][lane] = rotation.y;
+				angles[2][lane] = rotation.z;
+			}
+
+			F s1, c1, s2, c2, s3, c3;
+			sincos<Simd>(Simd::load(angles[1]), s1, c1);
+			sincos<Simd>(Simd::load(angles[0]), s2, c2);
+			sincos<Simd>(Simd::load(angles[2]), s3, c3);
+
+			F s1s2 = Simd::mul(s1, s2);
+			F c1s2 = Simd::mul(c1, s2);
+			alignas(32) float columns[3][3][WIDTH];
+			Simd::store(columns[0][0], Simd::add(Simd::mul(c1, c3), Simd::mul(s1s2, s3)));
+			Simd::store(columns[0][1], Simd::mul(c2, s3));
+			Simd::store(columns[0][2], Simd::sub(Simd::mul(c1s2, s3), Simd::mul(c3, s1)));
+			Simd::store(columns[1][0], Simd::sub(Simd::mul(c3, s1s2), Simd::mul(c1, s3)));
+			Simd::store(columns[1][1], Simd::mul(c2, c3));
+			Simd::store(columns[1][2], Simd::add(Simd::mul(c1s2, c3), Simd::mul(s1, s3)));
+			Simd::store(columns[2][0], Simd::mul(c2, s1));
+			Simd::store(columns[2][1], Simd::bitXor(s2, Simd::castToFloat(Simd::set1i(static_cast<int>(0x80000000u)))));
+			Simd::store(columns[2][2], Simd::mul(c1, c2));
+			Simd::endLanes();
+
+			for (uint32_t lane = 0; lane < WIDTH; lane++) {
+				uint32_t object = objects[lane];
+				float rotation[3][3];
+				for (int column = 0; column < 3; column++) {
+					for (int row = 0; row < 3; row++) {
+						rotation[column][row] = columns[column][row][lane];
+					}
+				}
+				writeMatrices(rotation, translations[object], scales[object], worldMatrices[object], normalMatrices[object]);
+			}
+		}
+#endif
+
+#if defined(VK3D_TRANSFORM_AVX2)
+		struct Avx2 {
+			using F = __m256;
+			using I = __m256i;
+			static constexpr uint32_t WIDTH = 8;
+
+			static F set1(float v) { return _mm256_set1_ps(v); }
+			static F load(const float* p) { return _mm256_load_ps(p); }
+			static void store(float* p, F v) { _mm256_store_ps(p, v); }
+			static F add(F a, F b) { return _mm256_add_ps(a, b); }
+			static F sub(F a, F b) { return _mm256_sub_ps(a, b); }
+			static F mul(F a, F b) { return _mm256_mul_ps(a, b); }
+			static F bitAnd(F a, F b) { return _mm256_and_ps(a, b); }
+			static F bitAndNot(F a, F b) { return _mm256_andnot_ps(a, b); }
+			static F bitOr(F a, F b) { return _mm256_or_ps(a, b); }
+			static F bitXor(F a, F b) { return _mm256_xor_ps(a, b); }
+			static I set1i(int v) { return _mm256_set1_epi32(v); }
+			static I addi(I a, I b) { return _mm256_add_epi32(a, b); }
+			static I subi(I a, I b) { return _mm256_sub_epi32(a, b); }
+			static I andi(I a, I b) { return _mm256_and_si256(a, b); }
+			static I andNoti(I a, I b) { return _mm256_andnot_si256(a, b); }
+			static I cmpeqi(I a, I b) { return _mm256_cmpeq_epi32(a, b); }
+			static I shiftLeft29(I a) { return _mm256_slli_epi32(a, 29); }
+			static I toInt(F a) { return _mm256_cvttps_epi32(a); }
+			static F toFloat(I a) { return _mm256_cvtepi32_ps(a); }
+			static F castToFloat(I a) { return _mm256_castsi256_ps(a); }
+			// without /arch:AVX2 the scatter is SSE code, clearing the upper halves avoids the AVX to SSE transition penalty
+			static void endLanes() { _mm256_zeroupper(); }
+		};
+#endif
+
+#if defined(VK3D_TRANSFORM_SSE2)
+		struct Sse2 {
+			using F = __m128;
+			using I = __m128i;
+			static constexpr uint32_t WIDTH = 4;
+
+			static F set1(float v) { return _mm_set1_ps(v); }
+			static F load(const float* p) { return _mm_load_ps(p); }
+			static void store(float* p, F v) { _mm_store_ps(p, v); }
+			static F add(F a, F b) { return _mm_add_ps(a, b); }
+			static F sub(F a, F b) { return _mm_sub_ps(a, b); }
+			static F mul(F a, F b) { return _mm_mul_ps(a, b); }
+			static F bitAnd(F a, F b) { return _mm_and_ps(a, b); }
+			static F bitAndNot(F a, F b) { return _mm_andnot_ps(a, b); }
+			static F bitOr(F a, F b) { return _mm_or_ps(a, b); }
+			static F bitXor(F a, F b) { return _mm_xor_ps(a, b); }
+			static I set1i(int v) { return _mm_set1_epi32(v); }
+			static I addi(I a, I b) { return _mm_add_epi32(a, b); }
+			static I subi(I a, I b) { return _mm_sub_epi32(a, b); }
+			static I andi(I a, I b) { return _mm_and_si128(a, b); }
+			static I andNoti(I a, I b) { return _mm_andnot_si128(a, b); }
+			static I cmpeqi(I a, I b) { return _mm_cmpeq_epi32(a, b); }
+			static I shiftLeft29(I a) { return _mm_slli_epi32(a, 29); }
+			static I toInt(F a) { return _mm_cvttps_epi32(a); }
+			static F toFloat(I a) { return _mm_cvtepi32_ps(a); }
+			static F castToFloat(I a) { return _mm_castsi128_ps(a); }
+			static void endLanes() {}
+		};
+#endif
+
+#if defined(VK3D_TRANSFORM_AVX2) || defined(VK3D_TRANSFORM_SSE2)
+		// Computes the objects from first in groups of Simd::WIDTH, returns the first one left
+		template <typename Simd>
+		uint32_t computeGroups(
+			const glm::vec3* translations,
+			const glm::vec3* rotations,
+			const glm::vec3* scales,
+			const uint32_t* indices,
+			uint32_t first,
+			uint32_t count,
+			glm::mat4* worldMatrices,
+			glm::mat3* normalMatrices) {
+			uint32_t objects[Simd::WIDTH];
+			uint32_t i = first;
+			for (; i + Simd::WIDTH <= count; i += Simd::WIDTH) {
+				for (uint32_t lane = 0; lane < Simd::WIDTH; lane++) {
+					objects[lane] = indices ? indices[i + lane] : i + lane;
+				}
+				computeLanes<Simd>(translations, rotations, scales, objects, worldMatrices, normalMatrices);
+			}
+			return i;
+		}
+#endif
+
+#if defined(VK3D_TRANSFORM_AVX2)
+		bool supportsAvx2() {
+#if defined(VK3D_TRANSFORM_AVX2_CPUID)
+			int info[4];
+			__cpuid(info, 0);
+			if (info[0] < 7) {
+				return false;
+			}
+			// AVX, and the OS saves the ymm registers on context switches
+			__cpuid(info, 1);
+			bool osxsave = (info[2] & (1 << 27)) != 0;
+			bool avx = (info[2] & (1 << 28)) != 0;
+			if (!osxsave || !avx || (_xgetbv(0) & 0x6) != 0x6) {
+				return false;
+			}
+			__cpuidex(info, 7, 0);
+			return (info[1] & (1 << 5)) != 0;
+#else
+			return true;
+#endif
+		}
+
+		// checked once, every call takes the same lanes
+		const bool useAvx2 = supportsAvx2();
+#endif
+	}
+
+	void Vk3dTransformKernel::computeMatrices(
+		const glm::vec3* translations,
+		const glm::vec3* rotations,
+		const glm::vec3* scales,
+		const uint32_t* indices,
+		uint32_t count,
+		glm::mat4* worldMatrices,
+		glm::mat3* normalMatrices) {
+		uint32_t i = 0;
+
+#if defined(VK3D_TRANSFORM_AVX2)
+		if (useAvx2) {
+			i = computeGroups<Avx2>(translations, rotations, scales, indices, i, count, worldMatrices, normalMatrices);
+		}
+#endif
+#if defined(VK3D_TRANSFORM_SSE2)
+		// also the remainder of the AVX2 groups
+		i = computeGroups<Sse2>(translations, rotations, scales, indices, i, count, worldMatrices, normalMatrices);
+#endif
+
+		for (; i < count; i++) {
+			uint32_t object = indices ? indices[i] : i;
+			computeScalar(translations[object], rotations[object], scales[object], worldMatrices[object], normalMatrices[object]);
+		}
+	}
+
+	const char* Vk3dTransformKernel::getInstructionSet() {
+#if defined(VK3D_TRANSFORM_AVX2)
+		if (useAvx2) {
+			return "AVX2";
+		}
+#endif
+#if defined(VK3D_TRANSFORM_SSE2)
+		return "SSE2";
+#else
+		return "scalar";
+#endif
+	}
+
+}
@@ -0,0 +1,32 @@
+#pragma once
+
+// libs
+#define GLM_FORCE_RADIANS
+#define GLM_FORCE_DEPTH_ZERO_TO_ONE
+#include <glm/glm.hpp>
+
+// std
+#include <cstdint>
+
+namespace vk3d {
+	// Builds the world and normal matrices of many objects at once, from the SoA translations, rotations and scales of
+	// Vk3dScene, with the same Y1 X2 Z3 rotation as TransformComponent::mat4 and normalMatrix. Objects go through in lanes
+	// of 8 with AVX2 and 4 with SSE2, the rest one at a time. AVX2 is used when the CPU has it, GCC and Clang need -mavx2.
+	// The sines and cosines come from a vectorized Cephes sincos, within a few ulps of the standard library.
+	class Vk3dTransformKernel {
+	public:
+		// Computes the objects listed in indices, or the first count objects when indices is null.
+		// The matrices are written at the index of their object.
+		static void computeMatrices(
+			const glm::vec3* translations,
+			const glm::vec3* rotations,
+			const glm::vec3* scales,
+			const uint32_t* indices,
+			uint32_t count,
+			glm::mat4* worldMatrices,
+			glm::mat3* normalMatrices);
+
+		// "AVX2", "SSE2" or "scalar"
+		static const char* getInstructionSet();
+	};
+}
@@ -0,0 +1,307 @@
+#include "vk3d_upload_batcher.hpp"
+
+#include "vk3d_profiler.hpp"
+
+// std
+#include <algorithm>
+#include <cassert>
+#include <cstring>
+#include <stdexcept>
+
+namespace vk3d {
+
+	namespace {
+		// Splitting large uploads keeps a single one from having to wait for the whole ring to drain
+		constexpr VkDeviceSize MAX_CHUNKS_PER_RING = 4;
+
+		// uploads are read as vertices, indices or storage buffers by the frames submitted afterwards
+		constexpr VkPipelineStageFlags READ_STAGES = VK_PIPELINE_STAGE_VERTEX_INPUT_BIT | VK_PIPELINE_STAGE_VERTEX_SHADER_BIT | VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT;
+		constexpr VkAccessFlags READ_ACCESS = VK_ACCESS_VERTEX_ATTRIBUTE_READ_BIT | VK_ACCESS_INDEX_READ_BIT | VK_ACCESS_SHADER_READ_BIT;
+
+		VkDeviceSize alignUp(VkDeviceSize value, VkDeviceSize alignment) {
+			return (value + alignment - 1) / alignment * alignment;
+		}
+	}
+
+	Vk3dUploadBatcher::Vk3dUploadBatcher(Vk3dDevice& device, Vk3dAllocator& allocator, VkDeviceSize ringSize)
+		: vk3dDevice{ device }, ringSize{ alignUp(ringSize, COPY_ALIGNMENT) } {
+		assert(this->ringSize >= COPY_ALIGNMENT * MAX_CHUNKS_PER_RING && "Staging ring is too small");
+		stagingBuffer = std::make_unique<Vk3dBuffer>(
+			vk3dDevice,
+			this->ringSize,
+			1,
+			VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+			VMA_MEMORY_USAGE_CPU_ONLY,
+			VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+			allocator);
+		if (stagingBuffer->map() != VK_SUCCESS) {
+			throw std::runtime_error("failed to map upload staging buffer!");
+		}
+		mapped = static_cast<char*>(stagingBuffer->getMappedMemory());
+	}
+
+	Vk3dUploadBatcher::~Vk3dUploadBatcher() {
+		finish();
+		for (auto& batch : freeBatches) {
+			destroyBatch(batch);
+		}
+	}
+
+	void Vk3dUploadBatcher::upload(VkBuffer dstBuffer, VkDeviceSize dstOffset, const void* data, VkDeviceSize size) {
+		VkDeviceSize maxChunkSize = ringSize / MAX_CHUNKS_PER_RING;
+		const char* source = static_cast<const char*>(data);
+
+		for (VkDeviceSize uploaded = 0; uploaded < size;) {
+			VkDeviceSize chunkSize = std::min(size - uploaded, maxChunkSize);
+			VkDeviceSize offset = allocate(alignUp(chunkSize, COPY_ALIGNMENT));
+			std::memcpy(mapped + offset, source + uploaded, chunkSize);
+
+			VkBufferCopy region{};
+			region.srcOffset = offset;
+			region.dstOffset = dstOffset + uploaded;
+			region.size = chunkSize;
+			pendingCopies.push_back({ dstBuffer, region });
+			uploaded += chunkSize;
+		}
+	}
+
+	VkDeviceSize Vk3dUploadBatcher::allocate(VkDeviceSize size) {
+		VkDeviceSize offset;
+		while (!tryAllocate(size, offset)) {
+			// the ring is full: submit what is queued and wait for the oldest batch to give its space back
+			flush();
+			if (tryAllocate(size, offset)) {
+				break;
+			}
+			assert(!inFlightBatches.empty() && "Upload does not fit in an empty staging ring");
+			retireOldest(true);
+		}
+		return offset;
+	}
+
+	bool Vk3dUploadBatcher::tryAllocate(VkDeviceSize size, VkDeviceSize& offset) {
+		if (usedSize == 0) {
+			head = 0;
+			tail = 0;
+		}
+
+		VkDeviceSize skipped = 0;
+		if (usedSize > 0 && head == tail) {
+			return false;
+		}
+		else if (head >= tail) {
+			// free space is [head, ringSize) followed by [0, tail)
+			if (ringSize - head >= size) {
+				offset = head;
+			}
+			else if (tail >= size) {
+				skipped = ringSize - head;
+				offset = 0;
+			}
+			else {
+				return false;
+			}
+		}
+		else if (tail - head >= size) {
+			offset = head;
+		}
+		else {
+			return false;
+		}
+
+		head = offset + size;
+		if (head == ringSize) {
+			head = 0;
+		}
+		usedSize += skipped + size;
+		pendingSize += skipped + size;
+		return true;
+	}
+
+	void Vk3dUploadBatcher::flush() {
+		collect();
+		if (pendingCopies.empty()) {
+			return;
+		}
+		VK3D_PROFILE_ZONE("Vk3dUploadBatcher::flush");
+
+		Batch batch = acquireBatch();
+
+		// one vkCmdCopyBuffer per destination buffer
+		std::stable_sort(pendingCopies.begin(), pendingCopies.end(), [](const Copy& a, const Copy& b) {
+			return a.dstBuffer < b.dstBuffer;
+		});
+
+		VkCommandBufferBeginInfo beginInfo{};
+		beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+		beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+
+		VkSubmitInfo submitInfo{};
+		submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+		submitInfo.commandBufferCount = 1;
+		VkPipelineStageFlags waitStage = READ_STAGES;
+
+		if (vk3dDevice.hasDedicatedTransferQueue()) {
+			vkBeginCommandBuffer(batch.transferCommandBuffer, &beginInfo);
+			recordCopies(batch.transferCommandBuffer);
+			recordOwnershipTransfer(batch.transferCommandBuffer, true);
+			vkEndCommandBuffer(batch.transferCommandBuffer);
+
+			submitInfo.pCommandBuffers = &batch.transferCommandBuffer;
+			submitInfo.signalSemaphoreCount = 1;
+			submitInfo.pSignalSemaphores = &batch.semaphore;
+			if (vkQueueSubmit(vk3dDevice.transferQueue(), 1, &submitInfo, VK_NULL_HANDLE) != VK_SUCCESS) {
+				throw std::runtime_error("failed to submit upload command buffer!");
+			}
+
+			vkBeginCommandBuffer(batch.commandBuffer, &beginInfo);
+			recordOwnershipTransfer(batch.commandBuffer, false);
+			vkEndCommandBuffer(batch.commandBuffer);
+
+			// the graphics queue only waits where the uploaded data is read
+			submitInfo.signalSemaphoreCount = 0;
+			submitInfo.pSignalSemaphores = nullptr;
+			submitInfo.waitSemaphoreCount = 1;
+			submitInfo.pWaitSemaphores = &batch.semaphore;
+			submitInfo.pWaitDstStageMask = &waitStage;
+		}
+		else {
+			vkBeginCommandBuffer(batch.commandBuffer, &beginInfo);
+			recordCopies(batch.commandBuffer);
+
+			VkMemoryBarrier barrier{};
+			barrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+			barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+			barrier.dstAccessMask = READ_ACCESS;
+			vkCmdPipelineBarrier(batch.commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, READ_STAGES, 0, 1, &barrier, 0, nullptr, 0, nullptr);
+			vkEndCommandBuffer(batch.commandBuffer);
+		}
+
+		submitInfo.pCommandBuffers = &batch.commandBuffer;
+		if (vkQueueSubmit(vk3dDevice.graphicsQueue(), 1, &submitInfo, batch.fence) != VK_SUCCESS) {
+			throw std::runtime_error("failed to submit upload command buffer!");
+		}
+
+		batch.ringEnd = head;
+		batch.heldSize = pendingSize;
+		inFlightBatches.push_back(batch);
+		pendingCopies.clear();
+		pendingSize = 0;
+		submitCount++;
+	}
+
+	void Vk3dUploadBatcher::recordCopies(VkCommandBuffer commandBuffer) {
+		std::vector<VkBufferCopy> regions;
+		for (size_t begin = 0; begin < pendingCopies.size();) {
+			size_t end = begin;
+			regions.clear();
+			while (end < pendingCopies.size() && pendingCopies[end].dstBuffer == pendingCopies[begin].dstBuffer) {
+				regions.push_back(pendingCopies[end++].region);
+			}
+			vkCmdCopyBuffer(commandBuffer, stagingBuffer->getBuffer(), pendingCopies[begin].dstBuffer, static_cast<uint32_t>(regions.size()), regions.data());
+			begin = end;
+		}
+	}
+
+	void Vk3dUploadBatcher::recordOwnershipTransfer(VkCommandBuffer commandBuffer, bool release) {
+		// only the written ranges change owner, the rest of the buffer stays with the graphics queue family
+		std::vector<VkBufferMemoryBarrier> barriers(pendingCopies.size());
+		for (size_t i = 0; i < pendingCopies.size(); i++) {
+			VkBufferMemoryBarrier& barrier = barriers[i];
+			barrier.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER;
+			barrier.srcAccessMask = release ? VK_ACCESS_TRANSFER_WRITE_BIT : 0;
+			barrier.dstAccessMask = release ? 0 : READ_ACCESS;
+			barrier.srcQueueFamilyIndex = vk3dDevice.transferQueueFamily();
+			barrier.dstQueueFamilyIndex = vk3dDevice.graphicsQueueFamily();
+			barrier.buffer = pendingCopies[i].dstBuffer;
+			barrier.offset = pendingCopies[i].region.dstOffset;
+			barrier.size = pendingCopies[i].region.size;
+		}
+
+		// the acquire chains with the semaphore wait through READ_STAGES
+		VkPipelineStageFlags srcStage = release ? VK_PIPELINE_STAGE_TRANSFER_BIT : READ_STAGES;
+		VkPipelineStageFlags dstStage = release ? VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT : READ_STAGES;
+		vkCmdPipelineBarrier(commandBuffer, srcStage, dstStage, 0, 0, nullptr, static_cast<uint32_t>(barriers.size()), barriers.data(), 0, nullptr);
+	}
+
+	void Vk3dUploadBatcher::collect() {
+		while (!inFlightBatches.empty() && vkGetFenceStatus(vk3dDevice.device(), inFlightBatches.front().fence) == VK_SUCCESS) {
+			retireOldest(false);
+		}
+	}
+
+	void Vk3dUploadBatcher::finish() {
+		VK3D_PROFILE_ZONE("Vk3dUploadBatcher::finish");
+		flush();
+		while (!inFlightBatches.empty()) {
+			retireOldest(true);
+		}
+	}
+
+	Vk3dUploadBatcher::Batch Vk3dUploadBatcher::acquireBatch() {
+		if (!freeBatches.empty()) {
+			Batch batch = freeBatches.back();
+			freeBatches.pop_back();
+			return batch;
+		}
+
+		Batch batch{};
+		VkCommandBufferAllocateInfo allocInfo{};
+		allocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+		allocInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+		allocInfo.commandPool = vk3dDevice.getCommandPool();
+		allocInfo.commandBufferCount = 1;
+		if (vkAllocateCommandBuffers(vk3dDevice.device(), &allocInfo, &batch.commandBuffer) != VK_SUCCESS) {
+			throw std::runtime_error("failed to allocate upload command buffer!");
+		}
+
+		VkFenceCreateInfo fenceInfo{};
+		fenceInfo.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
+		if (vkCreateFence(vk3dDevice.device(), &fenceInfo, nullptr, &batch.fence) != VK_SUCCESS) {
+			throw std::runtime_error("failed to create upload fence!");
+		}
+
+		if (vk3dDevice.hasDedicatedTransferQueue()) {
+			allocInfo.commandPool = vk3dDevice.getTransferCommandPool();
+			if (vkAllocateCommandBuffers(vk3dDevice.device(), &allocInfo, &batch.transferCommandBuffer) != VK_SUCCESS) {
+				throw std::runtime_error("failed to allocate transfer command buffer!");
+			}
+
+			VkSemaphoreCreateInfo semaphoreInfo{};
+			semaphoreInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
+			if (vkCreateSemaphore(vk3dDevice.device(), &semaphoreInfo, nullptr, &batch.semaphore) != VK_SUCCESS) {
+				throw std::runtime_error("failed to create upload semaphore!");
+			}
+		}
+		return batch;
+	}
+
+	void Vk3dUploadBatcher::destroyBatch(Batch& batch) {
+		vkFreeCommandBuffers(vk3dDevice.device(), vk3dDevice.getCommandPool(), 1, &batch.commandBuffer);
+		vkDestroyFence(vk3dDevice.device(), batch.fence, nullptr);
+		if (batch.transferCommandBuffer != VK_NULL_HANDLE) {
+			vkFreeCommandBuffers(vk3dDevice.device(), vk3dDevice.getTransferCommandPool(), 1, &batch.transferCommandBuffer);
+			vkDestroySemaphore(vk3dDevice.device(), batch.semaphore, nullptr);
+		}
+	}
+
+	void Vk3dUploadBatcher::retireOldest(bool wait) {
+		Batch batch = inFlightBatches.front();
+		inFlightBatches.pop_front();
+		if (wait) {
+			vkWaitForFences(vk3dDevice.device(), 1, &batch.fence, VK_TRUE, UINT64_MAX);
+		}
+
+		// batches finish in submission order, so the oldest one always holds the tail of the ring
+		tail = batch.ringEnd;
+		usedSize -= batch.heldSize;
+
+		vkResetFences(vk3dDevice.device(), 1, &batch.fence);
+		vkResetCommandBuffer(batch.commandBuffer, 0);
+		if (batch.transferCommandBuffer != VK_NULL_HANDLE) {
+			vkResetCommandBuffer(batch.transferCommandBuffer, 0);
+		}
+		freeBatches.push_back(batch);
+	}
+
+}
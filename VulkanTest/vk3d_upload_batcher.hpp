@@ -0,0 +1,84 @@
+#pragma once
+
+#include "vk3d_device.hpp"
+#include "vk3d_buffer.hpp"
+#include "vk3d_allocator.hpp"
+
+// std
+#include <deque>
+#include <memory>
+#include <vector>
+
+namespace vk3d {
+	// Gathers buffer uploads into one command buffer per batch instead of a queue wait per buffer.
+	// The data is copied into a persistently mapped staging ring, and the ring space of a batch is reused once its fence signals.
+	// With a dedicated transfer queue the copies run there and the written ranges are handed over to the graphics queue family,
+	// otherwise they are recorded on the graphics queue.
+	class Vk3dUploadBatcher {
+	public:
+		static constexpr VkDeviceSize DEFAULT_RING_SIZE = 32 * 1024 * 1024;
+		static constexpr VkDeviceSize COPY_ALIGNMENT = 16;
+
+		Vk3dUploadBatcher(Vk3dDevice& device, Vk3dAllocator& allocator, VkDeviceSize ringSize = DEFAULT_RING_SIZE);
+		~Vk3dUploadBatcher();
+
+		Vk3dUploadBatcher(const Vk3dUploadBatcher&) = delete;
+		Vk3dUploadBatcher& operator=(const Vk3dUploadBatcher&) = delete;
+
+		// Copies data into the ring right away, so it can be freed on return. Uploads larger than the ring are split.
+		// Waits for older batches when the ring is full.
+		void upload(VkBuffer dstBuffer, VkDeviceSize dstOffset, const void* data, VkDeviceSize size);
+		// Submits the queued copies, anything submitted to the graphics queue after it sees the data
+		void flush();
+		// Reuses the ring space of the batches the GPU has finished
+		void collect();
+		// Flushes and waits for every batch
+		void finish();
+
+		VkDeviceSize getRingSize() const { return ringSize; }
+		uint32_t getSubmitCount() const { return submitCount; }
+
+	private:
+		struct Batch {
+			// graphics queue: the copies, or the ownership acquire when they run on the transfer queue
+			VkCommandBuffer commandBuffer = VK_NULL_HANDLE;
+			// dedicated transfer queue only: the copies and the ownership release, signaling the semaphore
+			VkCommandBuffer transferCommandBuffer = VK_NULL_HANDLE;
+			VkSemaphore semaphore = VK_NULL_HANDLE;
+			VkFence fence = VK_NULL_HANDLE;
+			// head of the ring after the batch, becomes the tail once it is finished
+			VkDeviceSize ringEnd = 0;
+			// ring bytes held by the batch, including the end of the ring skipped when an allocation wraps
+			VkDeviceSize heldSize = 0;
+		};
+
+		struct Copy {
+			VkBuffer dstBuffer;
+			VkBufferCopy region;
+		};
+
+		VkDeviceSize allocate(VkDeviceSize size);
+		bool tryAllocate(VkDeviceSize size, VkDeviceSize& offset);
+		Batch acquireBatch();
+		void destroyBatch(Batch& batch);
+		void recordCopies(VkCommandBuffer commandBuffer);
+		// release on the transfer queue or acquire on the graphics queue of every range written by the batch
+		void recordOwnershipTransfer(VkCommandBuffer commandBuffer, bool release);
+		void retireOldest(bool wait);
+
+		Vk3dDevice& vk3dDevice;
+		VkDeviceSize ringSize;
+		std::unique_ptr<Vk3dBuffer> stagingBuffer;
+		char* mapped = nullptr;
+
+		VkDeviceSize head = 0;
+		VkDeviceSize tail = 0;
+		VkDeviceSize usedSize = 0;
+		VkDeviceSize pendingSize = 0;
+		std::vector<Copy> pendingCopies;
+
+		std::deque<Batch> inFlightBatches;
+		std::vector<Batch> freeBatches;
+		uint32_t submitCount = 0;
+	};
+}
@@ -0,0 +1,98 @@
+#include "vk3d_vertex_table.hpp"
+
+// std
+#include <cstring>
+
+namespace vk3d {
+
+	static_assert(sizeof(Vk3dModel::Vertex) == 48, "Vk3dVertexTable::hash expects a tightly packed 48 byte vertex");
+
+	static constexpr size_t MIN_CAPACITY = 64;
+
+	Vk3dVertexTable::Vk3dVertexTable(std::vector<Vk3dModel::Vertex>& vertices, size_t expectedVertices) : vertices{ vertices } {
+		// keep the load factor under 1/2
+		size_t capacity = MIN_CAPACITY;
+		while (capacity < expectedVertices * 2) {
+			capacity *= 2;
+		}
+		slots.assign(capacity, Slot{ 0, EMPTY_SLOT });
+		mask = capacity - 1;
+	}
+
+	uint32_t Vk3dVertexTable::findOrInsert(const Vk3dModel::Vertex& vertex) {
+		if ((size + 1) * 2 > slots.size()) {
+			grow();
+		}
+
+		uint32_t vertexHash = static_cast<uint32_t>(hash(vertex));
+		for (size_t slot = vertexHash & mask;; slot = (slot + 1) & mask) {
+			Slot& candidate = slots[slot];
+			if (candidate.index == EMPTY_SLOT) {
+				candidate.hash = vertexHash;
+				candidate.index = static_cast<uint32_t>(vertices.size());
+				vertices.push_back(vertex);
+				size++;
+				return candidate.index;
+			}
+			if (candidate.hash == vertexHash && std::memcmp(&vertices[candidate.index], &vertex, sizeof(Vk3dModel::Vertex)) == 0) {
+				return candidate.index;
+			}
+		}
+	}
+
+	void Vk3dVertexTable::grow() {
+		std::vector<Slot> oldSlots(slots.size() * 2, Slot{ 0, EMPTY_SLOT });
+		oldSlots.swap(slots);
+		mask = slots.size() - 1;
+
+		// stored hashes avoid hashing the vertices again
+		for (const Slot& oldSlot : oldSlots) {
+			if (oldSlot.index == EMPTY_SLOT) {
+				continue;
+			}
+			size_t slot = oldSlot.hash & mask;
+			while (slots[slot].index != EMPTY_SLOT) {
+				slot = (slot + 1) & mask;
+			}
+			slots[slot] = oldSlot;
+		}
+	}
+
+	void Vk3dVertexTable::canonicalize(Vk3dModel::Vertex& vertex) {
+		uint32_t words[sizeof(Vk3dModel::Vertex) / sizeof(uint32_t)];
+		std::memcpy(words, &vertex, sizeof(words));
+		for (auto& word : words) {
+			if (word == 0x80000000u) {
+				word = 0;
+			}
+		}
+		std::memcpy(&vertex, words, sizeof(words));
+	}
+
+	uint64_t Vk3dVertexTable::hash(const Vk3dModel::Vertex& vertex) {
+		// The six 64-bit lanes are mixed independently so the multiplies can run in parallel
+		// (or be vectorized), then folded and finalized with the murmur3 64-bit finalizer
+		static constexpr uint64_t SEEDS[6] = {
+			0x9e3779b97f4a7c15ull, 0xbf58476d1ce4e5b9ull, 0x94d049bb133111ebull,
+			0x2545f4914f6cdd1dull, 0x632be59bd9b4e019ull, 0x85ebca77c2b2ae63ull };
+		static constexpr uint64_t PRIME = 0xd6e8feb86659fd93ull;
+
+		uint64_t words[6];
+		std::memcpy(words, &vertex, sizeof(words));
+
+		uint64_t lanes[6];
+		for (int i = 0; i < 6; i++) {
+			lanes[i] = (words[i] ^ SEEDS[i]) * PRIME;
+			lanes[i] ^= lanes[i] >> 29;
+		}
+
+		uint64_t h = (lanes[0] + lanes[1]) ^ (lanes[2] + lanes[3]) ^ (lanes[4] + (lanes[5] << 1 | lanes[5] >> 63));
+		h ^= h >> 33;
+		h *= 0xff51afd7ed558ccdull;
+		h ^= h >> 33;
+		h *= 0xc4ceb9fe1a85ec53ull;
+		h ^= h >> 33;
+		return h;
+	}
+
+}
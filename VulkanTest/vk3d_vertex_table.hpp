@@ -0,0 +1,45 @@
+#pragma once
+
+#include "vk3d_model.hpp"
+
+// std
+#include <cstdint>
+#include <vector>
+
+namespace vk3d {
+	// Open addressing table (linear probing) used to weld vertices. Slots only hold a 32-bit hash and the
+	// index of the vertex in the output array, vertices are compared byte-wise against that array, so
+	// equal vertices must be bitwise equal (see canonicalize).
+	class Vk3dVertexTable {
+	public:
+		static constexpr uint32_t EMPTY_SLOT = UINT32_MAX;
+
+		// vertices is the output array, expectedVertices sizes the table to avoid growing it
+		Vk3dVertexTable(std::vector<Vk3dModel::Vertex>& vertices, size_t expectedVertices = 0);
+
+		Vk3dVertexTable(const Vk3dVertexTable&) = delete;
+		Vk3dVertexTable& operator=(const Vk3dVertexTable&) = delete;
+
+		// Returns the index of the vertex equal to the given one, appending it to the output array if there was none
+		uint32_t findOrInsert(const Vk3dModel::Vertex& vertex);
+
+		size_t getMemorySize() const { return slots.capacity() * sizeof(Slot); }
+
+		// Turns -0.0 into +0.0, so byte-wise comparison matches float comparison for welding
+		static void canonicalize(Vk3dModel::Vertex& vertex);
+		static uint64_t hash(const Vk3dModel::Vertex& vertex);
+
+	private:
+		struct Slot {
+			uint32_t hash;
+			uint32_t index;
+		};
+
+		void grow();
+
+		std::vector<Vk3dModel::Vertex>& vertices;
+		std::vector<Slot> slots;
+		size_t mask = 0;
+		size_t size = 0;
+	};
+}
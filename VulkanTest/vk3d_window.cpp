@@ -3,13 +3,18 @@
 #include <stdexcept>
 
 namespace vk3d {
-	Vk3dWindow::Vk3dWindow(int w, int h, std::string name) : width{ w }, height{ h }, windowName{ name } {
-		initWindow();
+	Vk3dWindow::Vk3dWindow(int w, int h, std::string name, bool headless) : width{ w }, height{ h }, headless{ headless }, windowName{ name } {
+		// Headless windows only provide an extent, no GLFW window or surface is created
+		if (!headless) {
+			initWindow();
+		}
 	}
 
 	Vk3dWindow::~Vk3dWindow() {
-		glfwDestroyWindow(window);
-		glfwTerminate();
+		if (!headless) {
+			glfwDestroyWindow(window);
+			glfwTerminate();
+		}
 	}
 
 	void Vk3dWindow::initWindow() {
@@ -23,6 +28,9 @@ namespace vk3d {
 	}
 
 	void Vk3dWindow::createWindowSurface(VkInstance instance, VkSurfaceKHR* surface) {
+		if (headless) {
+			throw std::runtime_error("cannot create a window surface for a headless window");
+		}
 		if (glfwCreateWindowSurface(instance, window, nullptr, surface) != VK_SUCCESS) {
 			throw std::runtime_error("failed to create window surface");
 		}
@@ -8,16 +8,17 @@ namespace vk3d {
 	class Vk3dWindow {
 
 	public:
-		Vk3dWindow(int w, int h, std::string name);
+		Vk3dWindow(int w, int h, std::string name, bool headless = false);
 		~Vk3dWindow();
 
 		Vk3dWindow(const Vk3dWindow &) = delete;
 		Vk3dWindow &operator=(const Vk3dWindow&) = delete;
-		bool shouldClose() { return glfwWindowShouldClose(window); };
+		bool shouldClose() { return !headless && glfwWindowShouldClose(window); };
 		VkExtent2D getExtent() { return { static_cast<uint32_t>(width), static_cast<uint32_t>(height) }; }
 		bool wasWindowResized() { return framebufferResized; }
 		void resetWindowResizedFlag() { framebufferResized = false; }
 		GLFWwindow* getGLFWwindow() const { return window; }
+		bool isHeadless() const { return headless; }
 
 		void createWindowSurface(VkInstance instance, VkSurfaceKHR* surface);
 
@@ -28,8 +29,9 @@ namespace vk3d {
 		int width;
 		int height;
 		bool framebufferResized = false;
+		bool headless = false;
 
 		std::string windowName;
-		GLFWwindow* window;
+		GLFWwindow* window = nullptr;
 	};
 }
\ No newline at end of file